@@ -31,17 +31,19 @@ class IAppxBlockMapInternal : public IUnknown
 {
 public:
     virtual std::vector<std::string>  GetFileNames() = 0;
-    virtual std::vector<MSIX::Block>  GetBlocks(const std::string& fileName) = 0;
+    virtual MSIX::BlockSpan           GetBlocks(const std::string& fileName) = 0;
     virtual MSIX::ComPtr<IAppxBlockMapFile> GetFile(const std::string& fileName) = 0;
 };
 SpecializeUuidOfImpl(IAppxBlockMapInternal);
 
 namespace MSIX {
 
+    struct PackageIndex;
+
     class AppxBlockMapBlock final : public MSIX::ComClass<AppxBlockMapBlock, IAppxBlockMapBlock>
     {
     public:
-        AppxBlockMapBlock(IMSIXFactory* factory, Block* block) :
+        AppxBlockMapBlock(IMSIXFactory* factory, const Block* block) :
             m_factory(factory),
             m_block(block)
         {}
@@ -49,7 +51,8 @@ namespace MSIX {
         // IAppxBlockMapBlock
         HRESULT STDMETHODCALLTYPE GetHash(UINT32* bufferSize, BYTE** buffer) noexcept override try
         {
-            ThrowHrIfFailed(m_factory->MarshalOutBytes(m_block->hash, bufferSize, buffer));
+            std::vector<std::uint8_t> hash(m_block->hash.begin(), m_block->hash.end());
+            ThrowHrIfFailed(m_factory->MarshalOutBytes(hash, bufferSize, buffer));
             return static_cast<HRESULT>(Error::OK);
         } CATCH_RETURN();
 
@@ -62,7 +65,7 @@ namespace MSIX {
 
     private:
         IMSIXFactory*   m_factory;
-        Block*          m_block;
+        const Block*    m_block;
     };
 
     class AppxBlockMapBlocksEnumerator final : public MSIX::ComClass<AppxBlockMapBlocksEnumerator, IAppxBlockMapBlocksEnumerator>
@@ -105,7 +108,7 @@ namespace MSIX {
     public:
         AppxBlockMapFile(
             IMSIXFactory* factory,
-            std::vector<Block>* blocks,
+            const BlockSpan& blocks,
             std::uint32_t localFileHeaderSize,
             const std::string& name,
             std::uint64_t uncompressedSize
@@ -122,12 +125,12 @@ namespace MSIX {
         HRESULT STDMETHODCALLTYPE GetBlocks(IAppxBlockMapBlocksEnumerator **blocks) noexcept override try
         {
             if (m_blockMapBlocks.empty())
-            {   m_blockMapBlocks.reserve(m_blocks->size());
+            {   m_blockMapBlocks.reserve(m_blocks.size());
                 std::transform(
-                    m_blocks->begin(),
-                    m_blocks->end(),
+                    m_blocks.begin(),
+                    m_blocks.end(),
                     std::back_inserter(m_blockMapBlocks),
-                    [&](auto item){
+                    [&](const Block& item){
                         return ComPtr<IAppxBlockMapBlock>::Make<AppxBlockMapBlock>(m_factory, &item);
                     }
                 );
@@ -165,7 +168,7 @@ namespace MSIX {
     private:
 
         std::vector<ComPtr<IAppxBlockMapBlock>> m_blockMapBlocks;
-        std::vector<Block>* m_blocks;
+        BlockSpan           m_blocks;
         IMSIXFactory*       m_factory;
         std::uint32_t       m_localFileHeaderSize;
         std::string         m_name;
@@ -213,6 +216,9 @@ namespace MSIX {
     public:
         AppxBlockMapObject(IMSIXFactory* factory, const ComPtr<IStream>& stream);
 
+        // Restores a blockmap that was parsed and validated earlier from a package index.
+        AppxBlockMapObject(IMSIXFactory* factory, const ComPtr<IStream>& stream, const PackageIndex& index);
+
         // IVerifierObject
         const std::string& GetPublisher() override {NOTSUPPORTED;}
         bool HasStream() override { return !!m_stream; }
@@ -227,11 +233,27 @@ namespace MSIX {
 
         // IAppxBlockMapInternal methods
         std::vector<std::string>        GetFileNames() override;
-        std::vector<Block>              GetBlocks(const std::string& fileName) override;
+        BlockSpan                       GetBlocks(const std::string& fileName) override;
         MSIX::ComPtr<IAppxBlockMapFile> GetFile(const std::string& fileName) override;
 
     protected:
-        std::map<std::string, std::vector<Block>>        m_blockMap;
+        struct FileBlocks
+        {
+            std::size_t   firstBlock;   // in m_blocks
+            std::size_t   countBlocks;
+            std::uint32_t localFileHeaderSize;
+            std::uint64_t size;
+        };
+
+        // Adds the File element 'fileNode' to m_blockMap. Its blocks have to be added next, before any other file's.
+        FileBlocks& AddFile(const ComPtr<IXmlElement>& fileNode);
+        void AddBlock(FileBlocks& file, const ComPtr<IXmlElement>& blockNode);
+
+        // Adds the files of m_blockMap to m_blockMapFiles, once all of their blocks are in m_blocks.
+        void AddFiles();
+
+        std::vector<Block>                               m_blocks;   // every file's blocks, one file after another
+        std::map<std::string, FileBlocks>                m_blockMap;
         std::map<std::string, ComPtr<IAppxBlockMapFile>> m_blockMapFiles;
         IMSIXFactory*   m_factory;
         ComPtr<IStream> m_stream;
@@ -10,12 +10,13 @@
 #include "MSIXFactory.hpp"
 #include "IXml.hpp"
 #include "StorageObject.hpp"
+#include "ThreadPool.hpp"
 
 #include <string>
 #include <vector>
 
 namespace MSIX {
-    class AppxFactory final : public ComClass<AppxFactory, IMSIXFactory, IAppxFactory, IXmlFactory>
+    class AppxFactory final : public ComClass<AppxFactory, IMSIXFactory, IAppxFactory, IXmlFactory, IMsixFactoryConcurrency>
     {
     public:
         AppxFactory(MSIX_VALIDATION_OPTION validationOptions, COTASKMEMALLOC* memalloc, COTASKMEMFREE* memfree ) : 
@@ -44,11 +45,19 @@ namespace MSIX {
             LPCWSTR signatureFileName,
             IAppxBlockMapReader** blockMapReader) noexcept override;
 
+        // IMsixFactoryConcurrency
+        HRESULT STDMETHODCALLTYPE SetConcurrency(UINT32 threads) noexcept override try
+        {
+            m_threadPool.SetConcurrency(threads);
+            return static_cast<HRESULT>(Error::OK);
+        } CATCH_RETURN();
+
         // IMSIXFactory
         HRESULT MarshalOutString(std::string& internal, LPWSTR *result) noexcept override;
         HRESULT MarshalOutBytes(std::vector<std::uint8_t>& data, UINT32* size, BYTE** buffer) noexcept override;
         MSIX_VALIDATION_OPTION GetValidationOptions() override { return m_validationOptions; }
         ComPtr<IStream> GetResource(const std::string& resource) override;
+        ThreadPool& GetThreadPool() override { return m_threadPool; }
 
         // IXmlFactory
         MSIX::ComPtr<IXmlDom> CreateDomFromStream(XmlContentType footPrintType, const ComPtr<IStream>& stream) override
@@ -56,11 +65,17 @@ namespace MSIX {
             return m_xmlFactory->CreateDomFromStream(footPrintType, stream);
         }
 
+        bool ForEachElementInStream(XmlContentType footPrintType, const ComPtr<IStream>& stream, XmlElementVisitor& visitor) override
+        {
+            return m_xmlFactory->ForEachElementInStream(footPrintType, stream, visitor);
+        }
+
         ComPtr<IXmlFactory> m_xmlFactory;
         COTASKMEMALLOC* m_memalloc;
         COTASKMEMFREE*  m_memfree;
         MSIX_VALIDATION_OPTION m_validationOptions;
         ComPtr<IStorageObject> m_resourcezip;
         std::vector<std::uint8_t> m_resourcesVector;
+        ThreadPool m_threadPool;
     };
 }
\ No newline at end of file
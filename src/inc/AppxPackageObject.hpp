@@ -21,6 +21,7 @@
 #include "AppxBlockMapObject.hpp"
 #include "AppxSignature.hpp"
 #include "AppxFactory.hpp"
+#include "PackageIndex.hpp"
 
 // internal interface
 EXTERN_C const IID IID_IPackage;   
@@ -74,6 +75,7 @@ namespace MSIX {
     {
     public:
         AppxManifestObject(IXmlFactory* factory, const ComPtr<IStream>& stream);
+        AppxManifestObject(const ComPtr<IStream>& stream, const PackageIndex& index);
 
         // IVerifierObject
         const std::string& GetPublisher() override { return GetPackageId()->Publisher; }
@@ -90,12 +92,18 @@ namespace MSIX {
     };
 
     // Storage object representing the entire AppxPackage
-    class AppxPackageObject final : public ComClass<AppxPackageObject, IAppxPackageReader, IPackage, IStorageObject>
+    class AppxPackageObject final : public ComClass<AppxPackageObject, IAppxPackageReader, IPackage, IStorageObject, IMsixPackageVerifier>
     {
     public:
         AppxPackageObject(IMSIXFactory* factory, MSIX_VALIDATION_OPTION validation, const ComPtr<IStorageObject>& container);
+
+        // Opens a package that was validated when 'index' was written for it, and is unchanged since.
+        AppxPackageObject(IMSIXFactory* factory, MSIX_VALIDATION_OPTION validation, const ComPtr<IStorageObject>& container, const PackageIndex& index);
         ~AppxPackageObject() {}
 
+        // Adds what opening the package established to 'index'; the container's part of it is left to the caller.
+        void Describe(PackageIndex& index);
+
         // internal IPackage methods
         void Unpack(MSIX_PACKUNPACK_OPTION options, const ComPtr<IStorageObject>& to) override;
 
@@ -106,6 +114,9 @@ namespace MSIX {
         HRESULT STDMETHODCALLTYPE GetPayloadFiles(IAppxFilesEnumerator**  filesEnumerator) noexcept override;
         HRESULT STDMETHODCALLTYPE GetManifest(IAppxManifestReader**  manifestReader) noexcept override;
 
+        // IMsixPackageVerifier
+        HRESULT STDMETHODCALLTYPE VerifyPayloadFiles(MSIX_VERIFY_FILE_CALLBACK* callback, void* context) noexcept override;
+
         // returns a list of the footprint files found within this package.
         std::vector<std::string>& GetFootprintFiles() override { return m_footprintFiles; }
 
@@ -113,18 +124,27 @@ namespace MSIX {
         const char*               GetPathSeparator() override;
         std::vector<std::string>  GetFileNames(FileNameOptions options) override;
         ComPtr<IStream>           GetFile(const std::string& fileName) override;
+        void                      PrepareFiles() override {} // all files are prepared when the package is opened
+        bool                      SupportsConcurrentReads() override { return m_container->SupportsConcurrentReads(); }
 
         ComPtr<IStream>           OpenFile(const std::string& fileName, MSIX::FileStream::Mode mode) override;
         void                      CommitChanges() override;
 
     protected:
+        void AddFootprintFiles(std::vector<std::string>& filesToProcess);
+        std::vector<std::string> GetExtractionOrder();
+        std::string GetTargetName(MSIX_PACKUNPACK_OPTION options, const std::string& fileName);
+        void UnpackFile(MSIX_PACKUNPACK_OPTION options, const std::string& fileName, const ComPtr<IStorageObject>& to);
+        void UnpackPipelined(MSIX_PACKUNPACK_OPTION options, const ComPtr<IZipArchive>& archive, const ComPtr<IStorageObject>& to);
+        HRESULT VerifyFile(const ComPtr<IStream>& stream) noexcept;
+
         std::map<std::string, ComPtr<IStream>>  m_streams;
 
         MSIX_VALIDATION_OPTION      m_validation = MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_FULL;
         ComPtr<IMSIXFactory>        m_factory;
-        ComPtr<IVerifierObject>     m_appxSignature;
+        ComPtr<AppxSignatureObject> m_appxSignature;
         ComPtr<IVerifierObject>     m_appxBlockMap;
-        ComPtr<IVerifierObject>     m_appxManifest;
+        ComPtr<AppxManifestObject>  m_appxManifest;
         ComPtr<IStorageObject>      m_container;
         
         std::vector<std::string>    m_payloadFiles;
@@ -2000,16 +2000,37 @@ enum MSIX_VALIDATION_OPTION
         MSIX_VALIDATION_OPTION_FULL                        = 0x0,
         MSIX_VALIDATION_OPTION_SKIPSIGNATURE               = 0x1,
         MSIX_VALIDATION_OPTION_ALLOWSIGNATUREORIGINUNKNOWN = 0x2,
-        MSIX_VALIDATION_OPTION_SKIPAPPXMANIFEST            = 0x4
+        MSIX_VALIDATION_OPTION_SKIPAPPXMANIFEST            = 0x4,
+        // Keeps what opening a package file established in a sidecar index (<package>.msixindex) and, as long as the
+        // package is unchanged, opens it from there next time instead of parsing and validating it all over again.
+        // The index is trusted like the package itself, so it must only be writable by whoever can write the package.
+        MSIX_VALIDATION_OPTION_USEPACKAGEINDEX             = 0x8
     }   MSIX_VALIDATION_OPTION;
 
 typedef /* [v1_enum] */
 enum MSIX_PACKUNPACK_OPTION
     {
         MSIX_PACKUNPACK_OPTION_NONE                    = 0x0,
-        MSIX_PACKUNPACK_OPTION_CREATEPACKAGESUBFOLDER  = 0x1
+        MSIX_PACKUNPACK_OPTION_CREATEPACKAGESUBFOLDER  = 0x1,
+        // Extracts files on the factory's threads, largest first, when the package can be read concurrently. If
+        // files fail, the failure reported is that of the first of them in the order files are otherwise extracted.
+        MSIX_PACKUNPACK_OPTION_UNPACKINPARALLEL        = 0x2,
+        // Extracts the payload files of a package file through a pipeline that reads the package, inflates, checks
+        // and writes them on threads of their own, all at the same time. Takes precedence over UNPACKINPARALLEL.
+        MSIX_PACKUNPACK_OPTION_UNPACKPIPELINED         = 0x4
     }   MSIX_PACKUNPACK_OPTION;
 
+// Process wide counters describing the I/O the library has done, for diagnostic purposes.
+typedef /* [v1_enum] */
+enum MSIX_COUNTER
+    {
+        MSIX_COUNTER_ZIP_LOCAL_HEADER_READS          = 0x0, // reads issued to fetch zip local file headers
+        MSIX_COUNTER_ZIP_LOCAL_HEADERS               = 0x1, // zip local file headers parsed
+        MSIX_COUNTER_ZIP_LOCAL_HEADER_BACKWARD_SEEKS = 0x2, // local file header reads at a lower offset than the previous one
+        MSIX_COUNTER_BLOCKS_INFLATED_IN_PARALLEL     = 0x3, // blockmap blocks inflated and validated on a thread pool
+        MSIX_COUNTER_MAX                             = 0x4
+    }   MSIX_COUNTER;
+
 MSIX_API HRESULT STDMETHODCALLTYPE UnpackPackage(
     MSIX_PACKUNPACK_OPTION packUnpackOptions,
     MSIX_VALIDATION_OPTION validationOption,
@@ -2017,6 +2038,59 @@ MSIX_API HRESULT STDMETHODCALLTYPE UnpackPackage(
     char* utf8Destination
 ) noexcept;
 
+// Reports the outcome of verifying one payload file. Calls are serialized, but may come from any thread and in any order.
+typedef void STDMETHODCALLTYPE MSIX_VERIFY_FILE_CALLBACK(
+    void* context,
+    const char* utf8FileName,
+    UINT64 size,
+    HRESULT result);
+
+#ifndef __IMsixPackageVerifier_INTERFACE_DEFINED__
+#define __IMsixPackageVerifier_INTERFACE_DEFINED__
+
+/* interface IMsixPackageVerifier */
+/* [ref][uuid][object] */
+MSIX_IID_API const IID IID_IMsixPackageVerifier;
+
+    // Implemented by package readers. Reads every payload file of the package, checking its data against the
+    // blockmap, without extracting it. Files are verified on the factory's threads when the package can be read
+    // concurrently. Returns S_OK when every file is intact, otherwise the first failure; 'callback' may be null.
+    // {3f1f8c6e-95b4-4a3a-b0f2-6d2c1e7a4b58}
+    interface IMsixPackageVerifier : public IUnknown
+    {
+    public:
+        virtual HRESULT STDMETHODCALLTYPE VerifyPayloadFiles(
+            /* [in] */ MSIX_VERIFY_FILE_CALLBACK* callback,
+            /* [in] */ void* context) noexcept = 0;
+    };
+#endif 	/* __IMsixPackageVerifier_INTERFACE_DEFINED__ */
+
+#ifndef __IMsixFactoryConcurrency_INTERFACE_DEFINED__
+#define __IMsixFactoryConcurrency_INTERFACE_DEFINED__
+
+/* interface IMsixFactoryConcurrency */
+/* [ref][uuid][object] */
+MSIX_IID_API const IID IID_IMsixFactoryConcurrency;
+
+    // Implemented by factories. Sets the number of threads, including the calling one, that the factory's packages
+    // spread work across, such as verifying or unpacking files and inflating the blocks of large files. 0, the
+    // default, means one per hardware thread. It can only be changed before the factory's threads are first used.
+    // {9d4c7b21-6a3e-4f85-b1d2-0e8f5a3c6b94}
+    interface IMsixFactoryConcurrency : public IUnknown
+    {
+    public:
+        virtual HRESULT STDMETHODCALLTYPE SetConcurrency(
+            /* [in] */ UINT32 threads) noexcept = 0;
+    };
+#endif 	/* __IMsixFactoryConcurrency_INTERFACE_DEFINED__ */
+
+MSIX_API HRESULT STDMETHODCALLTYPE VerifyPackage(
+    MSIX_VALIDATION_OPTION validationOption,
+    char* utf8SourcePackage,
+    MSIX_VERIFY_FILE_CALLBACK* callback,
+    void* context
+) noexcept;
+
 // A call to called CoCreateAppxFactory is required before start using the factory on non-windows platforms specifying 
 // their allocator/de-allocator pair of preference. Failure to do this will result on E_UNEXPECTED.
 typedef LPVOID STDMETHODCALLTYPE COTASKMEMALLOC(SIZE_T cb);
@@ -2024,6 +2098,8 @@ typedef void STDMETHODCALLTYPE COTASKMEMFREE(LPVOID pv);
 
 MSIX_API HRESULT STDMETHODCALLTYPE GetLogTextUTF8(COTASKMEMALLOC* memalloc, char** logText) noexcept;
 
+MSIX_API HRESULT STDMETHODCALLTYPE GetCounter(MSIX_COUNTER counter, UINT64* value) noexcept;
+
 // Call specific for Windows. Default to call CoTaskMemAlloc and CoTaskMemFree
 MSIX_API HRESULT STDMETHODCALLTYPE CoCreateAppxFactory(
     MSIX_VALIDATION_OPTION validationOption,
@@ -2128,5 +2204,7 @@ SpecializeUuidOfImpl(IAppxEncryptionFactory3);
 SpecializeUuidOfImpl(IAppxEncryptedPackageWriter);
 SpecializeUuidOfImpl(IAppxEncryptedBundleWriter);
 SpecializeUuidOfImpl(IAppxEncryptedBundleWriter2);
+SpecializeUuidOfImpl(IMsixPackageVerifier);
+SpecializeUuidOfImpl(IMsixFactoryConcurrency);
 
 #endif //__appxpackaging_hpp__
\ No newline at end of file
@@ -9,8 +9,12 @@
 #include "StreamBase.hpp"
 #include "AppxFactory.hpp"
 
+#include <functional>
+
 namespace MSIX {
 
+    struct PackageIndex;
+
     enum class SignatureOrigin
     {
         Windows,    // chains to the Windows RCA
@@ -63,15 +67,25 @@ namespace MSIX {
 
         AppxSignatureObject(IMSIXFactory* factory, MSIX_VALIDATION_OPTION validationOptions,const ComPtr<IStream>& stream);
 
+        // Restores the results of validating the signature from a package index, instead of validating it again.
+        AppxSignatureObject(MSIX_VALIDATION_OPTION validationOptions, const ComPtr<IStream>& stream, const PackageIndex& index);
+
         // IVerifierObject
         const std::string& GetPublisher() override  { return m_publisher; }
         bool HasStream() override                   { return !!m_stream; }
         ComPtr<IStream> GetStream() override        { return m_stream; }
         ComPtr<IStream> GetValidationStream(const std::string& part, const ComPtr<IStream>& stream) override;
 
+        // Like GetValidationStream, but 'parse' reads the part through a stream that hashes it as it's read, instead
+        // of validating all of it before the first read. Once 'parse' returns, the stream is validated before any
+        // read again, so it can be handed out.
+        ComPtr<IStream> ParseValidationStream(const std::string& part, const ComPtr<IStream>& stream,
+            const std::function<void(const ComPtr<IStream>&)>& parse);
+
         void ValidateDigestHeader(DigestHeader* header, std::size_t numberOfHashes, std::size_t modHashes);
 
         SignatureOrigin GetSignatureOrigin() { return m_signatureOrigin; }
+        bool HasDigests()                    { return m_hasDigests; }
 
         using Digest = std::vector<std::uint8_t>;        
         Digest& GetFileRecordsDigest()       { return m_FileRecords; }
@@ -81,6 +95,8 @@ namespace MSIX {
         Digest& GetCodeIntegrityDigest()     { return m_CodeIntegrity; }
 
     protected:
+        Digest* GetPartDigest(const std::string& part);
+
         bool                         m_hasDigests;
         Digest                       m_FileRecords;
         Digest                       m_CentralDirectory;
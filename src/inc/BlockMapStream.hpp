@@ -1,83 +1,87 @@
 //
 //  Copyright (C) 2017 Microsoft.  All rights reserved.
 //  See LICENSE file in the project root for full license information.
-// 
+//
 #pragma once
 #define NOMINMAX /* windows.h, or more correctly windef.h, defines min as a macro... */
 #include "MSIXWindows.hpp"
 #include "Exceptions.hpp"
 #include "StreamBase.hpp"
-#include "RangeStream.hpp"
-#include "HashStream.hpp"
 #include "ComHelper.hpp"
 #include "SHA256.hpp"
 #include "AppxFactory.hpp"
+#include "ThreadPool.hpp"
+#include "Counters.hpp"
 
+#include <array>
+#include <atomic>
+#include <cstring>
 #include <string>
 #include <map>
 #include <functional>
 #include <algorithm>
+#include <limits>
 #include <vector>
 
 namespace MSIX {
-  
+
     const std::uint64_t BLOCKMAP_BLOCK_SIZE = 65536; // 64KB
 
+    // Compressed files at least this large are inflated on the factory's threads, this many blocks per thread at a time.
+    const std::uint64_t PARALLEL_INFLATE_MINIMUM_SIZE = 16 * BLOCKMAP_BLOCK_SIZE;
+    const std::size_t   PARALLEL_INFLATE_BLOCKS_PER_THREAD = 8;
+
+    const std::size_t BLOCKMAP_HASH_SIZE = 32; // blocks are hashed with SHA256
+
     typedef struct Block
     {
         std::uint64_t compressedSize;
-        std::vector<std::uint8_t> hash;
+        std::array<std::uint8_t, BLOCKMAP_HASH_SIZE> hash;
     } Block;
 
-    typedef struct BlockPlusStream : Block
+    // The blocks of one file. A blockmap keeps the blocks of all of its files in a single array, one file's after
+    // another, and hands out spans of it.
+    class BlockSpan
     {
-        std::uint64_t   size;
-        std::uint64_t   offset;         
-        ComPtr<IStream> stream;
-    } BlockPlusStream;
+    public:
+        BlockSpan() = default;
+        BlockSpan(const Block* blocks, std::size_t count) : m_blocks(blocks), m_count(count) {}
 
-    // This represents a subset of a Stream
+        const Block* begin() const { return m_blocks; }
+        const Block* end() const   { return m_blocks + m_count; }
+        std::size_t size() const   { return m_count; }
+        bool empty() const         { return m_count == 0; }
+        const Block& operator[](std::size_t index) const { return m_blocks[index]; }
+
+    protected:
+        const Block* m_blocks = nullptr;
+        std::size_t  m_count = 0;
+    };
+
+    // Validates a file against its blocks in the blockmap as it is read. Every block but the last is BLOCKMAP_BLOCK_SIZE
+    // bytes, so the block holding any offset is computed rather than looked up, and nothing is set up per block until
+    // the file is first read.
     class BlockMapStream final : public StreamBase
     {
     public:
-        BlockMapStream(IMSIXFactory* factory, std::string decodedName, const ComPtr<IStream>& stream, std::vector<Block>& blocks)
-            : m_factory(factory), m_decodedName(decodedName), m_stream(stream)
+        // 'blocks' belong to 'blockMap', which the stream keeps alive for as long as it uses them.
+        BlockMapStream(IMSIXFactory* factory, std::string decodedName, const ComPtr<IStream>& stream,
+            const BlockSpan& blocks, const ComPtr<IAppxBlockMapReader>& blockMap)
+            : m_blocks(blocks), m_decodedName(decodedName), m_stream(stream), m_blockMap(blockMap), m_factory(factory)
         {
             // Determine overall stream size
             ULARGE_INTEGER uli;
             LARGE_INTEGER li;
             li.QuadPart = 0;
             ThrowHrIfFailed(stream->Seek(li, STREAM_SEEK_END, &uli));
-            
             m_streamSize = uli.QuadPart;
-
-            // Reset seek position to beginning
-            li.QuadPart = 0;
-            ThrowHrIfFailed(stream->Seek(li, STREAM_SEEK_SET, nullptr));
-
-            // Build a vector of all HashStream->RangeStream's for the blocks in the blockmap
-            std::uint64_t offset = 0;
-            std::uint64_t sizeRemaining = m_streamSize;
-            for (auto block = blocks.begin(); ((sizeRemaining != 0) && (block != blocks.end())); block++)
-            {
-                auto rangeStream = ComPtr<IStream>::Make<RangeStream>(offset, std::min(sizeRemaining, BLOCKMAP_BLOCK_SIZE), stream);                
-                auto hashStream = ComPtr<IStream>::Make<HashStream>(rangeStream, block->hash);
-                std::uint64_t blockSize = std::min(sizeRemaining, BLOCKMAP_BLOCK_SIZE);
-
-                BlockPlusStream bs;
-                bs.offset = offset;
-                bs.size   = blockSize;
-                bs.stream = hashStream;
-                bs.hash   = block->hash;
-                m_blockStreams.emplace_back(std::move(bs));
-                
-                offset          += blockSize;
-                sizeRemaining   -= blockSize;
-            }
+            m_blockCount = static_cast<std::size_t>(std::min(static_cast<std::uint64_t>(blocks.size()),
+                (m_streamSize + BLOCKMAP_BLOCK_SIZE - 1) / BLOCKMAP_BLOCK_SIZE));
 
             // Reset seek position to beginning
             ThrowHrIfFailed(stream->Seek(li, STREAM_SEEK_SET, nullptr));
             ThrowHrIfFailed(Seek(li, STREAM_SEEK_SET, nullptr));
+            stream->QueryInterface(UuidOfImpl<IStreamInternal>::iid, reinterpret_cast<void**>(&m_streamInternal));
         }
 
         HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER move, DWORD origin, ULARGE_INTEGER *newPosition) noexcept override try
@@ -97,48 +101,98 @@ namespace MSIX {
             }
             m_relativePosition = std::max((std::uint64_t)0, std::min(m_relativePosition, m_streamSize));
             if (newPosition) { newPosition->QuadPart = m_relativePosition; }
-
-            m_currentBlock = m_blockStreams.begin();
             return S_OK;
         } CATCH_RETURN();
 
         HRESULT STDMETHODCALLTYPE Read(void* buffer, ULONG countBytes, ULONG* actualRead) noexcept override try
         {
-            std::uint32_t bytesRead = 0;
-            if (m_relativePosition < m_streamSize)
+            ULONG bytesRead = ReadAt(m_relativePosition, buffer, countBytes);
+            m_relativePosition += bytesRead;
+            if (actualRead) { *actualRead = bytesRead; }
+            return (countBytes == bytesRead) ? S_OK : S_FALSE;
+        } CATCH_RETURN();
+
+        HRESULT STDMETHODCALLTYPE CopyTo(IStream* stream, ULARGE_INTEGER bytesCount, ULARGE_INTEGER* bytesRead, ULARGE_INTEGER* bytesWritten) noexcept override try
+        {
+            if (bytesRead) { bytesRead->QuadPart = 0; }
+            if (bytesWritten) { bytesWritten->QuadPart = 0; }
+            ThrowErrorIf(Error::InvalidParameter, (nullptr == stream), "invalid parameter.");
+
+            std::uint64_t copied = CopyBlocksInParallel(stream, bytesCount.QuadPart);
+            ULARGE_INTEGER read = {0};
+            ULARGE_INTEGER written = {0};
+            bytesCount.QuadPart -= copied;
+            if (bytesCount.QuadPart != 0)
+            {   ThrowHrIfFailed(StreamBase::CopyTo(stream, bytesCount, &read, &written));
+            }
+            if (bytesRead)      { bytesRead->QuadPart = copied + read.QuadPart; }
+            if (bytesWritten)   { bytesWritten->QuadPart = copied + written.QuadPart; }
+            return static_cast<HRESULT>(Error::OK);
+        } CATCH_RETURN();
+
+        // IStreamInternal
+        // Neither the underlying mapped bytes nor its file are handed out: they could change between being validated
+        // and being used, so the only bytes that leave the stream are the ones ReadAt validated in the caller's buffer.
+        ULONG GetPreferredIOSize() override { return static_cast<ULONG>(BLOCKMAP_BLOCK_SIZE); }
+
+        ULONG ReadAt(std::uint64_t offset, void* buffer, ULONG countBytes) override
+        {
+            if (offset >= m_streamSize) { return 0; }
+            PrepareBlocks();
+
+            ULONG bytesRead = 0;
+            ULONG bytesToRead = static_cast<ULONG>(std::min(static_cast<std::uint64_t>(countBytes), m_streamSize - offset));
+            std::uint8_t* bytes = static_cast<std::uint8_t*>(buffer);
+            while (bytesToRead > 0)
             {
-                std::uint32_t bytesToRead = std::min(static_cast<std::uint32_t>(countBytes), static_cast<std::uint32_t>(m_streamSize - m_relativePosition));
-                while (m_currentBlock != m_blockStreams.end() && bytesToRead > 0)
+                std::size_t index = static_cast<std::size_t>(offset / BLOCKMAP_BLOCK_SIZE);
+                if (index >= m_blockCount) { break; }
+                std::uint64_t positionInBlock = offset - BlockOffset(index);
+                std::uint64_t end = offset + bytesToRead;
+
+                // Runs of whole blocks that haven't been validated yet are read straight into the caller's buffer and
+                // validated there; a partial one goes through the block buffer so the rest of it is at hand next time.
+                // Blocks that have been validated are read from the underlying stream as they are.
+                ULONG count = 0;
+                if (!m_validated[index] && (positionInBlock == 0) && (BlockEnd(index) <= end))
                 {
-                    if ((m_currentBlock->offset + m_currentBlock->size) <= m_relativePosition)
-                    {
-                        m_currentBlock++;
-                    }
-                    else if (m_currentBlock->offset <= m_relativePosition)
-                    {
-                        std::uint64_t positionInBlock = m_relativePosition - m_currentBlock->offset;
-                        LARGE_INTEGER li{0};
-                        li.QuadPart = positionInBlock;
-                        ThrowHrIfFailed(m_currentBlock->stream->Seek(li, STREAM_SEEK_SET, nullptr));
-
-                        std::uint32_t count = std::min(bytesToRead, static_cast<std::uint32_t>(m_currentBlock->size - positionInBlock));
-                        ULONG actual = 0;
-                        ThrowHrIfFailed(m_currentBlock->stream->Read(buffer, count, &actual));
-
-                        buffer = static_cast<std::uint8_t*>(buffer) + actual;
-                        m_relativePosition += actual;
-                        bytesToRead -= actual;
-                        bytesRead += actual;
-                    }
-                    else
-                    {
-                        m_currentBlock = m_blockStreams.begin();
+                    std::size_t last = index + 1;
+                    while ((last < m_blockCount) && !m_validated[last] && (BlockEnd(last) <= end)) { last++; }
+                    count = static_cast<ULONG>(BlockEnd(last - 1) - offset);
+                    ULONG actual = StreamBase::ReadAt(m_stream.Get(), m_streamInternal.Get(), offset, bytes, count);
+                    ThrowErrorIf(Error::FileRead, (actual != count), "read failed");
+
+                    std::vector<std::size_t> indices(last - index);
+                    std::vector<const std::uint8_t*> data(last - index);
+                    for (std::size_t i = 0; i < indices.size(); i++)
+                    {   indices[i] = index + i;
+                        data[i] = bytes + (i * BLOCKMAP_BLOCK_SIZE);
                     }
+                    VerifyBlocksInParallel(indices.data(), data.data(), indices.size());
+                    for (auto validated : indices) { m_validated[validated] = true; }
+                }
+                else if (!m_validated[index] || (index == m_bufferedBlock))
+                {
+                    if (index != m_bufferedBlock) { LoadBlock(index); }
+                    count = static_cast<ULONG>(std::min(end, BlockEnd(index)) - offset);
+                    std::memcpy(bytes, m_blockBuffer.data() + positionInBlock, count);
+                }
+                else
+                {
+                    std::size_t last = index + 1;
+                    while ((last < m_blockCount) && m_validated[last] && (BlockOffset(last) < end)) { last++; }
+                    count = static_cast<ULONG>(std::min(end, BlockEnd(last - 1)) - offset);
+                    ULONG actual = StreamBase::ReadAt(m_stream.Get(), m_streamInternal.Get(), offset, bytes, count);
+                    ThrowErrorIf(Error::FileRead, (actual != count), "read failed");
                 }
+
+                bytes += count;
+                offset += count;
+                bytesToRead -= count;
+                bytesRead += count;
             }
-            if (actualRead) { *actualRead = bytesRead; }
-            return (countBytes == bytesRead) ? S_OK : S_FALSE;
-        } CATCH_RETURN();
+            return bytesRead;
+        }
 
         HRESULT STDMETHODCALLTYPE GetCompressionOption(APPX_COMPRESSION_OPTION* compressionOption) noexcept override try
         {
@@ -154,20 +208,156 @@ namespace MSIX {
         {
             return m_stream.As<IAppxFile>()->GetContentType(contentType);
         } CATCH_RETURN();
-        
+
         HRESULT STDMETHODCALLTYPE GetSize(UINT64* size) noexcept override try
         {
             if (size) { *size = m_streamSize; }
             return static_cast<HRESULT>(Error::OK);
         } CATCH_RETURN();
-      
+
     protected:
-        std::vector<BlockPlusStream>::iterator m_currentBlock;
-        std::vector<BlockPlusStream> m_blockStreams;
+        static const std::size_t NO_BLOCK = std::numeric_limits<std::size_t>::max();
+
+        std::uint64_t BlockOffset(std::size_t index) { return index * BLOCKMAP_BLOCK_SIZE; }
+        std::uint64_t BlockEnd(std::size_t index)    { return std::min(BlockOffset(index + 1), m_streamSize); }
+        std::uint64_t BlockSize(std::size_t index)   { return BlockEnd(index) - BlockOffset(index); }
+
+        // Sets up what validating the file needs, the first time any of it is read.
+        void PrepareBlocks()
+        {
+            if (m_prepared) { return; }
+            m_validated.assign(m_blockCount, false);
+
+            // Let a compressed stream know where its blocks are, so that it can decompress any one of them on its own.
+            if (m_streamInternal)
+            {
+                std::vector<std::uint64_t> compressedSizes;
+                compressedSizes.reserve(m_blocks.size());
+                for (const auto& block : m_blocks) { compressedSizes.push_back(block.compressedSize); }
+                m_streamInternal->SetCompressedBlocks(BLOCKMAP_BLOCK_SIZE, compressedSizes);
+            }
+            m_prepared = true;
+        }
+
+        // Reads the block at 'index' into the block buffer and validates it.
+        void LoadBlock(std::size_t index)
+        {
+            m_blockBuffer.resize(static_cast<size_t>(BLOCKMAP_BLOCK_SIZE));
+            m_bufferedBlock = NO_BLOCK;
+            ULONG size = static_cast<ULONG>(BlockSize(index));
+            ULONG read = StreamBase::ReadAt(m_stream.Get(), m_streamInternal.Get(), BlockOffset(index), m_blockBuffer.data(), size);
+            ThrowErrorIf(Error::FileRead, (read != size), "read failed");
+            const std::uint8_t* data = m_blockBuffer.data();
+            VerifyBlocks(&index, &data, 1);
+            m_validated[index] = true;
+            m_bufferedBlock = index;
+        }
+
+        // Checks the blocks at 'indices', whose bytes are at 'data', against the blockmap, hashing them side by side.
+        void VerifyBlocks(const std::size_t* indices, const std::uint8_t* const* data, std::size_t count)
+        {
+            std::vector<std::size_t> sizes(count);
+            std::vector<std::vector<std::uint8_t>> hashes(count);
+            for (std::size_t i = 0; i < count; i++) { sizes[i] = static_cast<std::size_t>(BlockSize(indices[i])); }
+            SHA256::ComputeHashes(count, data, sizes.data(), hashes.data());
+            for (std::size_t i = 0; i < count; i++)
+            {   const auto& expected = m_blocks[indices[i]].hash;
+                ThrowErrorIfNot(Error::SignatureInvalid,
+                    (hashes[i].size() == expected.size()) && std::equal(expected.begin(), expected.end(), hashes[i].begin()),
+                    "Signature hash doesn't match digest hash");
+            }
+        }
+
+        // As VerifyBlocks, spreading the blocks across the factory's threads a group at a time.
+        void VerifyBlocksInParallel(const std::size_t* indices, const std::uint8_t* const* data, std::size_t count)
+        {
+            if (count <= PARALLEL_INFLATE_BLOCKS_PER_THREAD)
+            {   VerifyBlocks(indices, data, count);
+                return;
+            }
+            std::size_t groups = (count + PARALLEL_INFLATE_BLOCKS_PER_THREAD - 1) / PARALLEL_INFLATE_BLOCKS_PER_THREAD;
+            m_factory->GetThreadPool().ForEach(groups, [&](std::size_t group)
+            {
+                std::size_t begin = group * PARALLEL_INFLATE_BLOCKS_PER_THREAD;
+                VerifyBlocks(indices + begin, data + begin, std::min(PARALLEL_INFLATE_BLOCKS_PER_THREAD, count - begin));
+            });
+        }
+
+        // Inflates and validates the blocks of a compressed file a batch at a time on the factory's threads, writing
+        // each batch to 'stream' in order. Returns how many bytes that copied, which falls short of 'bytesCount' when
+        // the file is too small to be worth it or its blocks turn out not to be independent; CopyTo does the rest.
+        // Nothing is allocated or handed to the threads for files that aren't compressed in independent blocks.
+        std::uint64_t CopyBlocksInParallel(IStream* stream, std::uint64_t bytesCount)
+        {
+            ThreadPool& pool = m_factory->GetThreadPool();
+            std::uint64_t count = std::min(bytesCount, m_streamSize - m_relativePosition);
+            if (!m_streamInternal || (pool.GetConcurrency() < 2) || (count < PARALLEL_INFLATE_MINIMUM_SIZE) ||
+                ((m_relativePosition % BLOCKMAP_BLOCK_SIZE) != 0))
+            {   return 0;
+            }
+            APPX_COMPRESSION_OPTION compressionOption;
+            ThrowHrIfFailed(GetCompressionOption(&compressionOption));
+            if (compressionOption == APPX_COMPRESSION_OPTION_NONE) { return 0; }
+            PrepareBlocks();
+            if (!m_streamInternal->HasCompressedBlocks()) { return 0; }
+
+            std::size_t batchBlocks = pool.GetConcurrency() * PARALLEL_INFLATE_BLOCKS_PER_THREAD;
+            std::vector<std::uint8_t> batch(static_cast<size_t>(batchBlocks * BLOCKMAP_BLOCK_SIZE));
+            std::uint64_t copied = 0;
+            while (copied < count)
+            {
+                std::size_t first = static_cast<std::size_t>(m_relativePosition / BLOCKMAP_BLOCK_SIZE);
+                std::uint64_t length = std::min(count - copied, static_cast<std::uint64_t>(batchBlocks * BLOCKMAP_BLOCK_SIZE));
+                std::size_t blocks = static_cast<std::size_t>((length + BLOCKMAP_BLOCK_SIZE - 1) / BLOCKMAP_BLOCK_SIZE);
+                std::atomic<bool> independent(first + blocks <= m_blockCount);
+                std::size_t groups = (blocks + PARALLEL_INFLATE_BLOCKS_PER_THREAD - 1) / PARALLEL_INFLATE_BLOCKS_PER_THREAD;
+                pool.ForEach(groups, [&](std::size_t group)
+                {   // Each thread inflates its blocks and then hashes them together.
+                    std::size_t indices[PARALLEL_INFLATE_BLOCKS_PER_THREAD];
+                    const std::uint8_t* data[PARALLEL_INFLATE_BLOCKS_PER_THREAD];
+                    std::size_t begin = group * PARALLEL_INFLATE_BLOCKS_PER_THREAD;
+                    std::size_t count = std::min(PARALLEL_INFLATE_BLOCKS_PER_THREAD, blocks - begin);
+                    for (std::size_t i = 0; i < count; i++)
+                    {
+                        std::uint8_t* blockData = batch.data() + ((begin + i) * BLOCKMAP_BLOCK_SIZE);
+                        if (!independent || !m_streamInternal->DecompressBlock(first + begin + i, blockData))
+                        {   independent = false;
+                            return;
+                        }
+                        indices[i] = first + begin + i;
+                        data[i] = blockData;
+                    }
+                    VerifyBlocks(indices, data, count);
+                });
+                if (!independent) { break; }
+
+                std::uint64_t offset = 0;
+                while (offset < length)
+                {
+                    ULONG written = 0;
+                    ThrowHrIfFailed(stream->Write(batch.data() + offset, static_cast<ULONG>(length - offset), &written));
+                    ThrowErrorIf(Error::FileWrite, (written == 0), "write failed");
+                    offset += written;
+                }
+                Global::Counters::Increment(MSIX_COUNTER_BLOCKS_INFLATED_IN_PARALLEL, blocks);
+                m_relativePosition += length;
+                copied += length;
+            }
+            return copied;
+        }
+
+        BlockSpan m_blocks;
+        std::size_t m_blockCount;               // the blocks that hold the file's bytes, at most one per BLOCKMAP_BLOCK_SIZE
+        bool m_prepared = false;
+        std::vector<bool> m_validated;          // whether each block's bytes in the underlying stream have been checked
+        std::vector<std::uint8_t> m_blockBuffer;
+        std::size_t m_bufferedBlock = NO_BLOCK; // the block in m_blockBuffer
         std::uint64_t m_relativePosition;
         std::uint64_t m_streamSize;
         std::string m_decodedName;
         ComPtr<IStream> m_stream;
+        ComPtr<IStreamInternal> m_streamInternal;
+        ComPtr<IAppxBlockMapReader> m_blockMap;
         IMSIXFactory* m_factory;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,17 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+// 
+#pragma once
+#include "AppxPackaging.hpp"
+
+#include <cstdint>
+
+namespace MSIX {
+    namespace Global { 
+        namespace Counters {
+            void Increment(MSIX_COUNTER counter, std::uint64_t value = 1);
+            std::uint64_t Get(MSIX_COUNTER counter);
+        }
+    }
+}
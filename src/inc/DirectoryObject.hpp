@@ -8,6 +8,7 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <mutex>
 
 #include "Exceptions.hpp"
 #include "StreamBase.hpp"
@@ -25,11 +26,14 @@ namespace MSIX {
         const char*              GetPathSeparator() override;
         std::vector<std::string> GetFileNames(FileNameOptions options) override;
         ComPtr<IStream>          GetFile(const std::string& fileName) override;
+        void                     PrepareFiles() override {}
+        bool                     SupportsConcurrentReads() override { return false; }
 
         ComPtr<IStream>          OpenFile(const std::string& fileName, MSIX::FileStream::Mode mode) override;
         void                     CommitChanges() override;
 
     protected:
+        std::mutex m_lock; // guards m_streams; files may be opened from several threads at once while unpacking
         std::map<std::string, ComPtr<IStream>> m_streams;
         std::string m_root;
 
@@ -11,13 +11,19 @@
 #include "Exceptions.hpp"
 #include "StreamBase.hpp"
 
+#ifndef WIN32
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
 namespace MSIX {
     class FileStream final : public StreamBase
     {
     public:
         enum Mode { READ = 0, WRITE, APPEND, READ_UPDATE, WRITE_UPDATE, APPEND_UPDATE };
 
-        FileStream(const std::string& path, Mode mode)
+        FileStream(const std::string& path, Mode mode) : name(path)
         {
             static const char* modes[] = { "rb", "wb", "ab", "r+b", "w+b", "a+b" };
             #ifdef WIN32
@@ -47,9 +53,28 @@ namespace MSIX {
 
         HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER move, DWORD origin, ULARGE_INTEGER *newPosition) noexcept override try
         {
-            int rc = std::fseek(file, (long)move.QuadPart, origin);
+            #ifdef WIN32
+            int rc = _fseeki64(file, move.QuadPart, origin);
             ThrowErrorIfNot(Error::FileSeek, (rc == 0), "seek failed");
             offset = Ftell();
+            #else
+            // Reads and writes are positional, so seeking only moves our own offset.
+            std::int64_t newOffset = 0;
+            switch (origin)
+            {
+            case Reference::CURRENT:
+                newOffset = static_cast<std::int64_t>(offset) + move.QuadPart;
+                break;
+            case Reference::START:
+                newOffset = move.QuadPart;
+                break;
+            case Reference::END:
+                newOffset = static_cast<std::int64_t>(Fsize()) + move.QuadPart;
+                break;
+            }
+            ThrowErrorIf(Error::FileSeek, (newOffset < 0), "seek failed");
+            offset = static_cast<std::uint64_t>(newOffset);
+            #endif
             if (newPosition) { newPosition->QuadPart = offset; }
             return static_cast<HRESULT>(Error::OK);
         } CATCH_RETURN();
@@ -57,9 +82,14 @@ namespace MSIX {
         HRESULT STDMETHODCALLTYPE Read(void* buffer, ULONG countBytes, ULONG* bytesRead) noexcept override try
         {
             if (bytesRead) { *bytesRead = 0; }
+            #ifdef WIN32
             ULONG result = static_cast<ULONG>(std::fread(buffer, sizeof(std::uint8_t), countBytes, file));
             ThrowErrorIfNot(Error::FileRead, (result == countBytes || Feof()), "read failed");
             offset = Ftell();
+            #else
+            ULONG result = ReadAt(offset, buffer, countBytes);
+            offset += result;
+            #endif
             if (bytesRead) { *bytesRead = result; }
             return static_cast<HRESULT>(Error::OK);
         } CATCH_RETURN();
@@ -67,24 +97,86 @@ namespace MSIX {
         HRESULT STDMETHODCALLTYPE Write(const void *buffer, ULONG countBytes, ULONG *bytesWritten) noexcept override try
         {
             if (bytesWritten) { *bytesWritten = 0; }
+            #ifndef WIN32
+            // Writes still go through stdio's buffer, so only reposition the FILE* when our offset has moved.
+            if (filePosition != offset)
+            {
+                int rc = fseeko(file, static_cast<off_t>(offset), SEEK_SET);
+                ThrowErrorIfNot(Error::FileSeek, (rc == 0), "seek failed");
+            }
+            #endif
             ULONG result = static_cast<ULONG>(std::fwrite(buffer, sizeof(std::uint8_t), countBytes, file));
             ThrowErrorIfNot(Error::FileWrite, (result == countBytes), "write failed");
             offset = Ftell();
+            #ifndef WIN32
+            filePosition = offset;
+            pendingWrites = true;
+            #endif
             if (bytesWritten) { *bytesWritten = result; }
             return static_cast<HRESULT>(Error::OK);
         } CATCH_RETURN();
 
+        #ifndef WIN32
+        // IStreamInternal
+        ULONG ReadAt(std::uint64_t position, void* buffer, ULONG countBytes) override
+        {   // Make buffered writes visible before reading the file behind stdio's back.
+            if (pendingWrites) { Flush(); }
+            ULONG result = 0;
+            while (result < countBytes)
+            {
+                ssize_t count = pread(fileno(file), static_cast<std::uint8_t*>(buffer) + result, countBytes - result, static_cast<off_t>(position + result));
+                ThrowErrorIf(Error::FileRead, (count < 0), "read failed");
+                if (count == 0) { break; } // end of file
+                result += static_cast<ULONG>(count);
+            }
+            return result;
+        }
+
+        int GetFileDescriptor(std::uint64_t position, std::uint64_t, std::uint64_t* fileOffset) override
+        {   // Whoever writes to the descriptor does so behind stdio's back, so it must not be holding anything.
+            if (pendingWrites) { Flush(); }
+            *fileOffset = position;
+            return fileno(file);
+        }
+        #endif
+
+        std::string GetFilePath() override { return name; }
+
     protected:
         inline int Ferror() { return std::ferror(file); }
         inline bool Feof()  { return 0 != std::feof(file); }
-        inline void Flush() { std::fflush(file); }
+        inline void Flush()
+        {
+            std::fflush(file);
+            #ifndef WIN32
+            pendingWrites = false;
+            #endif
+        }
 
         inline std::uint64_t Ftell()
         {
-            auto result = ftell(file);
+            #ifdef WIN32
+            auto result = _ftelli64(file);
+            #else
+            auto result = ftello(file);
+            #endif
+            ThrowErrorIf(Error::FileSeek, (result < 0), "tell failed");
             return static_cast<std::uint64_t>(result);
         }
 
+        #ifndef WIN32
+        inline std::uint64_t Fsize()
+        {
+            if (pendingWrites) { Flush(); }
+            struct stat fileStat;
+            ThrowErrorIf(Error::FileSeek, (fstat(fileno(file), &fileStat) != 0), "fstat failed");
+            return static_cast<std::uint64_t>(fileStat.st_size);
+        }
+
+        std::uint64_t filePosition = 0; // position of the FILE* as seen by stdio
+        bool pendingWrites = false;     // stdio may be holding written bytes that pread can't see yet
+        #endif
+
         std::uint64_t offset = 0;
         std::string name;
         FILE* file;
@@ -14,6 +14,8 @@
 #include <map>
 #include <functional>
 #include <algorithm>
+#include <limits>
+#include <vector>
 
 namespace MSIX {
   
@@ -22,17 +24,22 @@ namespace MSIX {
     {
     protected:
         bool m_validated;
+        bool m_hashWhileReading;
         ComPtr<IStream> m_stream;
+        ComPtr<IStreamInternal> m_streamInternal;
         std::vector<std::uint8_t>& m_expectedHash;
-        std::unique_ptr<std::vector<std::uint8_t>> m_cacheBuffer;
+        SHA256 m_hasher;
+        std::uint64_t m_hashedPosition;
         std::uint64_t m_relativePosition;
-        size_t m_streamSize;
+        std::uint64_t m_streamSize;
 
     public:
         HashStream(const ComPtr<IStream>& stream, std::vector<std::uint8_t>& expectedHash) :
             m_validated(false),
+            m_hashWhileReading(false),
             m_stream(stream),
             m_expectedHash(expectedHash),
+            m_hashedPosition(0),
             m_relativePosition(0),
             m_streamSize(0)
         {
@@ -42,24 +49,48 @@ namespace MSIX {
             
             ThrowHrIfFailed(m_stream->Seek(li, StreamBase::Reference::END, &uli));
             ThrowHrIfFailed(m_stream->Seek(li, StreamBase::Reference::START, nullptr));
-            m_streamSize = static_cast<size_t>(uli.u.LowPart);
+            m_streamSize = uli.QuadPart;
+            m_stream->QueryInterface(UuidOfImpl<IStreamInternal>::iid, reinterpret_cast<void**>(&m_streamInternal));
         }
 
+        // By default the whole stream is validated before any of it is read. While the library parses the stream
+        // itself, it can instead be hashed as it's read (see ReadAt); this is never on once the stream can be handed
+        // out, so a caller never gets bytes that haven't been validated.
+        void HashWhileReading(bool hashWhileReading) { m_hashWhileReading = hashWhileReading; }
+
+        // Hashes whatever hasn't been hashed yet, and checks the digest.
         void Validate()
         {
             if (m_validated) { return; }
 
-            // read stream into cache buffer
-            m_cacheBuffer = std::make_unique<std::vector<std::uint8_t>>(m_streamSize);            
-            ULONG bytesRead = 0;
-            ThrowHrIfFailed(m_stream->Read(m_cacheBuffer->data(), m_cacheBuffer->size(), &bytesRead));
-            ThrowErrorIfNot(MSIX::Error::SignatureInvalid, bytesRead == m_streamSize, "read failed");
-            
-            // compute digest and compare against expected digest
+            // hash the underlying bytes in place when they're addressable, otherwise read them through a buffer
+            std::uint64_t remaining = m_streamSize - m_hashedPosition;
+            const std::uint8_t* data = m_streamInternal ? m_streamInternal->GetMappedData(m_hashedPosition, remaining) : nullptr;
+            if (data != nullptr)
+            {
+                m_hasher.Update(data, static_cast<std::size_t>(remaining));
+                m_hashedPosition = m_streamSize;
+            }
+            else
+            {
+                std::vector<std::uint8_t> buffer(static_cast<size_t>(std::min(remaining, static_cast<std::uint64_t>(DEFAULT_IO_SIZE))));
+                while (m_hashedPosition < m_streamSize)
+                {
+                    ULONG bytesToRead = static_cast<ULONG>(std::min(m_streamSize - m_hashedPosition, static_cast<std::uint64_t>(buffer.size())));
+                    ULONG bytesRead = StreamBase::ReadAt(m_stream.Get(), m_streamInternal.Get(), m_hashedPosition, buffer.data(), bytesToRead);
+                    ThrowErrorIfNot(MSIX::Error::SignatureInvalid, bytesRead == bytesToRead, "read failed");
+                    m_hasher.Update(buffer.data(), bytesRead);
+                    m_hashedPosition += bytesRead;
+                }
+            }
+            CheckDigest();
+        }
+
+        // compute digest and compare against expected digest
+        void CheckDigest()
+        {
             std::vector<std::uint8_t> hash;
-            ThrowErrorIfNot(MSIX::Error::SignatureInvalid, 
-                MSIX::SHA256::ComputeHash(m_cacheBuffer->data(), m_cacheBuffer->size(), hash), 
-                "Invalid signature");
+            m_hasher.Finalize(hash);
             ThrowErrorIfNot(MSIX::Error::SignatureInvalid, m_expectedHash.size() == hash.size(), "Signature is corrupt");
             ThrowErrorIfNot(
                 MSIX::Error::SignatureInvalid,
@@ -75,55 +106,84 @@ namespace MSIX {
             switch (origin)
             {
                 case Reference::CURRENT:
-                    m_relativePosition += move.u.LowPart;
+                    m_relativePosition += move.QuadPart;
                     break;
                 case Reference::START:
-                    m_relativePosition = move.u.LowPart;
+                    m_relativePosition = move.QuadPart;
                     break;
                 case Reference::END:
                     m_relativePosition = m_streamSize;
                     break;
             }
-            m_relativePosition = std::max((std::uint64_t)0, std::min(m_relativePosition, static_cast<std::uint64_t>(m_streamSize)));
+            m_relativePosition = std::max((std::uint64_t)0, std::min(m_relativePosition, m_streamSize));
             if (newPosition) { newPosition->QuadPart = (std::uint64_t)m_relativePosition; }
         }        
 
         HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER move, DWORD origin, ULARGE_INTEGER *newPosition) noexcept override try
-        {
-            if (m_cacheBuffer.get() == nullptr)
-            {   ThrowHrIfFailed(m_stream->Seek(move, origin, newPosition));
-            }
-            // always call into cache seek to keep cache state aligned with the underlying stream state.
+        {   // reads are positional, so the underlying stream's seek pointer is left alone.
             CacheSeek(move, origin, newPosition);
             return static_cast<HRESULT>(Error::OK);
         } CATCH_RETURN();
 
-        void CacheRead(void* buffer, ULONG countBytes, ULONG* actualRead)
+        HRESULT STDMETHODCALLTYPE Read(void* buffer, ULONG countBytes, ULONG* actualRead) noexcept override try
         {
-            ThrowErrorIf(Error::Stg_E_Invalidpointer, (buffer == nullptr), "bad input");
-            ULONG bytesToRead = std::min((std::uint32_t)countBytes, static_cast<std::uint32_t>((std::uint64_t)m_cacheBuffer->size() - m_relativePosition));
-            if (bytesToRead)
-            {
-                memcpy(buffer, reinterpret_cast<BYTE*>(m_cacheBuffer->data()) + m_relativePosition, bytesToRead);
-            }
-
-            m_relativePosition += bytesToRead;
-            if (m_streamSize == m_relativePosition) { m_cacheBuffer = nullptr; }
-            if (actualRead) { *actualRead = bytesToRead; }
-        }
+            ULONG bytesRead = ReadAt(m_relativePosition, buffer, countBytes);
+            m_relativePosition += bytesRead;
+            if (actualRead) { *actualRead = bytesRead; }
+            return static_cast<HRESULT>(Error::OK);
+        } CATCH_RETURN();
 
-        HRESULT STDMETHODCALLTYPE Read(void* buffer, ULONG countBytes, ULONG* actualRead) noexcept override try
+        // The rest of the stream is read into memory and validated there before any of it is written, so that what
+        // was validated is what gets written, and nothing is when validation fails. Streams that are validated this
+        // way are footprint files, which are small.
+        HRESULT STDMETHODCALLTYPE CopyTo(IStream* stream, ULARGE_INTEGER bytesCount, ULARGE_INTEGER* bytesRead, ULARGE_INTEGER* bytesWritten) noexcept override try
         {
-            Validate();
-            if (m_cacheBuffer.get() == nullptr)
-            {   ThrowHrIfFailed(m_stream->Read(buffer, countBytes, actualRead));
-            }
-            else
-            {   CacheRead(buffer, countBytes, actualRead);
+            if (bytesRead) { bytesRead->QuadPart = 0; }
+            if (bytesWritten) { bytesWritten->QuadPart = 0; }
+            ThrowErrorIf(Error::InvalidParameter, (nullptr == stream), "invalid parameter.");
+
+            std::uint64_t count = std::min(static_cast<std::uint64_t>(bytesCount.QuadPart), m_streamSize - m_relativePosition);
+            ThrowErrorIf(Error::FileRead, (count > std::numeric_limits<ULONG>::max()), "file is too large");
+            std::vector<std::uint8_t> buffer(static_cast<size_t>(count));
+            ULONG read = ReadAt(m_relativePosition, buffer.data(), static_cast<ULONG>(count));
+            ThrowErrorIf(Error::FileRead, (read != count), "read failed");
+            if (!m_validated) { Validate(); }
+            m_relativePosition += read;
+            if (bytesRead) { bytesRead->QuadPart = read; }
+
+            std::uint64_t offset = 0;
+            while (offset < count)
+            {
+                ULONG written = 0;
+                ThrowHrIfFailed(stream->Write(buffer.data() + offset, static_cast<ULONG>(count - offset), &written));
+                ThrowErrorIf(Error::FileWrite, (written == 0), "write failed");
+                offset += written;
             }
+            if (bytesWritten) { bytesWritten->QuadPart = count; }
             return static_cast<HRESULT>(Error::OK);
         } CATCH_RETURN();
 
+        ULONG ReadAt(std::uint64_t offset, void* buffer, ULONG countBytes) override
+        {
+            ThrowErrorIf(Error::Stg_E_Invalidpointer, (buffer == nullptr), "bad input");
+            // While hashing while reading, reading on from where hashing got to hashes the bytes on their way to the
+            // parser; the read that reaches the end of the stream checks the digest, and fails if it doesn't match.
+            // So the parser must not act on what it read until that read has succeeded. Any other read validates the
+            // whole stream first.
+            bool hashWhileReading = m_hashWhileReading && !m_validated && (offset == m_hashedPosition);
+            if (!hashWhileReading || (offset >= m_streamSize)) { Validate(); }
+            if (offset >= m_streamSize) { return 0; }
+            ULONG bytesToRead = static_cast<ULONG>(std::min(static_cast<std::uint64_t>(countBytes), m_streamSize - offset));
+            ULONG bytesRead = StreamBase::ReadAt(m_stream.Get(), m_streamInternal.Get(), offset, buffer, bytesToRead);
+            if (hashWhileReading)
+            {
+                m_hasher.Update(reinterpret_cast<std::uint8_t*>(buffer), bytesRead);
+                m_hashedPosition += bytesRead;
+                if (m_hashedPosition == m_streamSize) { CheckDigest(); }
+            }
+            return bytesRead;
+        }
+
         HRESULT STDMETHODCALLTYPE GetCompressionOption(APPX_COMPRESSION_OPTION* compressionOption) noexcept override try
         {
             return m_stream.As<IAppxFile>()->GetCompressionOption(compressionOption);
@@ -72,6 +72,18 @@ struct XmlVisitor
     XmlVisitor(void* c, lambda f) : context(c), Callback(f) {}
 };
 
+// Like XmlVisitor, but also told which query the element answers, for visitors that see every element of a document
+// in one pass.
+struct XmlElementVisitor
+{
+    typedef bool(*lambda)(void*, XmlQueryName, const MSIX::ComPtr<IXmlElement>& );
+
+    void*   context;
+    lambda  Callback;
+
+    XmlElementVisitor(void* c, lambda f) : context(c), Callback(f) {}
+};
+
 #ifndef WIN32
 // {0e7a446e-baf7-44c1-b38a-216bfa18a1a8}
 interface IXmlDom : public IUnknown
@@ -99,6 +111,12 @@ class IXmlFactory : public IUnknown
 {
 public:
     virtual MSIX::ComPtr<IXmlDom> CreateDomFromStream(XmlContentType footPrintType, const MSIX::ComPtr<IStream>& stream) = 0;
+
+    // Reads the document in 'stream' once, from start to end, calling 'visitor' for each element that matches one of
+    // the absolute queries (/Package/Identity, /BlockMap/File and /BlockMap/File/Block) in document order, so a
+    // Block follows the File it belongs to. Elements are only valid for the duration of the callback, and no document
+    // is kept around. Returns false if the visitor stopped early.
+    virtual bool ForEachElementInStream(XmlContentType footPrintType, const MSIX::ComPtr<IStream>& stream, XmlElementVisitor& visitor) = 0;
 };
 
 SpecializeUuidOfImpl(IXmlElement);
@@ -3,15 +3,11 @@
 //  See LICENSE file in the project root for full license information.
 // 
 #pragma once
-#ifdef WIN32
-#include "zlib.h"
-#else
-#include <zlib.h>
-#endif
 
 #include "Exceptions.hpp"
 #include "StreamBase.hpp"
 #include "ComHelper.hpp"
+#include "Inflater.hpp"
 
 // Windows.h defines max and min... 
 #undef max
@@ -19,6 +15,9 @@
 #include <string>
 #include <map>
 #include <functional>
+#include <vector>
+#include <mutex>
+#include <memory>
 
 namespace MSIX {
 
@@ -60,6 +59,12 @@ namespace MSIX {
         // IAppxFileInternal
         std::uint64_t GetCompressedSize() override { return m_stream.As<IAppxFileInternal>()->GetCompressedSize(); }
 
+        // IStreamInternal
+        ULONG ReadAt(std::uint64_t offset, void* buffer, ULONG countBytes) override;
+        void SetCompressedBlocks(std::uint64_t blockSize, const std::vector<std::uint64_t>& compressedSizes) override;
+        bool DecompressBlock(std::size_t index, std::uint8_t* buffer) override;
+        bool HasCompressedBlocks() override { return !m_blockOffsets.empty(); }
+
         void Cleanup();
 
         static const ULONG BUFFERSIZE = 4096;
@@ -77,15 +82,30 @@ namespace MSIX {
         State m_state    = State::UNINITIALIZED;
 
         ComPtr<IStream> m_stream;
+        ComPtr<IStreamInternal> m_streamInternal;
+        ULONGLONG       m_compressedPosition = 0;
         ULONGLONG       m_seekPosition = 0;
         ULONGLONG       m_uncompressedSize = 0;
         ULONG           m_bytesRead = 0;
         std::uint8_t*   m_startCurrentBuffer = nullptr;
         ULONG           m_inflateWindowPosition = 0;
+        ULONG           m_inflateWindowSize = 0;
         ULONGLONG       m_fileCurrentWindowPositionEnd = 0;
         ULONGLONG       m_fileCurrentPosition = 0;
-        z_stream        m_zstrm;
-        int             m_zret;
+        const std::uint8_t* m_input = nullptr;
+        std::size_t     m_inputSize = 0;
+        std::unique_ptr<Inflater> m_inflater;
+        Inflater::Result m_inflateResult = Inflater::Result::Partial;
+
+        // Where each independently compressed block starts in the compressed stream, if known, so that inflating can
+        // start at any one of them. m_startBlock is the one the current inflate started at.
+        std::uint64_t              m_blockSize = 0;
+        std::vector<std::uint64_t> m_blockOffsets;
+        std::uint64_t              m_blocksEnd = 0;
+        std::size_t                m_startBlock = 0;
+
+        // Serializes DecompressBlock's reads of the compressed data when they have to go through m_stream's seek pointer.
+        std::mutex      m_blockReadLock;
 
         std::uint8_t    m_compressedBuffer[InflateStream::BUFFERSIZE];
         std::uint8_t    m_inflateWindow[InflateStream::BUFFERSIZE];
@@ -0,0 +1,48 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+namespace MSIX {
+
+    // Decompresses a raw deflate (RFC 1951) stream a piece at a time. The implementation is picked at build time
+    // with -DINFLATE=[zlib|zlib-ng]; see PAL/Inflate.
+    class Inflater
+    {
+    public:
+        enum class Result
+        {
+            Partial,    // ran out of input or of room for output before the end of the stream
+            End,        // reached the end of the stream
+            Corrupt,    // the input isn't valid deflate data, or refers back to data from before the stream started
+        };
+
+        Inflater();
+        ~Inflater();
+
+        // Makes the inflater ready for a new stream, dropping whatever is left of the current one.
+        void Reset();
+
+        // Decompresses as much of 'input' into 'output' as possible, moving both past the bytes consumed and produced.
+        Result Inflate(const std::uint8_t*& input, std::size_t& inputSize, std::uint8_t*& output, std::size_t& outputSize);
+
+    protected:
+        struct Context;
+        std::unique_ptr<Context> m_context;
+    };
+
+    // Decompresses a deflate block that was compressed on its own, i.e. flushed with Z_FULL_FLUSH, in one go. The
+    // implementation is picked at build time with -DINFLATE_BLOCKS=[inflater|libdeflate]; see PAL/Inflate.
+    class BlockInflater
+    {
+    public:
+        // Decompresses all of 'input' into exactly 'outputSize' bytes at 'output'. Returns false when 'input' isn't a
+        // block that decompresses to that many bytes on its own. Safe to call on several threads at once.
+        static bool Inflate(const std::uint8_t* input, std::size_t inputSize, std::uint8_t* output, std::size_t outputSize);
+    };
+}
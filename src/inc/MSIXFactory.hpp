@@ -8,6 +8,8 @@
 
 #include <vector>
 
+namespace MSIX { class ThreadPool; }
+
 // internal interface
 EXTERN_C const IID IID_IMSIXFactory;   
 #ifndef WIN32
@@ -24,6 +26,7 @@ public:
     virtual HRESULT MarshalOutBytes(std::vector<std::uint8_t>& data, UINT32* size, BYTE** buffer) = 0;
     virtual MSIX_VALIDATION_OPTION GetValidationOptions() = 0;
     virtual MSIX::ComPtr<IStream> GetResource(const std::string& resource) = 0;
+    virtual MSIX::ThreadPool& GetThreadPool() = 0;
 };
 
 SpecializeUuidOfImpl(IMSIXFactory);
\ No newline at end of file
@@ -13,6 +13,12 @@
 #ifdef WIN32
     #define STDMETHODCALLTYPE __stdcall
     #define MSIX_API extern "C" __declspec(dllexport) 
+    // Unlike functions, data such as the IIDs of the MSIX specific interfaces has to be explicitly imported by clients.
+    #ifdef msix_EXPORTS
+    #define MSIX_IID_API extern "C" __declspec(dllexport)
+    #else
+    #define MSIX_IID_API extern "C" __declspec(dllimport)
+    #endif
 
     // UNICODE MUST be defined before you include Windows.h if you want the non-ascii versions of APIs (and you do)
     #ifdef UNICODE
@@ -35,6 +41,7 @@
     
     #undef MSIX_API
     #define MSIX_API extern "C"
+    #define MSIX_IID_API extern "C" __attribute__((visibility("default")))
 
     #ifndef interface
     #define interface struct
@@ -0,0 +1,170 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <string>
+#include <cstring>
+#include <limits>
+#include <cstdint>
+
+#include "Exceptions.hpp"
+#include "StreamBase.hpp"
+
+#ifdef WIN32
+#include "UnicodeConversion.hpp"
+#else
+#ifdef __APPLE__
+#include <TargetConditionals.h>
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace MSIX {
+
+    // Files larger than this aren't mapped: a mapping needs that much contiguous address space, which a 32-bit or
+    // mobile process can't be expected to have free.
+    #if (SIZE_MAX <= UINT32_MAX) || defined(__ANDROID__) || (defined(__APPLE__) && TARGET_OS_IPHONE)
+    const std::uint64_t MAXIMUM_MAPPED_FILE_SIZE = 256 * 1024 * 1024;
+    #else
+    const std::uint64_t MAXIMUM_MAPPED_FILE_SIZE = 8ULL * 1024 * 1024 * 1024;
+    #endif
+
+    // Read-only stream over a file that is mapped into memory in its entirety. Reads are served straight out
+    // of the mapping, and the mapped bytes are handed out via IStreamInternal::GetMappedData so that layered
+    // streams can consume them without an intermediate copy.
+    // Failing to open the file throws, but failing to map it doesn't: check IsMapped, and read the file some other
+    // way when it's false. The file must not be truncated while it is mapped, which would fault on POSIX (SIGBUS)
+    // and Win32 (EXCEPTION_IN_PAGE_ERROR) alike; bytes that are validated must therefore be copied out of the
+    // mapping first, so that what was validated is what gets used.
+    class MappedFileStream final : public StreamBase
+    {
+    public:
+        MappedFileStream(const std::string& path) : m_name(path)
+        {
+            #ifdef WIN32
+            std::wstring utf16Path = utf8_to_utf16(path);
+            m_file = CreateFileW(utf16Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            std::ostringstream builder;
+            builder << "file: '" << path << "' does not exist.";
+            ThrowErrorIf(Error::FileOpen, (m_file == INVALID_HANDLE_VALUE), builder.str().c_str());
+            LARGE_INTEGER size = {0};
+            ThrowErrorIfNot(Error::FileOpen, GetFileSizeEx(m_file, &size), "GetFileSizeEx failed");
+            m_size = static_cast<std::uint64_t>(size.QuadPart);
+            if ((m_size != 0) && (m_size <= MAXIMUM_MAPPED_FILE_SIZE))
+            {   // CreateFileMapping fails for empty files, so only map when there is something to map.
+                m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (m_mapping != nullptr)
+                {   m_data = reinterpret_cast<std::uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+                }
+            }
+            #else
+            m_file = open(path.c_str(), O_RDONLY);
+            ThrowErrorIf(Error::FileOpen, (m_file == -1), path.c_str());
+            struct stat fileStat;
+            ThrowErrorIf(Error::FileOpen, (fstat(m_file, &fileStat) != 0), "fstat failed");
+            m_size = static_cast<std::uint64_t>(fileStat.st_size);
+            if ((m_size != 0) && (m_size <= MAXIMUM_MAPPED_FILE_SIZE))
+            {   // mmap fails for empty files, so only map when there is something to map.
+                void* data = mmap(nullptr, static_cast<size_t>(m_size), PROT_READ, MAP_PRIVATE, m_file, 0);
+                if (data != MAP_FAILED) { m_data = reinterpret_cast<std::uint8_t*>(data); }
+            }
+            #endif
+        }
+
+        virtual ~MappedFileStream() override
+        {
+            Close();
+        }
+
+        // Whether the whole file is mapped; there is nothing to map of an empty one.
+        bool IsMapped() { return (m_data != nullptr) || (m_size == 0); }
+
+        void Close()
+        {   // the most we would ever do w.r.t. a failure from unmapping/closing is *maybe* log something...
+            #ifdef WIN32
+            if (m_data)                         { UnmapViewOfFile(m_data); }
+            if (m_mapping)                      { CloseHandle(m_mapping); }
+            if (m_file != INVALID_HANDLE_VALUE) { CloseHandle(m_file); }
+            m_mapping = nullptr;
+            m_file = INVALID_HANDLE_VALUE;
+            #else
+            if (m_data)         { munmap(m_data, static_cast<size_t>(m_size)); }
+            if (m_file != -1)   { close(m_file); }
+            m_file = -1;
+            #endif
+            m_data = nullptr;
+        }
+
+        HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER move, DWORD origin, ULARGE_INTEGER *newPosition) noexcept override try
+        {
+            LARGE_INTEGER newPos = { 0 };
+            switch (origin)
+            {
+            case Reference::CURRENT:
+                newPos.QuadPart = m_offset + move.QuadPart;
+                break;
+            case Reference::START:
+                newPos.QuadPart = move.QuadPart;
+                break;
+            case Reference::END:
+                newPos.QuadPart = m_size + move.QuadPart;
+                break;
+            }
+            ThrowErrorIf(Error::FileSeek, (newPos.QuadPart < 0), "seek failed");
+            m_offset = static_cast<std::uint64_t>(newPos.QuadPart);
+            if (newPosition) { newPosition->QuadPart = m_offset; }
+            return static_cast<HRESULT>(Error::OK);
+        } CATCH_RETURN();
+
+        HRESULT STDMETHODCALLTYPE Read(void* buffer, ULONG countBytes, ULONG* bytesRead) noexcept override try
+        {
+            ULONG amountRead = ReadAt(m_offset, buffer, countBytes);
+            m_offset += amountRead;
+            if (bytesRead) { *bytesRead = amountRead; }
+            return static_cast<HRESULT>(Error::OK);
+        } CATCH_RETURN();
+
+        // IStreamInternal
+        const std::uint8_t* GetMappedData(std::uint64_t offset, std::uint64_t size) override
+        {
+            if ((m_data == nullptr) || (offset > m_size) || (size > (m_size - offset))) { return nullptr; }
+            return m_data + offset;
+        }
+
+        #ifndef WIN32
+        int GetFileDescriptor(std::uint64_t offset, std::uint64_t size, std::uint64_t* fileOffset) override
+        {
+            if ((offset > m_size) || (size > (m_size - offset))) { return -1; }
+            *fileOffset = offset;
+            return m_file;
+        }
+        #endif
+
+        std::string GetFilePath() override { return m_name; }
+
+        ULONG ReadAt(std::uint64_t offset, void* buffer, ULONG countBytes) override
+        {
+            if (offset >= m_size) { return 0; }
+            ULONG amountToRead = static_cast<ULONG>(std::min(static_cast<std::uint64_t>(countBytes), m_size - offset));
+            std::memcpy(buffer, m_data + offset, amountToRead);
+            return amountToRead;
+        }
+
+    protected:
+        std::uint64_t m_offset = 0;
+        std::uint64_t m_size = 0;
+        std::uint8_t* m_data = nullptr;
+        std::string m_name;
+        #ifdef WIN32
+        HANDLE m_file = INVALID_HANDLE_VALUE;
+        HANDLE m_mapping = nullptr;
+        #else
+        int m_file = -1;
+        #endif
+    };
+}
@@ -0,0 +1,67 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "AppxPackaging.hpp"
+#include "ComHelper.hpp"
+#include "ZipObject.hpp"
+#include "AppxSignature.hpp"
+#include "BlockMapStream.hpp"
+
+namespace MSIX {
+
+    // What opening a package file established about it: where its files are, the outcome of validating its signature,
+    // its blockmap and its identity. It is kept next to the package as <package>.msixindex, keyed by the package's
+    // size, modification time and a hash of its end of central directory record(s), so that opening the same package
+    // again (see MSIX_VALIDATION_OPTION_USEPACKAGEINDEX) doesn't need to parse or validate any of it again.
+    struct PackageIndex
+    {
+        struct BlockMapFile
+        {
+            std::string        name;
+            std::uint64_t      size;
+            std::uint32_t      localFileHeaderSize;
+            std::size_t        firstBlock;     // in blocks
+            std::size_t        countBlocks;
+        };
+
+        // Reads the index of the package that 'package' is over, if it has one that was written with the same
+        // validation options and still describes the package; otherwise returns nullptr. The index file is read into
+        // memory in one go rather than mapped, so it can't change under the parser if it's replaced while open.
+        static std::unique_ptr<PackageIndex> Load(const ComPtr<IStream>& package, MSIX_VALIDATION_OPTION validation);
+
+        // Writes the index for the package that 'package' is over. Not being able to is not an error, as the index
+        // is only ever an optimization.
+        void Save(const ComPtr<IStream>& package, MSIX_VALIDATION_OPTION validation) const;
+
+        // container
+        std::vector<ZipFileLocation> files;
+
+        // AppxSignature.p7x
+        bool                      hasDigests = false;
+        SignatureOrigin           signatureOrigin = SignatureOrigin::Unsigned;
+        std::string               signaturePublisher;
+        std::vector<std::uint8_t> fileRecordsDigest;
+        std::vector<std::uint8_t> centralDirectoryDigest;
+        std::vector<std::uint8_t> contentTypesDigest;
+        std::vector<std::uint8_t> blockMapDigest;
+        std::vector<std::uint8_t> codeIntegrityDigest;
+
+        // AppxBlockMap.xml
+        std::vector<BlockMapFile> blockMapFiles;
+        std::vector<Block>        blocks;         // every file's blocks, one file after another
+
+        // AppxManifest.xml
+        std::string name;
+        std::string version;
+        std::string resourceId;
+        std::string architecture;
+        std::string publisher;
+    };
+}
@@ -22,7 +22,8 @@ namespace MSIX {
             m_offset(offset),
             m_size(size),
             m_stream(stream)
-        {
+        {   // Streams that aren't ours don't implement IStreamInternal; those are read through their seek pointer.
+            m_stream->QueryInterface(UuidOfImpl<IStreamInternal>::iid, reinterpret_cast<void**>(&m_streamInternal));
         }
 
         HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER move, DWORD origin, ULARGE_INTEGER *newPosition) noexcept override try
@@ -40,23 +41,16 @@ namespace MSIX {
                 newPos.QuadPart = m_offset + m_size + move.QuadPart;
                 break;
             }
-            //TODO: We need to constrain newPos so that it can't exceed the end of the stream
-            ULARGE_INTEGER pos = { 0 };
-            m_stream->Seek(newPos, Reference::START, &pos);
-            m_relativePosition = std::min(static_cast<std::uint64_t>(pos.QuadPart - m_offset), m_size);
+            // Reads are positional, so there is no need to move the underlying stream's seek pointer.
+            newPos.QuadPart = std::max(newPos.QuadPart, static_cast<LONGLONG>(m_offset));
+            m_relativePosition = std::min(static_cast<std::uint64_t>(newPos.QuadPart - m_offset), m_size);
             if (newPosition) { newPosition->QuadPart = m_relativePosition; }
             return static_cast<HRESULT>(Error::OK);
         } CATCH_RETURN();
 
         HRESULT STDMETHODCALLTYPE Read(void* buffer, ULONG countBytes, ULONG* bytesRead) noexcept override try
         {
-            LARGE_INTEGER offset = {0};
-            offset.QuadPart = m_relativePosition + m_offset;
-            ThrowHrIfFailed(m_stream->Seek(offset, StreamBase::START, nullptr));
-            ULONG amountToRead = std::min(countBytes, static_cast<ULONG>(m_size - m_relativePosition));
-            ULONG amountRead = 0;
-            ThrowHrIfFailed(m_stream->Read(buffer, amountToRead, &amountRead));
-            ThrowErrorIf(Error::FileRead, (amountToRead != amountRead), "Did not read as much as requesteed.");
+            ULONG amountRead = ReadAt(m_relativePosition, buffer, countBytes);
             m_relativePosition += amountRead;
             if (bytesRead) { *bytesRead = amountRead; }
             ThrowErrorIf(Error::FileSeekOutOfRange, (m_relativePosition > m_size), "seek pointer out of bounds.");
@@ -69,6 +63,28 @@ namespace MSIX {
             return static_cast<HRESULT>(Error::OK);
         } CATCH_RETURN();
 
+        // IStreamInternal
+        const std::uint8_t* GetMappedData(std::uint64_t offset, std::uint64_t size) override
+        {
+            if (!m_streamInternal || (offset > m_size) || (size > (m_size - offset))) { return nullptr; }
+            return m_streamInternal->GetMappedData(m_offset + offset, size);
+        }
+
+        int GetFileDescriptor(std::uint64_t offset, std::uint64_t size, std::uint64_t* fileOffset) override
+        {
+            if (!m_streamInternal || (offset > m_size) || (size > (m_size - offset))) { return -1; }
+            return m_streamInternal->GetFileDescriptor(m_offset + offset, size, fileOffset);
+        }
+
+        ULONG ReadAt(std::uint64_t offset, void* buffer, ULONG countBytes) override
+        {
+            if (offset >= m_size) { return 0; }
+            ULONG amountToRead = static_cast<ULONG>(std::min(static_cast<std::uint64_t>(countBytes), m_size - offset));
+            ULONG amountRead = StreamBase::ReadAt(m_stream.Get(), m_streamInternal.Get(), m_offset + offset, buffer, amountToRead);
+            ThrowErrorIf(Error::FileRead, (amountToRead != amountRead), "Did not read as much as requesteed.");
+            return amountRead;
+        }
+
         std::uint64_t Size() { return m_size; }
 
     protected:
@@ -76,5 +92,6 @@ namespace MSIX {
         std::uint64_t m_size;
         std::uint64_t m_relativePosition = 0;
         ComPtr<IStream> m_stream;
+        ComPtr<IStreamInternal> m_streamInternal;
     };
 }
\ No newline at end of file
@@ -4,13 +4,37 @@
 // 
 #pragma once
 
+#include <cstdint>
+#include <cstddef>
+#include <memory>
 #include <vector>
 
 namespace MSIX {
 
+    // Computes a SHA-256 digest, either of one buffer with ComputeHash or incrementally: construct, Update with each
+    // piece of the data in order and Finalize, after which the object can be used for another digest.
     class SHA256
     {
     public:
         static bool ComputeHash(/*in*/ std::uint8_t *buffer, /*in*/ std::uint32_t cbBuffer, /*inout*/ std::vector<uint8_t>& hash);
+
+        // How ComputeHashes hashes: Default picks the fastest way the processor allows, Scalar hashes one buffer at a
+        // time, and MultiBuffer several side by side, which fails with NotSupported where the processor can't.
+        enum class Kernel { Default, Scalar, MultiBuffer };
+
+        // Computes the digests of 'count' separate buffers into 'hashes', several side by side where the processor
+        // allows it.
+        static void ComputeHashes(/*in*/ std::size_t count, /*in*/ const std::uint8_t* const* buffers,
+            /*in*/ const std::size_t* cbBuffers, /*inout*/ std::vector<uint8_t>* hashes, /*in*/ Kernel kernel = Kernel::Default);
+
+        SHA256();
+        ~SHA256();
+
+        void Update(/*in*/ const std::uint8_t* buffer, /*in*/ std::size_t cbBuffer);
+        void Finalize(/*inout*/ std::vector<uint8_t>& hash);
+
+    protected:
+        struct Context;
+        std::unique_ptr<Context> m_context;
     };
 }
\ No newline at end of file
@@ -51,6 +51,14 @@ public:
     // Obtains a pointer to a stream representing the file that exists in the storage object
     virtual MSIX::ComPtr<IStream> GetFile(const std::string& fileName) = 0;
 
+    // Gets every file in the storage object ready to be handed out by GetFile, in whatever order is cheapest for
+    // the underlying storage. Storage objects that have nothing to prepare MAY implement this as a no-op.
+    virtual void PrepareFiles() = 0;
+
+    // Returns true when the streams handed out by GetFile can be read on several threads at once, each of them by one
+    // thread at a time. Storage objects that can't promise that MAY always return false.
+    virtual bool SupportsConcurrentReads() = 0;
+
     // Opens a stream to a file by name in the storage object.  If the file does not exist and mode is read,
     // or read + update, then nullptr is returned.  If the file is opened with write and it does not exist, 
     // then the file is created and an empty stream to the file is handed back to the caller.
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include <vector>
 #include <algorithm>
 #include <iostream>
@@ -15,6 +16,12 @@
 #include "Exceptions.hpp"
 #include "ComHelper.hpp"
 
+#if defined(__linux__) && !defined(__ANDROID__)
+#include <unistd.h>
+#include <cerrno>
+#define MSIX_COPY_FILE_RANGE
+#endif
+
 EXTERN_C const IID IID_IAppxFileInternal;
 #ifndef WIN32
 // {cd24e5d3-4a35-4497-ba7e-d68df05c582c}
@@ -31,8 +38,55 @@ public:
 
 SpecializeUuidOfImpl(IAppxFileInternal);
 
+EXTERN_C const IID IID_IStreamInternal;
+#ifndef WIN32
+// {8b7a2e4c-5d16-4f0a-9c3e-2f61d8a4b079}
+interface IStreamInternal : public IUnknown
+#else
+class IStreamInternal : public IUnknown
+#endif
+{
+public:
+    // Returns a pointer to 'size' bytes of the stream starting at 'offset' when those bytes are directly addressable
+    // for the lifetime of the stream (e.g. a memory mapped file), or nullptr when the caller has to Read them instead.
+    virtual const std::uint8_t* GetMappedData(std::uint64_t offset, std::uint64_t size) = 0;
+
+    // Reads up to 'countBytes' bytes starting at 'offset' and returns how many were read. Streams that support
+    // positional reads do so without using, or moving, the seek pointer of any stream involved.
+    virtual ULONG ReadAt(std::uint64_t offset, void* buffer, ULONG countBytes) = 0;
+
+    // Returns the native descriptor of the file that holds the 'size' bytes of the stream starting at 'offset' as-is
+    // (and already validated), setting 'fileOffset' to where they start in that file; or -1 when there is no such file.
+    virtual int GetFileDescriptor(std::uint64_t offset, std::uint64_t size, std::uint64_t* fileOffset) = 0;
+
+    // Returns the transfer size, in bytes, the stream handles most efficiently per Read or Write.
+    virtual ULONG GetPreferredIOSize() = 0;
+
+    // Returns the path of the file the stream is over, or an empty string when the stream isn't over a file.
+    virtual std::string GetFilePath() = 0;
+
+    // Tells a stream over compressed data that its data is made of blocks of 'blockSize' bytes each which were
+    // compressed independently of one another, into 'compressedSizes' bytes each. Streams that can make use of that
+    // start decompressing at the block a read falls in, rather than at the start of the stream.
+    virtual void SetCompressedBlocks(std::uint64_t blockSize, const std::vector<std::uint64_t>& compressedSizes) = 0;
+
+    // Decompresses the 'index'th of the blocks given to SetCompressedBlocks into 'buffer', which holds a whole block,
+    // without using or moving the stream's seek pointer; so blocks can be decompressed on several threads at once.
+    // Returns false when the stream can't do that, including when the blocks turn out not to be independent after all.
+    virtual bool DecompressBlock(std::size_t index, std::uint8_t* buffer) = 0;
+
+    // Returns whether the blocks given to SetCompressedBlocks were taken, so that DecompressBlock may work on them.
+    virtual bool HasCompressedBlocks() = 0;
+};
+
+SpecializeUuidOfImpl(IStreamInternal);
+
 namespace MSIX {
-    class StreamBase : public MSIX::ComClass<StreamBase, IAppxFile, IStream, IAppxFileInternal>
+
+    const ULONG DEFAULT_IO_SIZE = 65536;    // 64KB, the size of a blockmap block
+    const ULONG MAXIMUM_IO_SIZE = 4194304;  // 4MB
+
+    class StreamBase : public MSIX::ComClass<StreamBase, IAppxFile, IStream, IAppxFileInternal, IStreamInternal>
     {
     public:
         // These are the same values as STREAM_SEEK. See 
@@ -61,8 +115,47 @@ namespace MSIX {
             if (bytesWritten) { bytesWritten->QuadPart = 0; }
             ThrowErrorIf(Error::InvalidParameter, (nullptr == stream), "invalid parameter.");
 
-            static const ULONGLONG size = 1024;
-            std::vector<std::int8_t> bytes(size);
+            #ifdef MSIX_COPY_FILE_RANGE
+            if (CopyFileRange(stream, bytesCount.QuadPart, bytesRead, bytesWritten)) { return static_cast<HRESULT>(Error::OK); }
+            #endif
+
+            // When our bytes are directly addressable, write them to the target without staging them in a buffer.
+            ULARGE_INTEGER start = {0};
+            ThrowHrIfFailed(Seek({0}, Reference::CURRENT, &start));
+            if (GetMappedData(start.QuadPart, 0) != nullptr)
+            {
+                ULARGE_INTEGER end = {0};
+                ThrowHrIfFailed(Seek({0}, Reference::END, &end));
+                std::uint64_t count = std::min(bytesCount.QuadPart, static_cast<ULONGLONG>(end.QuadPart - start.QuadPart));
+                const std::uint8_t* data = GetMappedData(start.QuadPart, count);
+                LARGE_INTEGER position = {0};
+                position.QuadPart = start.QuadPart + ((data != nullptr) ? count : 0);
+                ThrowHrIfFailed(Seek(position, Reference::START, nullptr));
+                if (data != nullptr)
+                {
+                    std::uint64_t written = 0;
+                    while (written < count)
+                    {
+                        ULONG chunk = static_cast<ULONG>(std::min(count - written, static_cast<std::uint64_t>(std::numeric_limits<ULONG>::max())));
+                        ULONG copy = 0;
+                        ThrowHrIfFailed(stream->Write(data + written, chunk, &copy));
+                        ThrowErrorIf(Error::FileWrite, (copy == 0), "write failed");
+                        written += copy;
+                    }
+                    if (bytesRead)      { bytesRead->QuadPart = count; }
+                    if (bytesWritten)   { bytesWritten->QuadPart = written; }
+                    return static_cast<HRESULT>(Error::OK);
+                }
+            }
+
+            // Transfer in units both streams are comfortable with, using this thread's copy buffer.
+            ULONG size = std::max(DEFAULT_IO_SIZE, GetPreferredIOSize());
+            ComPtr<IStreamInternal> target;
+            if (SUCCEEDED(stream->QueryInterface(UuidOfImpl<IStreamInternal>::iid, reinterpret_cast<void**>(&target))))
+            {   size = std::max(size, target->GetPreferredIOSize());
+            }
+            size = std::min(size, MAXIMUM_IO_SIZE);
+            std::uint8_t* bytes = GetCopyBuffer(size);
             std::int64_t read = 0;
             std::int64_t written = 0;
             ULONG length = 0;
@@ -70,7 +163,7 @@ namespace MSIX {
             while (0 < bytesCount.QuadPart)
             {
                 ULONGLONG chunk = std::min(bytesCount.QuadPart, static_cast<ULONGLONG>(size));
-                ThrowHrIfFailed(Read(reinterpret_cast<void*>(bytes.data()), (ULONG)chunk, &length));
+                ThrowHrIfFailed(Read(reinterpret_cast<void*>(bytes), (ULONG)chunk, &length));
                 if (length == 0) { break; }
                 read += length;
 
@@ -78,7 +171,8 @@ namespace MSIX {
                 while (0 < length)
                 {
                     ULONG copy = 0;
-                    ThrowHrIfFailed(stream->Write(reinterpret_cast<void*>(&bytes[offset]), length, &copy));
+                    ThrowHrIfFailed(stream->Write(reinterpret_cast<void*>(bytes + offset), length, &copy));
+                    ThrowErrorIf(Error::FileWrite, (copy == 0), "write failed");
                     offset += copy;
                     written += copy;
                     length -= copy;
@@ -154,6 +248,41 @@ namespace MSIX {
         // IAppxFileInternal
         virtual std::uint64_t GetCompressedSize() override { NOTIMPLEMENTED; }
 
+        // IStreamInternal
+        virtual const std::uint8_t* GetMappedData(std::uint64_t, std::uint64_t) override { return nullptr; }
+        virtual int GetFileDescriptor(std::uint64_t, std::uint64_t, std::uint64_t*) override { return -1; }
+        virtual ULONG GetPreferredIOSize() override { return DEFAULT_IO_SIZE; }
+        virtual std::string GetFilePath() override { return std::string(); }
+        virtual void SetCompressedBlocks(std::uint64_t, const std::vector<std::uint64_t>&) override {}
+        virtual bool DecompressBlock(std::size_t, std::uint8_t*) override { return false; }
+        virtual bool HasCompressedBlocks() override { return false; }
+
+        virtual ULONG ReadAt(std::uint64_t offset, void* buffer, ULONG countBytes) override
+        {   // Streams without native positional reads go through their seek pointer and put it back afterwards.
+            ULARGE_INTEGER current = {0};
+            ThrowHrIfFailed(Seek({0}, Reference::CURRENT, &current));
+            LARGE_INTEGER position = {0};
+            position.QuadPart = offset;
+            ThrowHrIfFailed(Seek(position, Reference::START, nullptr));
+            ULONG bytesRead = 0;
+            ThrowHrIfFailed(Read(buffer, countBytes, &bytesRead));
+            position.QuadPart = current.QuadPart;
+            ThrowHrIfFailed(Seek(position, Reference::START, nullptr));
+            return bytesRead;
+        }
+
+        // Reads from any IStream at 'offset', positionally when the stream supports it.
+        static ULONG ReadAt(IStream* stream, IStreamInternal* streamInternal, std::uint64_t offset, void* buffer, ULONG countBytes)
+        {
+            if (streamInternal) { return streamInternal->ReadAt(offset, buffer, countBytes); }
+            LARGE_INTEGER position = {0};
+            position.QuadPart = offset;
+            ThrowHrIfFailed(stream->Seek(position, Reference::START, nullptr));
+            ULONG bytesRead = 0;
+            ThrowHrIfFailed(stream->Read(buffer, countBytes, &bytesRead));
+            return bytesRead;
+        }
+
         template <class T>
         static ULONG Read(const ComPtr<IStream>& stream, T* value)
         {
@@ -170,5 +299,68 @@ namespace MSIX {
             ThrowHrIfFailed(stream->Write(value, static_cast<ULONG>(sizeof(T)), nullptr));
             ThrowErrorIf(Error::FileWrite, (result != sizeof(T)), "Entire object wasn't written!");
         }
+
+    protected:
+        // Returns an I/O aligned buffer of at least 'size' bytes. There is one per thread, reused by every CopyTo on it.
+        static std::uint8_t* GetCopyBuffer(std::size_t size)
+        {
+            static const std::size_t alignment = 4096;
+            thread_local std::vector<std::uint8_t> buffer;
+            if (buffer.size() < (size + alignment)) { buffer.resize(size + alignment); }
+            std::size_t misalignment = reinterpret_cast<std::uintptr_t>(buffer.data()) % alignment;
+            return buffer.data() + ((alignment - misalignment) % alignment);
+        }
+
+        #ifdef MSIX_COPY_FILE_RANGE
+        // When our bytes and the target's both live in plain files, have the kernel copy between the two files.
+        // Returns false, having moved neither seek pointer, when that isn't possible.
+        bool CopyFileRange(IStream* stream, std::uint64_t bytesCount, ULARGE_INTEGER* bytesRead, ULARGE_INTEGER* bytesWritten)
+        {
+            ComPtr<IStreamInternal> target;
+            if (FAILED(stream->QueryInterface(UuidOfImpl<IStreamInternal>::iid, reinterpret_cast<void**>(&target)))) { return false; }
+
+            std::uint64_t sourceOffset = 0;
+            ULARGE_INTEGER start = {0};
+            ThrowHrIfFailed(Seek({0}, Reference::CURRENT, &start));
+            if (GetFileDescriptor(start.QuadPart, 0, &sourceOffset) == -1) { return false; }
+
+            ULARGE_INTEGER end = {0};
+            ThrowHrIfFailed(Seek({0}, Reference::END, &end));
+            LARGE_INTEGER position = {0};
+            position.QuadPart = start.QuadPart;
+            ThrowHrIfFailed(Seek(position, Reference::START, nullptr));
+            std::uint64_t count = std::min(bytesCount, static_cast<std::uint64_t>(end.QuadPart - start.QuadPart));
+
+            std::uint64_t targetOffset = 0;
+            ULARGE_INTEGER targetStart = {0};
+            ThrowHrIfFailed(stream->Seek({0}, Reference::CURRENT, &targetStart));
+            int source = GetFileDescriptor(start.QuadPart, count, &sourceOffset);
+            int destination = target->GetFileDescriptor(targetStart.QuadPart, count, &targetOffset);
+            if ((source == -1) || (destination == -1)) { return false; }
+
+            loff_t in = static_cast<loff_t>(sourceOffset);
+            loff_t out = static_cast<loff_t>(targetOffset);
+            std::uint64_t copied = 0;
+            while (copied < count)
+            {
+                ssize_t result = copy_file_range(source, &in, destination, &out, static_cast<size_t>(std::min(count - copied, static_cast<std::uint64_t>(1 << 30))), 0);
+                if ((result < 0) && (copied == 0) && ((errno == ENOSYS) || (errno == EXDEV) || (errno == EINVAL) || (errno == EOPNOTSUPP)))
+                {   // the kernel or file system can't do it, so the caller copies through a buffer instead.
+                    return false;
+                }
+                ThrowErrorIf(Error::FileWrite, (result < 0), "copy_file_range failed");
+                ThrowErrorIf(Error::FileRead, (result == 0), "unexpected end of file");
+                copied += static_cast<std::uint64_t>(result);
+            }
+
+            position.QuadPart = start.QuadPart + count;
+            ThrowHrIfFailed(Seek(position, Reference::START, nullptr));
+            position.QuadPart = targetStart.QuadPart + count;
+            ThrowHrIfFailed(stream->Seek(position, Reference::START, nullptr));
+            if (bytesRead)      { bytesRead->QuadPart = count; }
+            if (bytesWritten)   { bytesWritten->QuadPart = count; }
+            return true;
+        }
+        #endif
     };
 }
\ No newline at end of file
@@ -18,7 +18,8 @@ namespace MSIX {
             ThrowHrIfFailed(stream->Seek(start, StreamBase::Reference::END, &end));
             ThrowHrIfFailed(stream->Seek(start, StreamBase::Reference::START, nullptr));
             
-            std::uint32_t streamSize = end.u.LowPart;
+            ThrowErrorIf(Error::FileRead, (end.QuadPart > std::numeric_limits<std::uint32_t>::max()), "stream is too large to buffer");
+            std::uint32_t streamSize = static_cast<std::uint32_t>(end.QuadPart);
             std::vector<std::uint8_t> buffer(streamSize);
             ULONG actualRead = 0;
             ThrowHrIfFailed(stream->Read(buffer.data(), streamSize, &actualRead));
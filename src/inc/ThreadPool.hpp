@@ -0,0 +1,68 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace MSIX {
+
+    // A fixed set of worker threads for work that splits into independent pieces, such as the blocks of a file.
+    // The workers are only started the first time there is work for them, and the thread that hands out work always
+    // takes part in it, so work can be handed out from within work without running out of threads.
+    class ThreadPool
+    {
+    public:
+        // 'concurrency' is the number of threads, including the calling one, to spread work across; 0 means one per
+        // hardware thread.
+        ThreadPool(std::size_t concurrency = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        std::size_t GetConcurrency() const { return m_concurrency; }
+
+        // Changes 'concurrency' as passed to the constructor. Only possible until work has first been handed out.
+        void SetConcurrency(std::size_t concurrency);
+
+        // Calls 'work' once for every index in [0, count) and returns once all of those calls have returned. If any
+        // of them throws, the indices no thread has started on yet are skipped and the first exception is rethrown.
+        void ForEach(std::size_t count, const std::function<void(std::size_t)>& work);
+
+    protected:
+        struct Job
+        {
+            Job(std::size_t count, const std::function<void(std::size_t)>& work) : count(count), work(work) {}
+
+            const std::size_t count;
+            const std::function<void(std::size_t)>& work;
+            std::atomic<std::size_t> next{0};
+            std::atomic<bool> failed{false};
+            std::size_t completed = 0;      // guarded by the pool's lock
+            std::exception_ptr exception;   // guarded by the pool's lock
+        };
+
+        void Start();
+        void Work(const std::shared_ptr<Job>& job);
+        void WorkerMain();
+
+        std::size_t m_concurrency;
+        std::vector<std::thread> m_workers;
+        std::mutex m_lock;
+        std::condition_variable m_workAvailable;
+        std::condition_variable m_jobCompleted;
+        std::deque<std::shared_ptr<Job>> m_jobs;
+        bool m_stopping = false;
+    };
+}
@@ -0,0 +1,174 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include "ComHelper.hpp"
+#include "StorageObject.hpp"
+#include "BlockMapStream.hpp"
+#include "ZipObject.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace MSIX {
+
+    // The pipeline reads the archive this many bytes at a time; a multiple of BLOCKMAP_BLOCK_SIZE.
+    const std::uint64_t PIPELINE_READ_SIZE = 16 * BLOCKMAP_BLOCK_SIZE;
+
+    // How many reads, and how many blocks, may wait between two stages of the pipeline.
+    const std::size_t PIPELINE_READS_QUEUED = 4;
+    const std::size_t PIPELINE_BLOCKS_QUEUED = 64;
+
+    // A queue between two threads that holds at most 'capacity' items, so that the thread pushing them waits for the
+    // one popping them rather than running ahead of it. An abandoned queue drops what it holds and what is pushed to it,
+    // so that neither thread waits on the other any more.
+    template <class T>
+    class BoundedQueue
+    {
+    public:
+        BoundedQueue(std::size_t capacity) : m_capacity(capacity) {}
+
+        void Push(T&& item)
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_notFull.wait(lock, [this]() { return m_abandoned || (m_items.size() < m_capacity); });
+            if (m_abandoned) { return; }
+            m_items.push_back(std::move(item));
+            m_notEmpty.notify_one();
+        }
+
+        // Waits for an item; returns false once the queue is closed and there are no items left.
+        bool Pop(T& item)
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_notEmpty.wait(lock, [this]() { return m_closed || !m_items.empty(); });
+            return PopLocked(item);
+        }
+
+        // Pops an item only if one is waiting.
+        bool TryPop(T& item)
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            return PopLocked(item);
+        }
+
+        // Called by the thread pushing items once it is done.
+        void Close()
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_closed = true;
+            m_notEmpty.notify_all();
+        }
+
+        void Abandon()
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_abandoned = true;
+            m_closed = true;
+            m_items.clear();
+            m_notEmpty.notify_all();
+            m_notFull.notify_all();
+        }
+
+    protected:
+        bool PopLocked(T& item)
+        {
+            if (m_items.empty()) { return false; }
+            item = std::move(m_items.front());
+            m_items.pop_front();
+            m_notFull.notify_one();
+            return true;
+        }
+
+        std::size_t m_capacity;
+        bool m_closed = false;
+        bool m_abandoned = false;
+        std::deque<T> m_items;
+        std::mutex m_lock;
+        std::condition_variable m_notEmpty;
+        std::condition_variable m_notFull;
+    };
+
+    // Unpacks files of a zip archive, checking them against the blockmap on the way, in four stages that each run on a
+    // thread of their own: reading the files' data out of the archive, with reads that span neighbouring files;
+    // inflating it into blocks; checking the blocks against the blockmap; and writing them out. The stages are
+    // connected by bounded queues, so reading, inflating, hashing and writing all go on at once, even within a file.
+    class UnpackPipeline
+    {
+    public:
+        struct File
+        {
+            std::string     targetName; // what the file is opened as in the storage object unpacked to
+            ZipFileLocation location;
+            BlockSpan       blocks;     // the file's blocks in the blockmap, which must outlive the pipeline
+        };
+
+        UnpackPipeline(const ComPtr<IStream>& archive, std::vector<File> files, const ComPtr<IStorageObject>& to);
+
+        // Unpacks the files, in order. If any of them fail, what is thrown is the failure that unpacking the files one
+        // after another, each from its start, would have run into first.
+        void Run();
+
+    protected:
+        // Bytes of a file's data in the archive, as read; 'buffer', if any, holds them.
+        struct Extent
+        {
+            std::size_t file;
+            std::uint64_t offset;   // from the start of the file's data
+            const std::uint8_t* data;
+            std::size_t size;
+            std::shared_ptr<std::vector<std::uint8_t>> buffer;
+        };
+
+        // One of a file's blocks as it goes through the pipeline; 'buffer', if any, holds its bytes.
+        struct Chunk
+        {
+            std::size_t file;
+            std::size_t block;
+            const std::uint8_t* data;
+            std::size_t size;
+            bool last;              // whether this is the last of the file's blocks
+            std::shared_ptr<std::vector<std::uint8_t>> buffer;
+        };
+
+        // The stages; each one but the last closes its output queue when it is done.
+        void ReadFiles();
+        void InflateFiles();
+        void VerifyBlocks();
+        void WriteBlocks();
+
+        std::uint64_t OutputSize(std::size_t file) const;
+        std::uint64_t DataSize(std::size_t file) const;
+
+        // Once something fails, whatever comes after it in the files is of no more use, so stages skip it.
+        static std::uint64_t Position(std::size_t file, std::size_t block) { return (static_cast<std::uint64_t>(file) << 32) | block; }
+        bool Stopped(std::size_t file, std::size_t block) const { return Position(file, block) >= m_failure; }
+        void Fail(std::size_t file, std::size_t block, std::exception_ptr exception);
+
+        // Lets the stages that are running finish without the others.
+        void Abandon();
+
+        ComPtr<IStream> m_archive;
+        ComPtr<IStreamInternal> m_archiveInternal;
+        std::vector<File> m_files;
+        ComPtr<IStorageObject> m_to;
+
+        BoundedQueue<Extent> m_extents;
+        BoundedQueue<Chunk> m_inflated;
+        BoundedQueue<Chunk> m_verified;
+
+        std::atomic<std::uint64_t> m_failure;
+        std::mutex m_failureLock;
+        std::exception_ptr m_exception; // guarded by m_failureLock
+    };
+}
@@ -18,10 +18,9 @@ namespace MSIX {
 
         HRESULT STDMETHODCALLTYPE Read(void* buffer, ULONG countBytes, ULONG* bytesRead) noexcept override try
         {
-            ULONG amountToRead = std::min(countBytes, static_cast<ULONG>(m_data->size() - m_offset));
-            if (amountToRead > 0) { memcpy(buffer, &(m_data->at(m_offset)), amountToRead); }                
-            m_offset += amountToRead;
-            if (bytesRead) { *bytesRead = amountToRead; }
+            ULONG amountRead = ReadAt(m_offset, buffer, countBytes);
+            m_offset += amountRead;
+            if (bytesRead) { *bytesRead = amountRead; }
             return static_cast<HRESULT>(Error::OK);
         } CATCH_RETURN();
 
@@ -40,13 +39,23 @@ namespace MSIX {
                 newPos.QuadPart = static_cast<std::uint64_t>(m_data->size()) + move.QuadPart;
                 break;
             }
-            m_offset = std::min(newPos.u.LowPart, static_cast<ULONG>(m_data->size()));
-            if (newPosition) { newPosition->QuadPart = newPos.QuadPart; }
+            ThrowErrorIf(Error::FileSeek, (newPos.QuadPart < 0), "seek failed");
+            m_offset = std::min(static_cast<std::uint64_t>(newPos.QuadPart), static_cast<std::uint64_t>(m_data->size()));
+            if (newPosition) { newPosition->QuadPart = m_offset; }
             return static_cast<HRESULT>(Error::OK);
         } CATCH_RETURN();
 
+        // IStreamInternal
+        ULONG ReadAt(std::uint64_t offset, void* buffer, ULONG countBytes) override
+        {
+            if (offset >= m_data->size()) { return 0; }
+            ULONG amountToRead = static_cast<ULONG>(std::min(static_cast<std::uint64_t>(countBytes), static_cast<std::uint64_t>(m_data->size()) - offset));
+            memcpy(buffer, &(m_data->at(offset)), amountToRead);
+            return amountToRead;
+        }
+
     protected:
-        ULONG m_offset = 0;
+        std::uint64_t m_offset = 0;
         std::vector<std::uint8_t>* m_data;
     };
 } // namespace MSIX
\ No newline at end of file
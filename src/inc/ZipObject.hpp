@@ -11,27 +11,124 @@
 #include "AppxFactory.hpp"
 
 #include <vector>
-#include <map>
+#include <string>
 #include <memory>
 
 namespace MSIX {
+    // What the central directory says about a file; enough to find and validate its local file header later.
+    struct ZipEntry
+    {
+        std::uint64_t localHeaderOffset;
+        std::uint64_t compressedSize;
+        std::uint64_t uncompressedSize;
+        bool          isGeneralPurposeBitSet;
+        std::uint16_t compressionMethod;
+    };
+
+    // Where a file's data is in the archive and how it is stored, as established by validating its local file header.
+    struct ZipFileLocation
+    {
+        std::string   name;
+        std::uint64_t dataOffset;
+        std::uint64_t compressedSize;
+        std::uint64_t uncompressedSize;
+        bool          isCompressed;
+    };
+}
+
+// internal interface
+EXTERN_C const IID IID_IZipArchive;
+#ifndef WIN32
+// {4e6b1d92-7c35-4a08-b5f1-93d2c8e0a714}
+interface IZipArchive : public IUnknown
+#else
+#include "Unknwn.h"
+#include "Objidl.h"
+class IZipArchive : public IUnknown
+#endif
+{
+public:
+    // Returns the stream over the whole archive.
+    virtual MSIX::ComPtr<IStream> GetArchiveStream() = 0;
+
+    // Sets 'location' to where the data of 'fileName' is in the archive and how it is stored, validating the file's
+    // local file header first if that hasn't been done yet. Returns false when there is no such file.
+    virtual bool GetFileLocation(const std::string& fileName, MSIX::ZipFileLocation& location) = 0;
+};
+SpecializeUuidOfImpl(IZipArchive);
+
+namespace MSIX {
+
+    // Flat table of the entries in a zip archive's central directory. Names are interned into a single arena, the
+    // rest of each entry lives in parallel arrays indexed by entry, and an open addressing hash index over the names
+    // makes lookups O(1).
+    class ZipEntryTable
+    {
+    public:
+        static const std::uint32_t NotFound = 0xFFFFFFFF;
+
+        void Reserve(std::size_t count);
+
+        // Adds an entry and returns its index. As with the central directory, the first entry with a name wins.
+        std::uint32_t Add(const std::string& name, const ZipEntry& entry);
+        std::uint32_t Find(const std::string& name) const;
+
+        std::size_t   Size() const { return m_nameOffsets.size(); }
+        std::string   GetName(std::uint32_t index) const { return std::string(&m_names[m_nameOffsets[index]], m_nameLengths[index]); }
+        ZipEntry      GetEntry(std::uint32_t index) const;
+        std::uint64_t GetLocalHeaderOffset(std::uint32_t index) const { return m_localHeaderOffsets[index]; }
+
+    protected:
+        std::uint32_t Lookup(const char* name, std::size_t length, std::size_t* slot) const;
+        void Rehash(std::size_t capacity);
+
+        std::vector<char>          m_names;
+        std::vector<std::uint32_t> m_nameOffsets;
+        std::vector<std::uint16_t> m_nameLengths;
+        std::vector<std::uint64_t> m_localHeaderOffsets;
+        std::vector<std::uint64_t> m_compressedSizes;
+        std::vector<std::uint64_t> m_uncompressedSizes;
+        std::vector<std::uint16_t> m_compressionMethods;
+        std::vector<bool>          m_generalPurposeBits;
+        std::vector<std::uint32_t> m_index;  // entry index per slot, or NotFound for an empty slot
+    };
+
     // This represents a raw stream over a.zip file.
-    class ZipObject final : public ComClass<ZipObject, IStorageObject>
+    class ZipObject final : public ComClass<ZipObject, IStorageObject, IZipArchive>
     {
     public:
         ZipObject(IMSIXFactory* factory, const ComPtr<IStream>& stream);
 
+        // Opens an archive whose files were located, and their headers validated, by an earlier ZipObject.
+        ZipObject(IMSIXFactory* factory, const ComPtr<IStream>& stream, const std::vector<ZipFileLocation>& files);
+
+        // Returns the location of every file in the archive, by entry.
+        std::vector<ZipFileLocation> GetFileLocations();
+
         // StorageObject methods
         const char*                 GetPathSeparator() override { return "/"; }
         std::vector<std::string>    GetFileNames(FileNameOptions options) override;
         ComPtr<IStream>             GetFile(const std::string& fileName) override;
+        void                        PrepareFiles() override;
+        bool                        SupportsConcurrentReads() override;
 
         ComPtr<IStream>             OpenFile(const std::string& fileName, MSIX::FileStream::Mode mode) override { NOTIMPLEMENTED; }
         void                        CommitChanges() override { NOTIMPLEMENTED; }
 
+        // IZipArchive
+        ComPtr<IStream>             GetArchiveStream() override { return m_stream; }
+        bool                        GetFileLocation(const std::string& fileName, ZipFileLocation& location) override;
+
     protected:
-        IMSIXFactory*                          m_factory;
-        ComPtr<IStream>                        m_stream;
-        std::map<std::string, ComPtr<IStream>> m_streams;
+        void ResolveEntries(std::vector<std::uint32_t>& entries);
+        ComPtr<IStream> CreateFileStream(const ZipFileLocation& location);
+
+        IMSIXFactory*                 m_factory;
+        ComPtr<IStream>               m_stream;
+        ZipEntryTable                 m_entries;
+        std::vector<ComPtr<IStream>>  m_streams; // by entry; files that have been asked for, created on demand
+        std::vector<ZipFileLocation>  m_locations; // by entry; filled in along with m_streams
+        std::uint64_t                 m_archiveSize = 0;
+        std::uint64_t                 m_lastHeaderRead = 0;
     };//class ZipObject
 }
@@ -11,13 +11,15 @@
 #include <string>
 #include <initializer_list>
 #include <algorithm>
+#include <chrono>
 
 // Describes which command the user specified
 enum class UserSpecified
 {
     Nothing,
     Help,
-    Unpack
+    Unpack,
+    Verify
 };
 
 // Tracks the state of the current parse operation as well as implements input validation
@@ -52,6 +54,24 @@ struct State
         return true;
     }
 
+    bool UsePackageIndex()
+    {
+        validationOptions = static_cast<MSIX_VALIDATION_OPTION>(validationOptions | MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_USEPACKAGEINDEX);
+        return true;
+    }
+
+    bool UnpackInParallel()
+    {
+        unpackOptions = static_cast<MSIX_PACKUNPACK_OPTION>(unpackOptions | MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_UNPACKINPARALLEL);
+        return true;
+    }
+
+    bool UnpackPipelined()
+    {
+        unpackOptions = static_cast<MSIX_PACKUNPACK_OPTION>(unpackOptions | MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_UNPACKPIPELINED);
+        return true;
+    }
+
     bool SetPackageName(const std::string& name)
     {
         if (!packageName.empty() || name.empty()) { return false; }
@@ -74,6 +94,12 @@ struct State
             if (packageName.empty() || directoryName.empty()) {
                 return false;
             }            
+            break;
+        case UserSpecified::Verify:
+            if (packageName.empty()) {
+                return false;
+            }
+            break;
         }
         return true;
     }
@@ -159,6 +185,15 @@ int Help(char* toolName, std::vector<Command>& commands, State& state)
         std::cout << "    specified output <directory>.  The output has the same directory structure " << std::endl;
         std::cout << "    as the package." << std::endl;
         break;
+    case UserSpecified::Verify:
+        command = std::find(commands.begin(), commands.end(), "verify");
+        std::cout << "    " << toolName << " verify -p <package> [options] " << std::endl;
+        std::cout << std::endl;
+        std::cout << "Description:" << std::endl;
+        std::cout << "------------" << std::endl;
+        std::cout << "    Checks every file within an app package at the input <package> name against" << std::endl;
+        std::cout << "    the package's block map, without extracting any of them." << std::endl;
+        break;
     }
     std::cout << std::endl;
     std::cout << "Options:" << std::endl;
@@ -216,6 +251,43 @@ bool ParseInput(std::vector<Command>& commands, State& state, int argc, char* ar
     return state.Validate();
 }
 
+// Prints the outcome of each file as VerifyPackage reports it, and keeps the totals.
+struct VerifyResults
+{
+    static void STDMETHODCALLTYPE Report(void* context, const char* fileName, UINT64 size, HRESULT result)
+    {
+        auto results = reinterpret_cast<VerifyResults*>(context);
+        results->files++;
+        results->bytes += size;
+        if (result == 0)
+        {   std::cout << "PASS " << fileName << " (" << std::dec << size << " bytes)" << std::endl;
+        }
+        else
+        {   results->failed++;
+            std::cout << "FAIL " << fileName << " (error " << std::hex << result << ")" << std::endl;
+        }
+    }
+
+    std::uint64_t files  = 0;
+    std::uint64_t failed = 0;
+    std::uint64_t bytes  = 0;
+};
+
+int Verify(State& state)
+{
+    VerifyResults results;
+    auto start = std::chrono::steady_clock::now();
+    HRESULT hr = VerifyPackage(state.validationOptions, const_cast<char*>(state.packageName.c_str()),
+        VerifyResults::Report, &results);
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << std::dec << results.files << " files, " << results.failed << " failed, " << results.bytes <<
+        " bytes in " << std::fixed << std::setprecision(1) << elapsed << " ms";
+    if (elapsed > 0) { std::cout << " (" << (results.bytes / (1024.0 * 1024.0)) / (elapsed / 1000.0) << " MB/s)"; }
+    std::cout << std::endl;
+    return hr;
+}
+
 // Parses argc/argv input via commands into state, and calls into the 
 // appropriate function with the correct parameters if warranted.
 int ParseAndRun(std::vector<Command>& commands, int argc, char* argv[])
@@ -235,6 +307,8 @@ int ParseAndRun(std::vector<Command>& commands, int argc, char* argv[])
             const_cast<char*>(state.packageName.c_str()),
             const_cast<char*>(state.directoryName.c_str())
         );
+    case UserSpecified::Verify:
+        return Verify(state);
     }
     return -1; // should never end up here.
 }
@@ -272,10 +346,33 @@ int main(int argc, char* argv[])
                     [](State& state, const std::string&) { return state.AllowSignatureOriginUnknown(); }),
                 Option("-ss", false, "Skips enforcement of signed packages.  By default packages must be signed.",
                     [](State& state, const std::string&) { return state.SkipSignature(); }),
+                Option("-pi", false, "Opens the package from its index (<package>.msixindex) when it is unchanged since the index was written, and writes the index otherwise.",
+                    [](State& state, const std::string&) { return state.UsePackageIndex(); }),
+                Option("-mt", false, "Extracts files on several threads when the package can be read concurrently.  By default files are extracted one at a time.",
+                    [](State& state, const std::string&) { return state.UnpackInParallel(); }),
+                Option("-pl", false, "Extracts files through a pipeline that reads, inflates, validates and writes them on separate threads at once.",
+                    [](State& state, const std::string&) { return state.UnpackPipelined(); }),
                 Option("-?", false, "Displays this help text.",
                     [](State& state, const std::string&) { return false; })                
             })
         },
+        {   Command("verify", "Check the files of a package against its block map",
+                [](State& state) { return state.Specify(UserSpecified::Verify); },
+            {
+                Option("-p", true, "REQUIRED, specify input package name.",
+                    [](State& state, const std::string& name) { return state.SetPackageName(name); }),
+                Option("-mv", false, "Skips manifest validation.  By default manifest validation is enabled.",
+                    [](State& state, const std::string&) { return state.SkipManifestValidation(); }),
+                Option("-sv", false, "Skips signature validation.  By default signature validation is enabled.",
+                    [](State& state, const std::string&) { return state.AllowSignatureOriginUnknown(); }),
+                Option("-ss", false, "Skips enforcement of signed packages.  By default packages must be signed.",
+                    [](State& state, const std::string&) { return state.SkipSignature(); }),
+                Option("-pi", false, "Opens the package from its index (<package>.msixindex) when it is unchanged since the index was written, and writes the index otherwise.",
+                    [](State& state, const std::string&) { return state.UsePackageIndex(); }),
+                Option("-?", false, "Displays this help text.",
+                    [](State& state, const std::string&) { return false; })
+            })
+        },
         {   Command("-?", "Displays this help text.",
                 [](State& state) { return state.Specify(UserSpecified::Help);}, {})
         },
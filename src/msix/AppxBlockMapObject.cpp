@@ -8,6 +8,7 @@
 #include "IXml.hpp"
 #include "BlockMapStream.hpp"
 #include "MSIXResource.hpp"
+#include "PackageIndex.hpp"
 
 /* Example XML:
 <?xml version="1.0" encoding="UTF-8"?>
@@ -36,7 +37,7 @@ namespace MSIX {
         const auto& attributeValue = element->GetAttributeValue(attribute);
         bool hasValue = !attributeValue.empty();
         T value = defaultValue;
-        if (hasValue) { value = static_cast<T>(std::stoul(attributeValue)); }
+        if (hasValue) { value = static_cast<T>(std::stoull(attributeValue)); }
         return value;        
     }
 
@@ -44,7 +45,9 @@ namespace MSIX {
     {
         Block result {0};
         result.compressedSize = GetNumber<std::uint64_t>(element, XmlAttributeName::BlockMap_File_Block_Size, BLOCKMAP_BLOCK_SIZE);
-        result.hash = element->GetBase64DecodedAttributeValue(XmlAttributeName::BlockMap_File_Block_Hash);
+        auto hash = element->GetBase64DecodedAttributeValue(XmlAttributeName::BlockMap_File_Block_Hash);
+        ThrowErrorIf(Error::BlockMapSemanticError, (hash.size() != result.hash.size()), "Block hash is not a SHA256 hash");
+        std::copy(hash.begin(), hash.end(), result.hash.begin());
         return result;
     }
 
@@ -52,53 +55,113 @@ namespace MSIX {
     {
         ComPtr<IXmlFactory> xmlFactory;
         ThrowHrIfFailed(factory->QueryInterface(UuidOfImpl<IXmlFactory>::iid, reinterpret_cast<void**>(&xmlFactory)));        
+    #if VALIDATING
+        // Validating parsers check the whole document before anything is read from it, so query the DOM.
         auto dom = xmlFactory->CreateDomFromStream(XmlContentType::AppxBlockMapXml, stream);
 
         struct _context
         {
             AppxBlockMapObject* self;
-            IMSIXFactory*       factory;
-            size_t              countFilesFound;
             IXmlDom*            dom;
         };
-        _context context = { this, factory, 0, dom.Get() };
+        _context context = { this, dom.Get() };
 
         XmlVisitor visitor(static_cast<void*>(&context), [](void* c, const ComPtr<IXmlElement>& fileNode)->bool
         {
-            const auto& name = fileNode->GetAttributeValue(XmlAttributeName::BlockMap_File_Name);
-            ThrowErrorIf(Error::BlockMapSemanticError, (name == "[Content_Types].xml"), "[Content_Types].xml cannot be in the AppxBlockMap.xml file");
-
             _context* context = reinterpret_cast<_context*>(c);
-            std::ostringstream builder;
-            builder << "Duplicate file: '" << name << "' specified in AppxBlockMap.xml.";
-            ThrowErrorIf(Error::BlockMapSemanticError, (context->self->m_blockMap.find(name) != context->self->m_blockMap.end()), builder.str().c_str());
-
-            std::vector<Block> blocks;
-            XmlVisitor visitor(static_cast<void*>(&blocks), [](void* b, const ComPtr<IXmlElement>& blockNode)->bool
+            struct _fileContext
+            {
+                AppxBlockMapObject* self;
+                FileBlocks*         file;
+            };
+            _fileContext fileContext = { context->self, &context->self->AddFile(fileNode) };
+            XmlVisitor visitor(static_cast<void*>(&fileContext), [](void* f, const ComPtr<IXmlElement>& blockNode)->bool
             {
-                std::vector<Block>* blocks = reinterpret_cast<std::vector<Block>*>(b);       
-                blocks->push_back(GetBlock(blockNode));
+                _fileContext* fileContext = reinterpret_cast<_fileContext*>(f);
+                fileContext->self->AddBlock(*fileContext->file, blockNode);
                 return true;
             });
             context->dom->ForEachElementIn(fileNode, XmlQueryName::BlockMap_File_Block, visitor);
-
-            std::uint64_t sizeAttribute = GetNumber<std::uint64_t>(fileNode, XmlAttributeName::BlockMap_File_Block_Size, BLOCKMAP_BLOCK_SIZE);
-            ThrowErrorIf(Error::BlockMapSemanticError, (0 == blocks.size() && 0 != sizeAttribute), "If size is non-zero, then there must be 1+ blocks.");
-            
-            context->self->m_blockMap.insert(std::make_pair(name, std::move(blocks)));
-            context->self->m_blockMapFiles.insert(std::make_pair(name,
-                ComPtr<IAppxBlockMapFile>::Make<AppxBlockMapFile>(
-                    context->factory,
-                    &(context->self->m_blockMap[name]),
-                    GetNumber<std::uint32_t>(fileNode, XmlAttributeName::BlockMap_File_LocalFileHeaderSize, 0),
-                    name,
-                    sizeAttribute
-                )));
-            context->countFilesFound++;    
             return true;            
         });
         dom->ForEachElementIn(dom->GetDocument(), XmlQueryName::BlockMap_File, visitor);
-        ThrowErrorIf(Error::BlockMapSemanticError, (0 == context.countFilesFound), "Empty AppxBlockMap.xml");
+    #else
+        // Read the blockmap once, front to back. Each Block comes right after the File it belongs to.
+        struct _context
+        {
+            AppxBlockMapObject* self;
+            FileBlocks*         file;
+        };
+        _context context = { this, nullptr };
+
+        XmlElementVisitor visitor(static_cast<void*>(&context), [](void* c, XmlQueryName query, const ComPtr<IXmlElement>& node)->bool
+        {
+            _context* context = reinterpret_cast<_context*>(c);
+            if (query == XmlQueryName::BlockMap_File) { context->file = &context->self->AddFile(node); }
+            else if (query == XmlQueryName::BlockMap_File_Block) { context->self->AddBlock(*context->file, node); }
+            return true;
+        });
+        xmlFactory->ForEachElementInStream(XmlContentType::AppxBlockMapXml, stream, visitor);
+    #endif
+        ThrowErrorIf(Error::BlockMapSemanticError, m_blockMap.empty(), "Empty AppxBlockMap.xml");
+        for (const auto& file : m_blockMap)
+        {   ThrowErrorIf(Error::BlockMapSemanticError, (file.second.countBlocks == 0 && file.second.size != 0), "If size is non-zero, then there must be 1+ blocks.");
+        }
+        AddFiles();
+    }
+
+    AppxBlockMapObject::AppxBlockMapObject(IMSIXFactory* factory, const ComPtr<IStream>& stream, const PackageIndex& index) :
+        m_factory(factory), m_stream(stream)
+    {
+        m_blocks = index.blocks;
+        for (const auto& file : index.blockMapFiles)
+        {
+            FileBlocks blocks;
+            blocks.firstBlock          = file.firstBlock;
+            blocks.countBlocks         = file.countBlocks;
+            blocks.localFileHeaderSize = file.localFileHeaderSize;
+            blocks.size                = file.size;
+            m_blockMap.insert(std::make_pair(file.name, blocks));
+        }
+        AddFiles();
+    }
+
+    AppxBlockMapObject::FileBlocks& AppxBlockMapObject::AddFile(const ComPtr<IXmlElement>& fileNode)
+    {
+        const auto& name = fileNode->GetAttributeValue(XmlAttributeName::BlockMap_File_Name);
+        ThrowErrorIf(Error::BlockMapSemanticError, (name == "[Content_Types].xml"), "[Content_Types].xml cannot be in the AppxBlockMap.xml file");
+
+        std::ostringstream builder;
+        builder << "Duplicate file: '" << name << "' specified in AppxBlockMap.xml.";
+        ThrowErrorIf(Error::BlockMapSemanticError, (m_blockMap.find(name) != m_blockMap.end()), builder.str().c_str());
+
+        FileBlocks file;
+        file.firstBlock          = m_blocks.size();
+        file.countBlocks         = 0;
+        file.localFileHeaderSize = GetNumber<std::uint32_t>(fileNode, XmlAttributeName::BlockMap_File_LocalFileHeaderSize, 0);
+        file.size                = GetNumber<std::uint64_t>(fileNode, XmlAttributeName::BlockMap_File_Block_Size, BLOCKMAP_BLOCK_SIZE);
+        return m_blockMap.insert(std::make_pair(name, file)).first->second;
+    }
+
+    void AppxBlockMapObject::AddBlock(FileBlocks& file, const ComPtr<IXmlElement>& blockNode)
+    {
+        m_blocks.push_back(GetBlock(blockNode));
+        file.countBlocks++;
+    }
+
+    void AppxBlockMapObject::AddFiles()
+    {
+        for (const auto& file : m_blockMap)
+        {
+            m_blockMapFiles.insert(std::make_pair(file.first,
+                ComPtr<IAppxBlockMapFile>::Make<AppxBlockMapFile>(
+                    m_factory,
+                    BlockSpan(m_blocks.data() + file.second.firstBlock, file.second.countBlocks),
+                    file.second.localFileHeaderSize,
+                    file.first,
+                    file.second.size
+                )));
+        }
     }
 
     ComPtr<IStream> AppxBlockMapObject::GetValidationStream(const std::string& part, const ComPtr<IStream>& stream)
@@ -108,7 +171,9 @@ namespace MSIX {
         std::ostringstream builder;
         builder << "file: '" << part << "' not tracked by blockmap.";
         ThrowErrorIf(Error::BlockMapSemanticError, item == m_blockMap.end(), builder.str().c_str());
-        return ComPtr<IStream>::Make<BlockMapStream>(m_factory, part, stream, item->second);
+        ComPtr<IAppxBlockMapReader> self;
+        ThrowHrIfFailed(QueryInterface(UuidOfImpl<IAppxBlockMapReader>::iid, reinterpret_cast<void**>(&self)));
+        return ComPtr<IStream>::Make<BlockMapStream>(m_factory, part, stream, GetBlocks(part), self);
     }
 
     HRESULT STDMETHODCALLTYPE AppxBlockMapObject::GetFile(LPCWSTR filename, IAppxBlockMapFile **file) noexcept try
@@ -162,11 +227,11 @@ namespace MSIX {
         return fileNames;
     }
 
-    std::vector<Block> AppxBlockMapObject::GetBlocks(const std::string& fileName)
+    BlockSpan AppxBlockMapObject::GetBlocks(const std::string& fileName)
     {   
         auto index = m_blockMap.find(fileName);
         ThrowErrorIf(Error::FileNotFound, (index == m_blockMap.end()), "File not in blockmap");
-        return index->second;
+        return BlockSpan(m_blocks.data() + index->second.firstBlock, index->second.countBlocks);
     }
 
     ComPtr<IAppxBlockMapFile> AppxBlockMapObject::GetFile(const std::string& fileName)
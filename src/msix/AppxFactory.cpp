@@ -9,6 +9,7 @@
 #include "AppxPackageObject.hpp"
 #include "MSIXResource.hpp"
 #include "VectorStream.hpp"
+#include "PackageIndex.hpp"
 
 namespace MSIX {
     // IAppxFactory
@@ -28,9 +29,26 @@ namespace MSIX {
         ComPtr<IMSIXFactory> self;
         ThrowHrIfFailed(QueryInterface(UuidOfImpl<IMSIXFactory>::iid, reinterpret_cast<void**>(&self)));
         ComPtr<IStream> input(inputStream);
-        auto zip = ComPtr<IStorageObject>::Make<ZipObject>(self.Get(), input);
-        auto result = ComPtr<IAppxPackageReader>::Make<AppxPackageObject>(self.Get(), m_validationOptions, zip);
-        *packageReader = result.Detach();
+        bool usePackageIndex = (m_validationOptions & MSIX_VALIDATION_OPTION_USEPACKAGEINDEX) != 0;
+        if (usePackageIndex)
+        {   // An index written by an earlier open of the same, unchanged, package stands in for validating it again.
+            auto index = PackageIndex::Load(input, m_validationOptions);
+            if (index)
+            {   auto zip = ComPtr<IStorageObject>::Make<ZipObject>(self.Get(), input, index->files);
+                *packageReader = ComPtr<IAppxPackageReader>::Make<AppxPackageObject>(self.Get(), m_validationOptions, zip, *index).Detach();
+                return static_cast<HRESULT>(Error::OK);
+            }
+        }
+
+        auto zip = ComPtr<ZipObject>::Make<ZipObject>(self.Get(), input);
+        auto result = ComPtr<AppxPackageObject>::Make<AppxPackageObject>(self.Get(), m_validationOptions, zip.As<IStorageObject>());
+        if (usePackageIndex)
+        {   PackageIndex index;
+            index.files = zip->GetFileLocations();
+            result->Describe(index);
+            index.Save(input, m_validationOptions);
+        }
+        *packageReader = result.As<IAppxPackageReader>().Detach();
         return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
 
@@ -74,10 +92,13 @@ namespace MSIX {
         ComPtr<IMSIXFactory> self;
         ThrowHrIfFailed(QueryInterface(UuidOfImpl<IMSIXFactory>::iid, reinterpret_cast<void**>(&self)));
         auto stream = ComPtr<IStream>::Make<FileStream>(utf16_to_utf8(signatureFileName), FileStream::Mode::READ);
-        auto signature = ComPtr<IVerifierObject>::Make<AppxSignatureObject>(self.Get(), self->GetValidationOptions(), stream);
+        auto signature = ComPtr<AppxSignatureObject>::Make<AppxSignatureObject>(self.Get(), self->GetValidationOptions(), stream);
         ComPtr<IStream> input(inputStream);
-        auto validatedStream = signature->GetValidationStream("AppxBlockMap.xml", input);
-        *blockMapReader = ComPtr<IAppxBlockMapReader>::Make<AppxBlockMapObject>(self.Get(), validatedStream).Detach();
+        ComPtr<IAppxBlockMapReader> reader;
+        signature->ParseValidationStream("AppxBlockMap.xml", input, [&](const ComPtr<IStream>& validatedStream)
+        {   reader = ComPtr<IAppxBlockMapReader>::Make<AppxBlockMapObject>(self.Get(), validatedStream);
+        });
+        *blockMapReader = reader.Detach();
         return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
 
@@ -11,6 +11,9 @@
 #include "UnicodeConversion.hpp"
 #include "IXml.hpp"
 #include "MSIXResource.hpp"
+#include "MSIXFactory.hpp"
+#include "ThreadPool.hpp"
+#include "UnpackPipeline.hpp"
 
 #include <string>
 #include <vector>
@@ -19,6 +22,10 @@
 #include <limits>
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <numeric>
 
 namespace MSIX {
 
@@ -36,6 +43,12 @@ namespace MSIX {
         CODEINTEGRITY_CAT,
     };
 
+    static bool IsFootprintFile(const std::string& fileName)
+    {
+        return (fileName == CONTENT_TYPES_XML) ||
+            (std::find(footprintFiles.begin(), footprintFiles.end(), fileName) != footprintFiles.end());
+    }
+
     static const std::size_t PercentangeEncodingTableSize = 0x5E;
     static const std::array<const char*, PercentangeEncodingTableSize> PercentangeEncoding =
     {   nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
@@ -143,6 +156,11 @@ namespace MSIX {
         ThrowErrorIfNot(Error::AppxManifestSemanticError, m_packageId, "No Identity element in AppxManifest.xml");
     }
 
+    AppxManifestObject::AppxManifestObject(const ComPtr<IStream>& stream, const PackageIndex& index) : m_stream(stream)
+    {
+        m_packageId = std::make_unique<AppxPackageId>(index.name, index.version, index.resourceId, index.architecture, index.publisher);
+    }
+
     AppxPackageObject::AppxPackageObject(IMSIXFactory* factory, MSIX_VALIDATION_OPTION validation, const ComPtr<IStorageObject>& container) :
         m_factory(factory),
         m_validation(validation),
@@ -151,6 +169,10 @@ namespace MSIX {
         ComPtr<IXmlFactory> xmlFactory;
         ThrowHrIfFailed(factory->QueryInterface(UuidOfImpl<IXmlFactory>::iid, reinterpret_cast<void**>(&xmlFactory)));        
 
+        // 0. Containers only open their files on demand, but a structurally broken container is reported as
+        // such ahead of anything that's wrong with the package's contents, so have it prepare all of them now.
+        m_container->PrepareFiles();
+
         // 1. Get the appx signature from the container and parse it
         // TODO: pass validation flags and other necessary goodness through.
         auto file = m_container->GetFile(APPXSIGNATURE_P7X);
@@ -158,26 +180,29 @@ namespace MSIX {
         {   ThrowErrorIfNot(Error::MissingAppxSignatureP7X, file, "AppxSignature.p7x not in archive!");
         }
 
-        m_appxSignature = ComPtr<IVerifierObject>::Make<AppxSignatureObject>(factory, validation, file);
+        m_appxSignature = ComPtr<AppxSignatureObject>::Make<AppxSignatureObject>(factory, validation, file);
 
         // 2. Get content type using signature object for validation
         file = m_container->GetFile(CONTENT_TYPES_XML);
         ThrowErrorIfNot(Error::MissingContentTypesXML, file, "[Content_Types].xml not in archive!");
-        ComPtr<IStream> stream = m_appxSignature->GetValidationStream(CONTENT_TYPES_XML, file);        
-        auto contentType = xmlFactory->CreateDomFromStream(XmlContentType::ContentTypeXml, stream);
+        ComPtr<IXmlDom> contentType;
+        m_appxSignature->ParseValidationStream(CONTENT_TYPES_XML, file, [&](const ComPtr<IStream>& stream)
+        {   contentType = xmlFactory->CreateDomFromStream(XmlContentType::ContentTypeXml, stream);
+        });
 
         // 3. Get blockmap object using signature object for validation        
         file = m_container->GetFile(APPXBLOCKMAP_XML);
         ThrowErrorIfNot(Error::MissingAppxBlockMapXML, file, "AppxBlockMap.xml not in archive!");
-        stream = m_appxSignature->GetValidationStream(APPXBLOCKMAP_XML, file);
-        m_appxBlockMap = ComPtr<IVerifierObject>::Make<AppxBlockMapObject>(factory, stream);
+        m_appxSignature->ParseValidationStream(APPXBLOCKMAP_XML, file, [&](const ComPtr<IStream>& stream)
+        {   m_appxBlockMap = ComPtr<IVerifierObject>::Make<AppxBlockMapObject>(factory, stream);
+        });
 
         // 4. Get manifest object using blockmap object for validation
         // TODO: pass validation flags and other necessary goodness through.
         file = m_container->GetFile(APPXMANIFEST_XML);
         ThrowErrorIfNot(Error::MissingAppxManifestXML, file, "AppxManifest.xml not in archive!");
-        stream = m_appxBlockMap->GetValidationStream(APPXMANIFEST_XML, file);
-        m_appxManifest = ComPtr<IVerifierObject>::Make<AppxManifestObject>(xmlFactory.Get(), stream);
+        auto stream = m_appxBlockMap->GetValidationStream(APPXMANIFEST_XML, file);
+        m_appxManifest = ComPtr<AppxManifestObject>::Make<AppxManifestObject>(xmlFactory.Get(), stream);
         
         if ((validation & MSIX_VALIDATION_OPTION_SKIPSIGNATURE) == 0)
         {
@@ -186,43 +211,15 @@ namespace MSIX {
                 (0 == m_appxManifest->GetPublisher().compare(m_appxSignature->GetPublisher())), reason.c_str());
         }
 
-        struct Config
-        {
-            typedef ComPtr<IStream> (*lambda)(AppxPackageObject* self);
-            Config(const char* n, lambda f) : GetValidationStream(f), Name(n) {}
-
-            const char* Name;
-            lambda GetValidationStream;
-
-            bool operator==(const std::string& rhs) const {
-                return rhs == Name;
-            }
-        };
-
-        static const Config footPrintFileNames[] = {
-            Config(APPXBLOCKMAP_XML,  [](AppxPackageObject* self){ self->m_footprintFiles.push_back(APPXBLOCKMAP_XML);  return self->m_appxBlockMap->GetStream();}),
-            Config(APPXMANIFEST_XML,  [](AppxPackageObject* self){ self->m_footprintFiles.push_back(APPXMANIFEST_XML);  return self->m_appxManifest->GetStream();}),
-            Config(APPXSIGNATURE_P7X, [](AppxPackageObject* self){ if (self->m_appxSignature->HasStream()){self->m_footprintFiles.push_back(APPXSIGNATURE_P7X);} return self->m_appxSignature->GetStream();}),
-            Config(CODEINTEGRITY_CAT, [](AppxPackageObject* self){ self->m_footprintFiles.push_back(CODEINTEGRITY_CAT); auto file = self->m_container->GetFile(CODEINTEGRITY_CAT); return self->m_appxSignature->GetValidationStream(CODEINTEGRITY_CAT, file);}),
-            Config(CONTENT_TYPES_XML, [](AppxPackageObject*)->ComPtr<IStream>{ return ComPtr<IStream>();}), // content types is never implicitly unpacked
-        };
-
         // 5. Ensure that the stream collection contains streams wired up for their appropriate validation
         // and partition the container's file names into footprint and payload files.  First by going through
         // the footprint files, and then by going through the payload files.
         auto filesToProcess = m_container->GetFileNames(FileNameOptions::All);
-        for (const auto& fileName : m_container->GetFileNames(FileNameOptions::FootPrintOnly))
-        {   auto footPrintFile = std::find(std::begin(footPrintFileNames), std::end(footPrintFileNames), fileName);
-            if (footPrintFile != std::end(footPrintFileNames))
-            {   m_streams[fileName] = footPrintFile->GetValidationStream(this);
-                filesToProcess.erase(std::remove(filesToProcess.begin(), filesToProcess.end(), fileName), filesToProcess.end());
-            }
-        }
-        
+        AddFootprintFiles(filesToProcess);
+
         auto blockMapInternal = m_appxBlockMap.As<IAppxBlockMapInternal>();
         for (const auto& fileName : blockMapInternal->GetFileNames())
-        {   auto footPrintFile = std::find(std::begin(footPrintFileNames), std::end(footPrintFileNames), fileName);
-            if (footPrintFile == std::end(footPrintFileNames))
+        {   if (!IsFootprintFile(fileName))
             {   std::string containerFileName = EncodeFileName(fileName);
                 m_payloadFiles.push_back(containerFileName);
                 auto fileStream = m_container->GetFile(containerFileName);
@@ -283,29 +280,313 @@ namespace MSIX {
         ThrowErrorIfNot(Error::BlockMapSemanticError, (filesToProcess.empty()), "Payload file not described in AppxBlockMap.xml");
     }
 
+    AppxPackageObject::AppxPackageObject(IMSIXFactory* factory, MSIX_VALIDATION_OPTION validation, const ComPtr<IStorageObject>& container, const PackageIndex& index) :
+        m_factory(factory),
+        m_validation(validation),
+        m_container(container)
+    {
+        // What parsing the footprint files established is restored from the index rather than parsed again, but
+        // their streams are still wired up for validation against the digests and blocks the index recorded.
+        m_appxSignature = ComPtr<AppxSignatureObject>::Make<AppxSignatureObject>(validation, m_container->GetFile(APPXSIGNATURE_P7X), index);
+
+        auto file = m_container->GetFile(APPXBLOCKMAP_XML);
+        ThrowErrorIfNot(Error::MissingAppxBlockMapXML, file, "AppxBlockMap.xml not in archive!");
+        m_appxBlockMap = ComPtr<IVerifierObject>::Make<AppxBlockMapObject>(factory, m_appxSignature->GetValidationStream(APPXBLOCKMAP_XML, file), index);
+
+        file = m_container->GetFile(APPXMANIFEST_XML);
+        ThrowErrorIfNot(Error::MissingAppxManifestXML, file, "AppxManifest.xml not in archive!");
+        m_appxManifest = ComPtr<AppxManifestObject>::Make<AppxManifestObject>(m_appxBlockMap->GetValidationStream(APPXMANIFEST_XML, file), index);
+
+        auto filesToProcess = m_container->GetFileNames(FileNameOptions::All);
+        AddFootprintFiles(filesToProcess);
+
+        auto blockMapInternal = m_appxBlockMap.As<IAppxBlockMapInternal>();
+        for (const auto& fileName : blockMapInternal->GetFileNames())
+        {   if (!IsFootprintFile(fileName))
+            {   std::string containerFileName = EncodeFileName(fileName);
+                auto fileStream = m_container->GetFile(containerFileName);
+                ThrowErrorIf(Error::FileNotFound, !fileStream, "File described in blockmap not contained in OPC container");
+                m_payloadFiles.push_back(containerFileName);
+                m_streams[containerFileName] = m_appxBlockMap->GetValidationStream(fileName, fileStream);
+                filesToProcess.erase(std::remove(filesToProcess.begin(), filesToProcess.end(), containerFileName), filesToProcess.end());
+            }
+        }
+        ThrowErrorIfNot(Error::BlockMapSemanticError, (filesToProcess.empty()), "Payload file not described in AppxBlockMap.xml");
+    }
+
+    // Adds the footprint files in the container to the stream collection, each wired up for its validation, and
+    // removes them from 'filesToProcess'.
+    void AppxPackageObject::AddFootprintFiles(std::vector<std::string>& filesToProcess)
+    {
+        struct Config
+        {
+            typedef ComPtr<IStream> (*lambda)(AppxPackageObject* self);
+            Config(const char* n, lambda f) : GetValidationStream(f), Name(n) {}
+
+            const char* Name;
+            lambda GetValidationStream;
+
+            bool operator==(const std::string& rhs) const {
+                return rhs == Name;
+            }
+        };
+
+        static const Config footPrintFileNames[] = {
+            Config(APPXBLOCKMAP_XML,  [](AppxPackageObject* self){ self->m_footprintFiles.push_back(APPXBLOCKMAP_XML);  return self->m_appxBlockMap->GetStream();}),
+            Config(APPXMANIFEST_XML,  [](AppxPackageObject* self){ self->m_footprintFiles.push_back(APPXMANIFEST_XML);  return self->m_appxManifest->GetStream();}),
+            Config(APPXSIGNATURE_P7X, [](AppxPackageObject* self){ if (self->m_appxSignature->HasStream()){self->m_footprintFiles.push_back(APPXSIGNATURE_P7X);} return self->m_appxSignature->GetStream();}),
+            Config(CODEINTEGRITY_CAT, [](AppxPackageObject* self){ self->m_footprintFiles.push_back(CODEINTEGRITY_CAT); auto file = self->m_container->GetFile(CODEINTEGRITY_CAT); return self->m_appxSignature->GetValidationStream(CODEINTEGRITY_CAT, file);}),
+            Config(CONTENT_TYPES_XML, [](AppxPackageObject*)->ComPtr<IStream>{ return ComPtr<IStream>();}), // content types is never implicitly unpacked
+        };
+
+        for (const auto& fileName : m_container->GetFileNames(FileNameOptions::FootPrintOnly))
+        {   auto footPrintFile = std::find(std::begin(footPrintFileNames), std::end(footPrintFileNames), fileName);
+            if (footPrintFile != std::end(footPrintFileNames))
+            {   m_streams[fileName] = footPrintFile->GetValidationStream(this);
+                filesToProcess.erase(std::remove(filesToProcess.begin(), filesToProcess.end(), fileName), filesToProcess.end());
+            }
+        }
+    }
+
+    void AppxPackageObject::Describe(PackageIndex& index)
+    {
+        index.hasDigests             = m_appxSignature->HasDigests();
+        index.signatureOrigin        = m_appxSignature->GetSignatureOrigin();
+        index.signaturePublisher     = m_appxSignature->GetPublisher();
+        index.fileRecordsDigest      = m_appxSignature->GetFileRecordsDigest();
+        index.centralDirectoryDigest = m_appxSignature->GetCentralDirectoryDigest();
+        index.contentTypesDigest     = m_appxSignature->GetContentTypesDigest();
+        index.blockMapDigest         = m_appxSignature->GetAppxBlockMapDigest();
+        index.codeIntegrityDigest    = m_appxSignature->GetCodeIntegrityDigest();
+
+        auto blockMapInternal = m_appxBlockMap.As<IAppxBlockMapInternal>();
+        for (const auto& fileName : blockMapInternal->GetFileNames())
+        {   UINT64 size = 0;
+            UINT32 localFileHeaderSize = 0;
+            auto blockMapFile = blockMapInternal->GetFile(fileName);
+            ThrowHrIfFailed(blockMapFile->GetUncompressedSize(&size));
+            ThrowHrIfFailed(blockMapFile->GetLocalFileHeaderSize(&localFileHeaderSize));
+
+            PackageIndex::BlockMapFile file;
+            file.name                = fileName;
+            file.size                = size;
+            file.localFileHeaderSize = localFileHeaderSize;
+            auto blocks              = blockMapInternal->GetBlocks(fileName);
+            file.firstBlock          = index.blocks.size();
+            file.countBlocks         = blocks.size();
+            index.blocks.insert(index.blocks.end(), blocks.begin(), blocks.end());
+            index.blockMapFiles.push_back(std::move(file));
+        }
+
+        auto packageId     = m_appxManifest->GetPackageId();
+        index.name         = packageId->Name;
+        index.version      = packageId->Version;
+        index.resourceId   = packageId->ResourceId;
+        index.architecture = packageId->Architecture;
+        index.publisher    = packageId->Publisher;
+    }
+
     void AppxPackageObject::Unpack(MSIX_PACKUNPACK_OPTION options, const ComPtr<IStorageObject>& to)
     {
-        auto fileNames = GetFileNames(FileNameOptions::All);
-        for (const auto& fileName : fileNames)
+        ComPtr<IZipArchive> archive;
+        if ((options & MSIX_PACKUNPACK_OPTION_UNPACKPIPELINED) &&
+            SUCCEEDED(m_container->QueryInterface(UuidOfImpl<IZipArchive>::iid, reinterpret_cast<void**>(&archive))))
+        {   UnpackPipelined(options, archive, to);
+            return;
+        }
+
+        auto fileNames = GetExtractionOrder();
+        if (!(options & MSIX_PACKUNPACK_OPTION_UNPACKINPARALLEL) || !SupportsConcurrentReads() ||
+            (m_factory->GetThreadPool().GetConcurrency() < 2))
+        {
+            for (const auto& fileName : fileNames) { UnpackFile(options, fileName, to); }
+            return;
+        }
+
+        // Start on the largest files, so that one of them doesn't hold up the end of the run on its own. Every file
+        // has a stream of its own that reads the package positionally, so workers don't share a read position.
+        std::vector<UINT64> sizes(fileNames.size());
+        for (std::size_t index = 0; index < fileNames.size(); index++)
+        {   auto file = GetFile(fileNames[index]).As<IAppxFile>();
+            ThrowHrIfFailed(file->GetSize(&sizes[index]));
+        }
+        std::vector<std::size_t> order(fileNames.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return sizes[a] > sizes[b]; });
+
+        // Whatever the timing, report the failure that unpacking the files one after another would have: that of
+        // the first file, in extraction order, that fails. Files after one known to fail no longer need unpacking.
+        std::vector<std::exception_ptr> failures(fileNames.size());
+        std::atomic<std::size_t> firstFailure(fileNames.size());
+        m_factory->GetThreadPool().ForEach(order.size(), [&](std::size_t position)
         {
-            std::string targetName;
-            if (options & MSIX_PACKUNPACK_OPTION_CREATEPACKAGESUBFOLDER)
-            {   //targetName = GetAppxManifest()->GetPackageFullName() + to->GetPathSeparator() + fileName;
-                NOTIMPLEMENTED;
+            std::size_t index = order[position];
+            if (index > firstFailure) { return; }
+            try
+            {   UnpackFile(options, fileNames[index], to);
             }
-            else
-            {   targetName = DecodeFileName(fileName);
+            catch (...)
+            {   failures[index] = std::current_exception();
+                std::size_t first = firstFailure;
+                while ((index < first) && !firstFailure.compare_exchange_weak(first, index)) {}
+            }
+        });
+        if (firstFailure < fileNames.size()) { std::rethrow_exception(failures[firstFailure]); }
+    }
+
+    // Footprint files are validated against the signature rather than the blockmap, so they are still read through
+    // their streams; the payload files go through the pipeline, which validates them against the blockmap itself.
+    void AppxPackageObject::UnpackPipelined(MSIX_PACKUNPACK_OPTION options, const ComPtr<IZipArchive>& archive, const ComPtr<IStorageObject>& to)
+    {
+        for (const auto& fileName : m_footprintFiles) { UnpackFile(options, fileName, to); }
+
+        auto blockMapInternal = m_appxBlockMap.As<IAppxBlockMapInternal>();
+        std::vector<UnpackPipeline::File> files;
+        files.reserve(m_payloadFiles.size());
+        for (const auto& fileName : blockMapInternal->GetFileNames())
+        {   if (std::find(footprintFiles.begin(), footprintFiles.end(), fileName) == footprintFiles.end())
+            {   std::string containerFileName = EncodeFileName(fileName);
+                UnpackPipeline::File file;
+                file.targetName = GetTargetName(options, containerFileName);
+                ThrowErrorIfNot(Error::FileNotFound, archive->GetFileLocation(containerFileName, file.location),
+                    "File described in blockmap not contained in OPC container");
+                file.blocks = blockMapInternal->GetBlocks(fileName);
+                files.push_back(std::move(file));
             }
+        }
+        // In archive order, so that reads go through the package front to back and neighbouring files share reads.
+        std::stable_sort(files.begin(), files.end(), [](const UnpackPipeline::File& a, const UnpackPipeline::File& b)
+        {   return a.location.dataOffset < b.location.dataOffset;
+        });
+        UnpackPipeline(archive->GetArchiveStream(), std::move(files), to).Run();
+    }
 
-            auto targetFile = to->OpenFile(targetName, MSIX::FileStream::Mode::WRITE_UPDATE);
-            auto sourceFile = GetFile(fileName);
+    // The files in the order their data is in the archive, so that unpacking all of them reads the package from front
+    // to back rather than seeking around it in name order. Files of containers that aren't zip archives stay in name
+    // order.
+    std::vector<std::string> AppxPackageObject::GetExtractionOrder()
+    {
+        auto fileNames = GetFileNames(FileNameOptions::All);
+        ComPtr<IZipArchive> archive;
+        if (FAILED(m_container->QueryInterface(UuidOfImpl<IZipArchive>::iid, reinterpret_cast<void**>(&archive))))
+        {   return fileNames;
+        }
 
-            ULARGE_INTEGER bytesCount = {0};
-            bytesCount.QuadPart = std::numeric_limits<std::uint64_t>::max();
-            ThrowHrIfFailed(sourceFile->CopyTo(targetFile.Get(), bytesCount, nullptr, nullptr));
+        std::vector<std::pair<std::uint64_t, std::string>> offsets;
+        offsets.reserve(fileNames.size());
+        for (auto& fileName : fileNames)
+        {   ZipFileLocation location;
+            std::uint64_t offset = archive->GetFileLocation(fileName, location) ? location.dataOffset : std::numeric_limits<std::uint64_t>::max();
+            offsets.emplace_back(offset, std::move(fileName));
         }
+        std::stable_sort(offsets.begin(), offsets.end(), [](const std::pair<std::uint64_t, std::string>& a, const std::pair<std::uint64_t, std::string>& b)
+        {   return a.first < b.first;
+        });
+
+        std::vector<std::string> result;
+        result.reserve(offsets.size());
+        for (auto& entry : offsets) { result.push_back(std::move(entry.second)); }
+        return result;
     }
 
+    std::string AppxPackageObject::GetTargetName(MSIX_PACKUNPACK_OPTION options, const std::string& fileName)
+    {
+        if (options & MSIX_PACKUNPACK_OPTION_CREATEPACKAGESUBFOLDER)
+        {   //return GetAppxManifest()->GetPackageFullName() + to->GetPathSeparator() + fileName;
+            NOTIMPLEMENTED;
+        }
+        return DecodeFileName(fileName);
+    }
+
+    void AppxPackageObject::UnpackFile(MSIX_PACKUNPACK_OPTION options, const std::string& fileName, const ComPtr<IStorageObject>& to)
+    {
+        auto targetFile = to->OpenFile(GetTargetName(options, fileName), MSIX::FileStream::Mode::WRITE_UPDATE);
+        auto sourceFile = GetFile(fileName);
+
+        ULARGE_INTEGER bytesCount = {0};
+        bytesCount.QuadPart = std::numeric_limits<std::uint64_t>::max();
+        ThrowHrIfFailed(sourceFile->CopyTo(targetFile.Get(), bytesCount, nullptr, nullptr));
+    }
+
+    // Swallows whatever is written to it, so files can be read through CopyTo without keeping them.
+    class NullStream final : public StreamBase
+    {
+    public:
+        HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER, DWORD, ULARGE_INTEGER* newPosition) noexcept override
+        {
+            if (newPosition) { newPosition->QuadPart = 0; }
+            return static_cast<HRESULT>(Error::OK);
+        }
+
+        HRESULT STDMETHODCALLTYPE Write(const void*, ULONG countBytes, ULONG* bytesWritten) noexcept override
+        {
+            if (bytesWritten) { *bytesWritten = countBytes; }
+            return static_cast<HRESULT>(Error::OK);
+        }
+    };
+
+    // Reads all of 'stream', which checks it against the blockmap on the way, and puts its seek pointer back.
+    HRESULT AppxPackageObject::VerifyFile(const ComPtr<IStream>& stream) noexcept try
+    {
+        ULARGE_INTEGER position = {0};
+        ThrowHrIfFailed(stream->Seek({0}, StreamBase::Reference::CURRENT, &position));
+        ThrowHrIfFailed(stream->Seek({0}, StreamBase::Reference::START, nullptr));
+        auto nullStream = ComPtr<IStream>::Make<NullStream>();
+        ULARGE_INTEGER bytesCount = {0};
+        bytesCount.QuadPart = std::numeric_limits<std::uint64_t>::max();
+        HRESULT hr = stream->CopyTo(nullStream.Get(), bytesCount, nullptr, nullptr);
+        LARGE_INTEGER restore = {0};
+        restore.QuadPart = static_cast<LONGLONG>(position.QuadPart);
+        ThrowHrIfFailed(stream->Seek(restore, StreamBase::Reference::START, nullptr));
+        return hr;
+    } CATCH_RETURN();
+
+    HRESULT STDMETHODCALLTYPE AppxPackageObject::VerifyPayloadFiles(MSIX_VERIFY_FILE_CALLBACK* callback, void* context) noexcept try
+    {
+        struct File
+        {
+            const std::string* name;
+            ComPtr<IStream> stream;
+            std::uint64_t size;
+        };
+        std::vector<File> files;
+        for (const auto& fileName : m_payloadFiles)
+        {
+            auto stream = GetFile(fileName);
+            ThrowErrorIf(Error::FileNotFound, !stream, "payload file has no stream");
+            ULARGE_INTEGER size = {0};
+            ULARGE_INTEGER position = {0};
+            ThrowHrIfFailed(stream->Seek({0}, StreamBase::Reference::CURRENT, &position));
+            ThrowHrIfFailed(stream->Seek({0}, StreamBase::Reference::END, &size));
+            LARGE_INTEGER restore = {0};
+            restore.QuadPart = static_cast<LONGLONG>(position.QuadPart);
+            ThrowHrIfFailed(stream->Seek(restore, StreamBase::Reference::START, nullptr));
+            files.push_back(File{&fileName, stream, size.QuadPart});
+        }
+        // Start on the largest files, so that one of them doesn't hold up the end of the run on its own.
+        std::stable_sort(files.begin(), files.end(), [](const File& a, const File& b) { return a.size > b.size; });
+
+        std::mutex lock;
+        HRESULT result = static_cast<HRESULT>(Error::OK);
+        auto verify = [&](std::size_t index)
+        {
+            const File& file = files[index];
+            HRESULT hr = VerifyFile(file.stream);
+            std::lock_guard<std::mutex> guard(lock);
+            if (FAILED(hr) && SUCCEEDED(result)) { result = hr; }
+            if (callback) { callback(context, DecodeFileName(*file.name).c_str(), file.size, hr); }
+        };
+
+        // Large files spread their blocks across the factory's threads too; the pool lets that nest.
+        if (SupportsConcurrentReads())
+        {   m_factory->GetThreadPool().ForEach(files.size(), verify);
+        }
+        else
+        {   for (std::size_t index = 0; index < files.size(); index++) { verify(index); }
+        }
+        return result;
+    } CATCH_RETURN();
+
     const char* AppxPackageObject::GetPathSeparator() { return "/"; }
 
     std::vector<std::string> AppxPackageObject::GetFileNames(FileNameOptions options)
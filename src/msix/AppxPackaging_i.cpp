@@ -28,6 +28,15 @@ typedef struct _IID
 #define MIDL_DEFINE_GUID(type,name,l,w1,w2,b1,b2,b3,b4,b5,b6,b7,b8) \
         extern "C" const type name = {l,w1,w2,{b1,b2,b3,b4,b5,b6,b7,b8}}
 
+// The IIDs of the MSIX specific interfaces are exported, as clients have no other definition of them to link to.
+#ifdef WIN32
+#define MSIX_IID_EXPORT __declspec(dllexport)
+#else
+#define MSIX_IID_EXPORT __attribute__((visibility("default")))
+#endif
+#define MSIX_DEFINE_EXPORTED_GUID(type,name,l,w1,w2,b1,b2,b3,b4,b5,b6,b7,b8) \
+        extern "C" MSIX_IID_EXPORT const type name = {l,w1,w2,{b1,b2,b3,b4,b5,b6,b7,b8}}
+
 MIDL_DEFINE_GUID(IID, IID_IUnknown,0x00000000,0x0000,0x0000,0xC0,0x00,0x00,0x00,0x00,0x00,0x00,0x46);
 MIDL_DEFINE_GUID(IID, IID_ISequentialStream,0x0c733a30,0x2a1c,0x11ce,0xad,0xe5,0x00,0xaa,0x00,0x44,0x77,0x3d);
 MIDL_DEFINE_GUID(IID, IID_IStream,0x0000000c,0x0000,0x0000,0xC0,0x00,0x00,0x00,0x00,0x00,0x00,0x46);
@@ -99,6 +108,10 @@ MIDL_DEFINE_GUID(IID, IID_IAppxEncryptedBundleWriter2,0xE644BE82,0xF0FA,0x42B8,0
 //MIDL_DEFINE_GUID(IID, IID_IAppxEncryptedBundleWriter3,0x0D34DEB3,0x5CAE,0x4DD3,0x97,0x7C,0x50,0x49,0x32,0xA5,0x1D,0x31);
 //MIDL_DEFINE_GUID(IID, IID_IAppxPackageEditor,0xE2ADB6DC,0x5E71,0x4416,0x86,0xB6,0x86,0xE5,0xF5,0x29,0x1A,0x6B);
 
+// MSIX specific interfaces.
+MSIX_DEFINE_EXPORTED_GUID(IID, IID_IMsixPackageVerifier,0x3f1f8c6e,0x95b4,0x4a3a,0xb0,0xf2,0x6d,0x2c,0x1e,0x7a,0x4b,0x58);
+MSIX_DEFINE_EXPORTED_GUID(IID, IID_IMsixFactoryConcurrency,0x9d4c7b21,0x6a3e,0x4f85,0xb1,0xd2,0x0e,0x8f,0x5a,0x3c,0x6b,0x94);
+
 // internal interfaces.
 MIDL_DEFINE_GUID(IID, IID_IPackage,              0x51B2C456,0xAAA9,0x46D6,0x8E,0xC9,0x29,0x82,0x20,0x55,0x91,0x89);
 MIDL_DEFINE_GUID(IID, IID_IStorageObject,        0xEC25B96E,0x0DB1,0x4483,0xBD,0xB1,0xCA,0xB1,0x10,0x9C,0xB7,0x41);
@@ -109,6 +122,8 @@ MIDL_DEFINE_GUID(IID, IID_IXmlDom,               0x0e7a446e,0xbaf7,0x44c1,0xb3,0
 MIDL_DEFINE_GUID(IID, IID_IXmlFactory,           0xf82a60ec,0xfbfc,0x4cb9,0xbc,0x04,0x1a,0x0f,0xe2,0xb4,0xd5,0xbe);
 MIDL_DEFINE_GUID(IID, IID_IAppxBlockMapInternal, 0x67fed21a,0x70ef,0x4175,0x8f,0x12,0x41,0x5b,0x21,0x3a,0xb6,0xd2);
 MIDL_DEFINE_GUID(IID, IID_IAppxFileInternal,     0xcd24e5d3,0x4a35,0x4497,0xba,0x7e,0xd6,0x8d,0xf0,0x5c,0x58,0x2c);
+MIDL_DEFINE_GUID(IID, IID_IStreamInternal,       0x8b7a2e4c,0x5d16,0x4f0a,0x9c,0x3e,0x2f,0x61,0xd8,0xa4,0xb0,0x79);
+MIDL_DEFINE_GUID(IID, IID_IZipArchive,           0x4e6b1d92,0x7c35,0x4a08,0xb5,0xf1,0x93,0xd2,0xc8,0xe0,0xa7,0x14);
 
 // internal XML PAL interfaces
 #ifdef USING_XERCES
@@ -120,6 +135,10 @@ MIDL_DEFINE_GUID(IID, IID_IMSXMLElement,  0x2730f595,0x0c80,0x4f3e,0x88,0x91,0x7
 MIDL_DEFINE_GUID(IID, IID_IMSXMLDom,      0xb6bca5f0,0xc6c1,0x4409,0x85,0xbe,0xe4,0x76,0xaa,0xbe,0xc1,0x9a);
 #endif
 
+#ifdef USING_LITE_XML
+MIDL_DEFINE_GUID(IID, IID_ILiteXmlElement, 0x5b0e4a8d,0x1f6c,0x4d3b,0x9e,0x27,0x8c,0x4f,0x2a,0x61,0xd0,0xb3);
+#endif
+
 #undef MIDL_DEFINE_GUID
 
 }
@@ -12,6 +12,7 @@
 #include "ComHelper.hpp"
 #include "SignatureValidator.hpp"
 #include "BlockMapStream.hpp"
+#include "PackageIndex.hpp"
 
 #include <string>
 #include <vector>
@@ -78,25 +79,62 @@ AppxSignatureObject::AppxSignatureObject(IMSIXFactory* factory, MSIX_VALIDATION_
     }
 }
 
-ComPtr<IStream>  AppxSignatureObject::GetValidationStream(const std::string& part, const ComPtr<IStream>& stream)
+AppxSignatureObject::AppxSignatureObject(MSIX_VALIDATION_OPTION validationOptions, const ComPtr<IStream>& stream, const PackageIndex& index) :
+    m_hasDigests(index.hasDigests),
+    m_FileRecords(index.fileRecordsDigest),
+    m_CentralDirectory(index.centralDirectoryDigest),
+    m_ContentTypes(index.contentTypesDigest),
+    m_AppxBlockMap(index.blockMapDigest),
+    m_CodeIntegrity(index.codeIntegrityDigest),
+    m_signatureOrigin(index.signatureOrigin),
+    m_validationOptions(validationOptions),
+    m_stream(stream),
+    m_publisher(index.signaturePublisher)
+{
+}
+
+AppxSignatureObject::Digest* AppxSignatureObject::GetPartDigest(const std::string& part)
 {
     if (m_hasDigests)
     {
         if (part == std::string("AppxBlockMap.xml"))
-        {   // This stream implementation will throw if the underlying stream does not match the digest
-            return ComPtr<IStream>::Make<HashStream>(stream, this->GetAppxBlockMapDigest());
+        {   return &this->GetAppxBlockMapDigest();
         }
         else if (part == std::string("[Content_Types].xml"))
-        {   // This stream implementation will throw if the underlying stream does not match the digest'
-            return ComPtr<IStream>::Make<HashStream>(stream, this->GetContentTypesDigest());
+        {   return &this->GetContentTypesDigest();
         }
-        else if (part == std::string("CodeIntegrity.cat"))
-        {   // This stream implementation will throw if the underlying stream does not match the digest
-            return ComPtr<IStream>::Make<HashStream>(stream, this->GetCodeIntegrityDigest());
+        else if (part == std::string("AppxMetadata/CodeIntegrity.cat"))
+        {   return &this->GetCodeIntegrityDigest();
         }
         // TODO: unnamed stream for central directory?
     }
+    return nullptr;
+}
+
+ComPtr<IStream>  AppxSignatureObject::GetValidationStream(const std::string& part, const ComPtr<IStream>& stream)
+{
+    Digest* digest = GetPartDigest(part);
+    if (digest)
+    {   // This stream implementation will throw if the underlying stream does not match the digest
+        return ComPtr<IStream>::Make<HashStream>(stream, *digest);
+    }
     return stream;
 }
 
+ComPtr<IStream>  AppxSignatureObject::ParseValidationStream(const std::string& part, const ComPtr<IStream>& stream,
+    const std::function<void(const ComPtr<IStream>&)>& parse)
+{
+    Digest* digest = GetPartDigest(part);
+    if (!digest)
+    {   parse(stream);
+        return stream;
+    }
+    auto hashStream = ComPtr<HashStream>::Make<HashStream>(stream, *digest);
+    auto result = hashStream.As<IStream>();
+    hashStream->HashWhileReading(true);
+    parse(result);
+    hashStream->HashWhileReading(false);
+    return result;
+}
+
 } // namespace MSIX
@@ -0,0 +1,26 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+// 
+#include "Counters.hpp"
+#include "Exceptions.hpp"
+
+#include <atomic>
+#include <array>
+
+namespace MSIX { namespace Global { namespace Counters {
+static std::array<std::atomic<std::uint64_t>, MSIX_COUNTER_MAX> g_counters;
+
+void Increment(MSIX_COUNTER counter, std::uint64_t value)
+{
+    ThrowErrorIf(Error::InvalidParameter, (counter >= MSIX_COUNTER_MAX), "unknown counter");
+    g_counters[counter] += value;
+}
+
+std::uint64_t Get(MSIX_COUNTER counter)
+{
+    ThrowErrorIf(Error::InvalidParameter, (counter >= MSIX_COUNTER_MAX), "unknown counter");
+    return g_counters[counter].load();
+}
+
+} /* Counters */ } /* Global */ } /* msix */
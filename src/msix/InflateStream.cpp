@@ -13,8 +13,29 @@
 #include <cstring>
 #include <array>
 #include <utility>
+#include <limits>
 
 namespace MSIX {
+    // A package has an InflateStream per compressed file, so rather than each one initializing an inflater of its
+    // own, they borrow one from the thread they inflate on for as long as they're inflating.
+    static const std::size_t INFLATER_POOL_SIZE = 8;
+    static thread_local std::vector<std::unique_ptr<Inflater>> inflaterPool;
+
+    static std::unique_ptr<Inflater> AcquireInflater()
+    {
+        if (inflaterPool.empty()) { return std::make_unique<Inflater>(); }
+        std::unique_ptr<Inflater> inflater = std::move(inflaterPool.back());
+        inflaterPool.pop_back();
+        inflater->Reset();
+        return inflater;
+    }
+
+    static void ReleaseInflater(std::unique_ptr<Inflater>& inflater)
+    {
+        if (inflater && (inflaterPool.size() < INFLATER_POOL_SIZE)) { inflaterPool.push_back(std::move(inflater)); }
+        inflater.reset();
+    }
+
     struct InflateHandler
     {
         typedef std::pair<bool, InflateStream::State>(*lambda)(InflateStream* self, void* buffer, ULONG countBytes);
@@ -26,48 +47,76 @@ namespace MSIX {
     {            
         // State::UNINITIALIZED
         InflateHandler([](InflateStream* self, void*, ULONG)
-        {
-            ThrowHrIfFailed(self->m_stream->Seek({0}, StreamBase::START, nullptr));
-            self->m_zstrm = { 0 };
-            self->m_fileCurrentPosition = 0;
-            self->m_fileCurrentWindowPositionEnd = 0;
+        {   // Start at the independently compressed block the seek position is in, if the blocks are known.
+            self->m_startBlock = 0;
+            if (!self->m_blockOffsets.empty())
+            {   self->m_startBlock = static_cast<std::size_t>(std::min(
+                    static_cast<std::uint64_t>(self->m_seekPosition) / self->m_blockSize, static_cast<std::uint64_t>(self->m_blockOffsets.size() - 1)));
+            }
+            self->m_compressedPosition = self->m_blockOffsets.empty() ? 0 : self->m_blockOffsets[self->m_startBlock];
+            self->m_inputSize = 0;
+            self->m_fileCurrentPosition = self->m_startBlock * self->m_blockSize;
+            self->m_fileCurrentWindowPositionEnd = self->m_fileCurrentPosition;
 
-            int ret = inflateInit2(&(self->m_zstrm), -MAX_WBITS);
-            ThrowErrorIfNot(Error::InflateInitialize, (ret == Z_OK), "inflateInit2 failed");
+            self->m_inflater = AcquireInflater();
             return std::make_pair(true, InflateStream::State::READY_TO_READ);
         }), // State::UNINITIALIZED
 
         // State::READY_TO_READ
         InflateHandler([](InflateStream* self, void*, ULONG)
         {
-            ThrowErrorIfNot(Error::InflateRead,(self->m_zstrm.avail_in == 0), "uninflated bytes overwritten");
-            ULONG available = 0;
-            ThrowHrIfFailed(self->m_stream->Read(self->m_compressedBuffer, InflateStream::BUFFERSIZE, &available));
+            ThrowErrorIfNot(Error::InflateRead,(self->m_inputSize == 0), "uninflated bytes overwritten");
+            ULONG available = StreamBase::ReadAt(self->m_stream.Get(), self->m_streamInternal.Get(), self->m_compressedPosition, self->m_compressedBuffer, InflateStream::BUFFERSIZE);
+            self->m_compressedPosition += available;
             ThrowErrorIf(Error::FileRead, (available == 0), "Getting nothing back is unexpected here.");
-            self->m_zstrm.avail_in = static_cast<uInt>(available);
-            self->m_zstrm.next_in = self->m_compressedBuffer;
+            self->m_inputSize = available;
+            self->m_input = self->m_compressedBuffer;
             return std::make_pair(true, InflateStream::State::READY_TO_INFLATE);
         }), // State::READY_TO_READ
 
         // State::READY_TO_INFLATE
-        InflateHandler([](InflateStream* self, void*, ULONG)
-        {
+        InflateHandler([](InflateStream* self, void* buffer, ULONG countBytes)
+        {   // When there's nothing to skip and the caller wants at least a window's worth, inflate straight into the
+            // caller's buffer instead of going through m_inflateWindow.
+            bool inflateToBuffer = (countBytes >= InflateStream::BUFFERSIZE) &&
+                (self->m_fileCurrentPosition == self->m_seekPosition) && (self->m_fileCurrentWindowPositionEnd == self->m_seekPosition);
+            std::uint8_t* output = inflateToBuffer ? reinterpret_cast<std::uint8_t*>(buffer) : self->m_inflateWindow;
+            std::size_t outputSize = inflateToBuffer ?
+                static_cast<std::size_t>(std::min(static_cast<ULONGLONG>(countBytes), self->m_uncompressedSize - self->m_fileCurrentPosition)) :
+                InflateStream::BUFFERSIZE;
+            std::size_t outputAvailable = outputSize;
             self->m_inflateWindowPosition = 0;
-            self->m_zstrm.avail_out = InflateStream::BUFFERSIZE;
-            self->m_zstrm.next_out = self->m_inflateWindow;
-            self->m_zret = inflate(&(self->m_zstrm), Z_NO_FLUSH);
-            switch (self->m_zret)
+            self->m_inflateWindowSize = 0;
+            self->m_inflateResult = self->m_inflater->Inflate(self->m_input, self->m_inputSize, output, outputSize);
+            ULONG inflated = static_cast<ULONG>(outputAvailable - outputSize);
+            if ((self->m_inflateResult == Inflater::Result::Corrupt) && (self->m_startBlock != 0))
+            {   // The data refers back to before the block inflating started at, so the blocks weren't compressed
+                // independently after all. Whatever was inflated up to here is right; inflate the rest from the start.
+                self->m_blockOffsets.clear();
+                self->Cleanup();
+                return std::make_pair(true, InflateStream::State::UNINITIALIZED);
+            }
+            if (self->m_inflateResult == Inflater::Result::Corrupt)
             {
-            case Z_NEED_DICT:
-            case Z_DATA_ERROR:
-            case Z_MEM_ERROR:
                 self->Cleanup();
                 ThrowErrorIfNot(Error::InflateCorruptData, false, "inflate failed unexpectedly.");
-            case Z_STREAM_END:
-            default:
-                self->m_fileCurrentWindowPositionEnd += (InflateStream::BUFFERSIZE - self->m_zstrm.avail_out);
-                return std::make_pair(true, InflateStream::State::READY_TO_COPY);
             }
+            self->m_fileCurrentWindowPositionEnd += inflated;
+            if (inflateToBuffer)
+            {   // The window stays empty, so READY_TO_COPY moves straight on to inflating more.
+                self->m_bytesRead           += inflated;
+                self->m_seekPosition        += inflated;
+                self->m_fileCurrentPosition += inflated;
+                if (self->m_fileCurrentPosition == self->m_uncompressedSize)
+                {
+                    self->Cleanup();
+                    return std::make_pair(false, InflateStream::State::UNINITIALIZED);
+                }
+            }
+            else
+            {   self->m_inflateWindowSize = inflated;
+            }
+            return std::make_pair(true, InflateStream::State::READY_TO_COPY);
         }), // State::READY_TO_INFLATE
 
         // State::READY_TO_COPY
@@ -76,28 +125,29 @@ namespace MSIX {
             // Check if we're actually at the end of stream.
             if (self->m_fileCurrentPosition >= self->m_uncompressedSize)
             {
-                ThrowErrorIfNot(Error::InflateCorruptData, ((self->m_zret == Z_STREAM_END) && (self->m_zstrm.avail_in == 0)), "unexpected extra data");
+                ThrowErrorIfNot(Error::InflateCorruptData, ((self->m_inflateResult == Inflater::Result::End) && (self->m_inputSize == 0)), "unexpected extra data");
                 return std::make_pair(true, InflateStream::State::CLEANUP);
             }
 
             // If the end of the current window position is less than the seek position, keep inflating
             if (self->m_fileCurrentWindowPositionEnd < self->m_seekPosition)
             {
-                self->m_fileCurrentPosition += self->m_zstrm.avail_out;
-                return std::make_pair(true, (self->m_zstrm.avail_in == 0) ? InflateStream::State::READY_TO_READ : InflateStream::State::READY_TO_INFLATE);
+                self->m_fileCurrentPosition = self->m_fileCurrentWindowPositionEnd;
+                return std::make_pair(true, (self->m_inputSize == 0) ? InflateStream::State::READY_TO_READ : InflateStream::State::READY_TO_INFLATE);
             }
 
             // now that we're within the window between current file position and seek position
             // calculate the number of bytes to skip ahead within this window
             ULONG bytesToSkipInWindow = (ULONG)(self->m_seekPosition - self->m_fileCurrentPosition);
             self->m_inflateWindowPosition += bytesToSkipInWindow;
+            self->m_fileCurrentPosition   += bytesToSkipInWindow;
 
             // Calculate the difference between the beginning of the window and the seek position.
             // if there's nothing left in the window to copy, then we need to fetch another window.
-            ULONG bytesRemainingInWindow = (InflateStream::BUFFERSIZE - self->m_zstrm.avail_out) - self->m_inflateWindowPosition;
+            ULONG bytesRemainingInWindow = self->m_inflateWindowSize - self->m_inflateWindowPosition;
             if (bytesRemainingInWindow == 0)
             {
-                return std::make_pair(true, (self->m_zstrm.avail_in == 0) ? InflateStream::State::READY_TO_READ : InflateStream::State::READY_TO_INFLATE);
+                return std::make_pair(true, (self->m_inputSize == 0) ? InflateStream::State::READY_TO_READ : InflateStream::State::READY_TO_INFLATE);
             }
 
             ULONG bytesToCopy = std::min(countBytes, bytesRemainingInWindow);
@@ -132,7 +182,7 @@ namespace MSIX {
         m_state(State::UNINITIALIZED),
         m_uncompressedSize(uncompressedSize)
     {
-        m_zstrm = {0};
+        m_stream->QueryInterface(UuidOfImpl<IStreamInternal>::iid, reinterpret_cast<void**>(&m_streamInternal));
     }
 
     InflateStream::~InflateStream()
@@ -187,7 +237,11 @@ namespace MSIX {
             // zlib and start inflating from the beginning of the
             // stream; otherwise, seeking forward is fine: We will
             // catch up to the seek pointer during the ::Read operation.
-            if (m_seekPosition < m_fileCurrentPosition)
+            // When the stream's blocks are known, inflating can also start over at the block that holds the seek
+            // position; which is also what to do when seeking forward past the end of the block being inflated.
+            bool isPastCurrentBlock = !m_blockOffsets.empty() &&
+                ((m_seekPosition / m_blockSize) > (m_fileCurrentWindowPositionEnd / m_blockSize));
+            if ((m_seekPosition < m_fileCurrentPosition) || isPastCurrentBlock)
             {
                 m_fileCurrentPosition = 0;
                 Cleanup();
@@ -197,13 +251,70 @@ namespace MSIX {
         return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
 
-    void InflateStream::Cleanup()
+    ULONG InflateStream::ReadAt(std::uint64_t offset, void* buffer, ULONG countBytes)
+    {   // Inflating only moves forward cheaply, so rather than restoring the seek pointer (which would mean inflating
+        // from the start of the stream on the next read) it is left just past the bytes read.
+        LARGE_INTEGER position = {0};
+        position.QuadPart = offset;
+        ThrowHrIfFailed(Seek(position, Reference::START, nullptr));
+        ULONG bytesRead = 0;
+        ThrowHrIfFailed(Read(buffer, countBytes, &bytesRead));
+        return bytesRead;
+    }
+
+    void InflateStream::SetCompressedBlocks(std::uint64_t blockSize, const std::vector<std::uint64_t>& compressedSizes)
+    {
+        std::vector<std::uint64_t> offsets;
+        offsets.reserve(compressedSizes.size());
+        std::uint64_t offset = 0;
+        for (auto size : compressedSizes)
+        {
+            offsets.push_back(offset);
+            offset += size;
+        }
+
+        // Only use the blocks if they account for all of the data; the last one may be followed by the two bytes
+        // that end the deflate stream when every block was compressed with Z_FULL_FLUSH.
+        std::uint64_t compressedSize = GetCompressedSize();
+        bool coversCompressedData = (offset == compressedSize) || (offset + 2 == compressedSize);
+        bool coversUncompressedData = (blockSize != 0) && !offsets.empty() &&
+            (((offsets.size() - 1) * blockSize) < m_uncompressedSize) && (m_uncompressedSize <= (offsets.size() * blockSize));
+        if (coversCompressedData && coversUncompressedData)
+        {
+            m_blockSize = blockSize;
+            m_blockOffsets = std::move(offsets);
+            m_blocksEnd = offset;
+        }
+    }
+
+    bool InflateStream::DecompressBlock(std::size_t index, std::uint8_t* buffer)
     {
-        if (m_state != State::UNINITIALIZED)
+        if (index >= m_blockOffsets.size()) { return false; }
+        std::uint64_t compressedOffset = m_blockOffsets[index];
+        std::uint64_t compressedSize = ((index + 1 < m_blockOffsets.size()) ? m_blockOffsets[index + 1] : m_blocksEnd) - compressedOffset;
+        std::uint64_t size = std::min(m_blockSize, static_cast<std::uint64_t>(m_uncompressedSize) - (index * m_blockSize));
+        if ((compressedSize > std::numeric_limits<ULONG>::max()) || (size > std::numeric_limits<std::size_t>::max())) { return false; }
+
+        // Inflate straight out of the mapped package when possible; otherwise copy the block's compressed bytes out.
+        const std::uint8_t* compressed = m_streamInternal ? m_streamInternal->GetMappedData(compressedOffset, compressedSize) : nullptr;
+        thread_local std::vector<std::uint8_t> compressedBuffer;
+        if (compressed == nullptr)
         {
-            inflateEnd(&m_zstrm);
-            m_state = State::UNINITIALIZED;
+            compressedBuffer.resize(static_cast<size_t>(compressedSize));
+            std::lock_guard<std::mutex> lock(m_blockReadLock);
+            ULONG read = StreamBase::ReadAt(m_stream.Get(), m_streamInternal.Get(), compressedOffset, compressedBuffer.data(), static_cast<ULONG>(compressedSize));
+            ThrowErrorIf(Error::FileRead, (read != compressedSize), "read failed");
+            compressed = compressedBuffer.data();
         }
+
+        // A block that refers back into an earlier one fails to inflate rather than producing a whole block.
+        return BlockInflater::Inflate(compressed, static_cast<std::size_t>(compressedSize), buffer, static_cast<std::size_t>(size));
+    }
+
+    void InflateStream::Cleanup()
+    {   // The inflater goes back to the pool until inflating starts over.
+        ReleaseInflater(m_inflater);
+        m_state = State::UNINITIALIZED;
     }
 } /* msix */
 
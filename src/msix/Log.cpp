@@ -4,12 +4,15 @@
 // 
 #include "Log.hpp"
 #include <sstream>
+#include <mutex>
 
 namespace MSIX { namespace Global { namespace Log {
+// Errors can be raised on the factory's threads, so the log is shared between them.
+static std::mutex g_lock;
 static std::stringstream g_content;
 
-void Append(const std::string& comment) { ((!comment.empty()) ? g_content << '\n' : g_content) << comment; }
-std::string Text() { return g_content.str(); }
-void Clear() { g_content.clear(); }
+void Append(const std::string& comment) { std::lock_guard<std::mutex> lock(g_lock); ((!comment.empty()) ? g_content << '\n' : g_content) << comment; }
+std::string Text() { std::lock_guard<std::mutex> lock(g_lock); return g_content.str(); }
+void Clear() { std::lock_guard<std::mutex> lock(g_lock); g_content.clear(); }
 
 } /* log */ } /* Global */ } /* msix */
\ No newline at end of file
@@ -52,12 +52,14 @@ namespace MSIX {
         std::string path = name.substr(0, lastSlash);
         mkdirp(path);
         auto result = ComPtr<IStream>::Make<FileStream>(std::move(name), mode);
+        std::lock_guard<std::mutex> lock(m_lock);
         m_streams[fileName] = result.Get(); // now cache the result in m_streams.
         return result;
     }
     
     void DirectoryObject::CommitChanges()
     {
+        std::lock_guard<std::mutex> lock(m_lock);
         m_streams.clear();
     }
 }
@@ -171,12 +171,14 @@ namespace MSIX {
         }
         name = path + GetPathSeparator() + name;
         auto result = ComPtr<IStream>::Make<FileStream>(std::move(name), mode);
+        std::lock_guard<std::mutex> lock(m_lock);
         m_streams[fileName] = result.Get(); // now cache the result in m_streams.
         return result;
     }
 
     void DirectoryObject::CommitChanges()
     {
+        std::lock_guard<std::mutex> lock(m_lock);
         m_streams.clear();
     }
 }
@@ -0,0 +1,28 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#include "Exceptions.hpp"
+#include "Inflater.hpp"
+
+#include <memory>
+
+namespace MSIX {
+
+    // Blocks go through the streaming Inflater. Each thread keeps one around, so a block only costs a Reset.
+    bool BlockInflater::Inflate(const std::uint8_t* input, std::size_t inputSize, std::uint8_t* output, std::size_t outputSize)
+    {
+        thread_local std::unique_ptr<Inflater> inflater;
+        if (inflater) { inflater->Reset(); }
+        else          { inflater = std::make_unique<Inflater>(); }
+
+        Inflater::Result result = Inflater::Result::Partial;
+        while ((result == Inflater::Result::Partial) && (inputSize != 0))
+        {
+            std::size_t remaining = inputSize + outputSize;
+            result = inflater->Inflate(input, inputSize, output, outputSize);
+            if ((inputSize + outputSize) == remaining) { break; }
+        }
+        return (result != Inflater::Result::Corrupt) && (inputSize == 0) && (outputSize == 0);
+    }
+} // namespace MSIX {
@@ -0,0 +1,56 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#include "Exceptions.hpp"
+#include "Inflater.hpp"
+
+#include "libdeflate.h"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace MSIX {
+
+    struct DecompressorDeleter
+    {
+        void operator()(libdeflate_decompressor* decompressor) const { libdeflate_free_decompressor(decompressor); }
+    };
+
+    bool BlockInflater::Inflate(const std::uint8_t* input, std::size_t inputSize, std::uint8_t* output, std::size_t outputSize)
+    {
+        thread_local std::unique_ptr<libdeflate_decompressor, DecompressorDeleter> decompressor;
+        if (!decompressor)
+        {
+            decompressor.reset(libdeflate_alloc_decompressor());
+            ThrowErrorIf(Error::OutOfMemory, (decompressor == nullptr), "libdeflate_alloc_decompressor failed");
+        }
+
+        // libdeflate only decodes whole deflate streams, which end with a block marked as the final one, and rejects
+        // any input that doesn't have one. A block that was flushed with Z_FULL_FLUSH ends with an empty stored block,
+        // 00 00 ff ff once byte aligned, and no final block. Those are decoded from a copy followed by an empty final
+        // block (a fixed Huffman block with nothing but its end code), which has to consume all of the copy's input.
+        static const std::uint8_t SyncFlushMarker[] = { 0x00, 0x00, 0xff, 0xff };
+        bool syncFlushed = (inputSize > sizeof(SyncFlushMarker)) &&
+            (std::memcmp(input + inputSize - sizeof(SyncFlushMarker), SyncFlushMarker, sizeof(SyncFlushMarker)) == 0);
+        std::size_t consumed = 0;
+        std::size_t produced = 0;
+        if (syncFlushed)
+        {
+            thread_local std::vector<std::uint8_t> terminated;
+            terminated.assign(input, input + inputSize);
+            terminated.push_back(0x03);
+            terminated.push_back(0x00);
+            libdeflate_result result = libdeflate_deflate_decompress_ex(decompressor.get(), terminated.data(), terminated.size(),
+                output, outputSize, &consumed, &produced);
+            return (result == LIBDEFLATE_SUCCESS) && (consumed >= inputSize) && (produced == outputSize);
+        }
+
+        // Any other block is decoded where it is. It has to end the stream itself, which the last block of a file
+        // does; anything after that, such as the two bytes that end a stream of full flushed blocks, is left unread.
+        libdeflate_result result = libdeflate_deflate_decompress_ex(decompressor.get(), input, inputSize,
+            output, outputSize, &consumed, &produced);
+        return (result == LIBDEFLATE_SUCCESS) && (consumed <= inputSize) && (produced == outputSize);
+    }
+} // namespace MSIX {
@@ -0,0 +1,68 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#define NOMINMAX /* windows.h, or more correctly windef.h, defines min as a macro... */
+#include "Exceptions.hpp"
+#include "Inflater.hpp"
+
+// zlib-ng's native API, whose zng_ prefixed names don't clash with the zlib the rest of the build links with.
+#include "zlib-ng.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace MSIX {
+
+    struct Inflater::Context
+    {
+        Context()
+        {
+            stream = { 0 };
+            ThrowErrorIfNot(Error::InflateInitialize, (zng_inflateInit2(&stream, -MAX_WBITS) == Z_OK), "zng_inflateInit2 failed");
+        }
+
+        ~Context() { zng_inflateEnd(&stream); }
+
+        zng_stream stream;
+    };
+
+    Inflater::Inflater() : m_context(std::make_unique<Context>()) {}
+
+    Inflater::~Inflater() {}
+
+    void Inflater::Reset()
+    {
+        ThrowErrorIfNot(Error::InflateInitialize, (zng_inflateReset(&m_context->stream) == Z_OK), "zng_inflateReset failed");
+    }
+
+    Inflater::Result Inflater::Inflate(const std::uint8_t*& input, std::size_t& inputSize, std::uint8_t*& output, std::size_t& outputSize)
+    {   // zlib-ng counts in uint32_t, so anything past that is left for the next call.
+        zng_stream& stream = m_context->stream;
+        std::uint32_t availableIn  = static_cast<std::uint32_t>(std::min(inputSize, static_cast<std::size_t>(std::numeric_limits<std::uint32_t>::max())));
+        std::uint32_t availableOut = static_cast<std::uint32_t>(std::min(outputSize, static_cast<std::size_t>(std::numeric_limits<std::uint32_t>::max())));
+        stream.next_in   = input;
+        stream.avail_in  = availableIn;
+        stream.next_out  = output;
+        stream.avail_out = availableOut;
+
+        int result = zng_inflate(&stream, Z_NO_FLUSH);
+
+        input      += availableIn - stream.avail_in;
+        inputSize  -= availableIn - stream.avail_in;
+        output     += availableOut - stream.avail_out;
+        outputSize -= availableOut - stream.avail_out;
+        switch (result)
+        {
+        case Z_OK:
+        case Z_BUF_ERROR:
+            return Result::Partial;
+        case Z_STREAM_END:
+            return Result::End;
+        case Z_MEM_ERROR:
+            ThrowError(Error::OutOfMemory);
+        default:
+            return Result::Corrupt;
+        }
+    }
+} // namespace MSIX {
@@ -0,0 +1,71 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#define NOMINMAX /* windows.h, or more correctly windef.h, defines min as a macro... */
+#include "Exceptions.hpp"
+#include "Inflater.hpp"
+
+#ifdef WIN32
+#include "zlib.h"
+#else
+#include <zlib.h>
+#endif
+
+#include <algorithm>
+#include <limits>
+
+namespace MSIX {
+
+    struct Inflater::Context
+    {
+        Context()
+        {
+            stream = { 0 };
+            ThrowErrorIfNot(Error::InflateInitialize, (inflateInit2(&stream, -MAX_WBITS) == Z_OK), "inflateInit2 failed");
+        }
+
+        ~Context() { inflateEnd(&stream); }
+
+        z_stream stream;
+    };
+
+    Inflater::Inflater() : m_context(std::make_unique<Context>()) {}
+
+    Inflater::~Inflater() {}
+
+    void Inflater::Reset()
+    {
+        ThrowErrorIfNot(Error::InflateInitialize, (inflateReset(&m_context->stream) == Z_OK), "inflateReset failed");
+    }
+
+    Inflater::Result Inflater::Inflate(const std::uint8_t*& input, std::size_t& inputSize, std::uint8_t*& output, std::size_t& outputSize)
+    {   // zlib counts in uInt, so anything past that is left for the next call.
+        z_stream& stream = m_context->stream;
+        uInt availableIn  = static_cast<uInt>(std::min(inputSize, static_cast<std::size_t>(std::numeric_limits<uInt>::max())));
+        uInt availableOut = static_cast<uInt>(std::min(outputSize, static_cast<std::size_t>(std::numeric_limits<uInt>::max())));
+        stream.next_in   = const_cast<Bytef*>(input);
+        stream.avail_in  = availableIn;
+        stream.next_out  = output;
+        stream.avail_out = availableOut;
+
+        int result = inflate(&stream, Z_NO_FLUSH);
+
+        input      += availableIn - stream.avail_in;
+        inputSize  -= availableIn - stream.avail_in;
+        output     += availableOut - stream.avail_out;
+        outputSize -= availableOut - stream.avail_out;
+        switch (result)
+        {
+        case Z_OK:
+        case Z_BUF_ERROR:
+            return Result::Partial;
+        case Z_STREAM_END:
+            return Result::End;
+        case Z_MEM_ERROR:
+            ThrowError(Error::OutOfMemory);
+        default:
+            return Result::Corrupt;
+        }
+    }
+} // namespace MSIX {
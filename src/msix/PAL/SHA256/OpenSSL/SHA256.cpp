@@ -5,16 +5,53 @@
 #include "Exceptions.hpp"
 #include "SHA256.hpp"
 
-#include "openssl/sha.h"
+#include <openssl/evp.h>
 
 namespace MSIX {
+
+    struct unique_EVP_MD_CTX_deleter {
+        void operator()(EVP_MD_CTX *ctx) const { if (ctx) EVP_MD_CTX_destroy(ctx); };
+    };
+
+    typedef std::unique_ptr<EVP_MD_CTX, unique_EVP_MD_CTX_deleter> unique_EVP_MD_CTX;
+
     bool SHA256::ComputeHash(
         /*in*/ std::uint8_t *buffer, 
         /*in*/ std::uint32_t cbBuffer, 
         /*inout*/ std::vector<uint8_t>& hash)
     {
-        hash.resize(SHA256_DIGEST_LENGTH);
-        ::SHA256(buffer, cbBuffer, hash.data());
+        unsigned int cbHash = 0;
+        hash.resize(EVP_MAX_MD_SIZE);
+        ThrowErrorIfNot(Error::Unexpected, EVP_Digest(buffer, cbBuffer, hash.data(), &cbHash, EVP_sha256(), nullptr), "EVP_Digest failed");
+        hash.resize(cbHash);
         return true;
     }
-} // namespace MSIX {
\ No newline at end of file
+
+    struct SHA256::Context
+    {
+        unique_EVP_MD_CTX ctx;
+    };
+
+    SHA256::SHA256() : m_context(std::make_unique<Context>())
+    {
+        m_context->ctx.reset(EVP_MD_CTX_create());
+        ThrowErrorIfNot(Error::OutOfMemory, m_context->ctx, "EVP_MD_CTX_create failed");
+        ThrowErrorIfNot(Error::Unexpected, EVP_DigestInit_ex(m_context->ctx.get(), EVP_sha256(), nullptr), "EVP_DigestInit_ex failed");
+    }
+
+    SHA256::~SHA256() {}
+
+    void SHA256::Update(const std::uint8_t* buffer, std::size_t cbBuffer)
+    {
+        ThrowErrorIfNot(Error::Unexpected, EVP_DigestUpdate(m_context->ctx.get(), buffer, cbBuffer), "EVP_DigestUpdate failed");
+    }
+
+    void SHA256::Finalize(std::vector<uint8_t>& hash)
+    {   // EVP_DigestFinal_ex leaves the context unusable, so start the next digest straight away.
+        unsigned int cbHash = 0;
+        hash.resize(EVP_MAX_MD_SIZE);
+        ThrowErrorIfNot(Error::Unexpected, EVP_DigestFinal_ex(m_context->ctx.get(), hash.data(), &cbHash), "EVP_DigestFinal_ex failed");
+        hash.resize(cbHash);
+        ThrowErrorIfNot(Error::Unexpected, EVP_DigestInit_ex(m_context->ctx.get(), EVP_sha256(), nullptr), "EVP_DigestInit_ex failed");
+    }
+} // namespace MSIX {
@@ -2,6 +2,7 @@
 //  Copyright (C) 2017 Microsoft.  All rights reserved.
 //  See LICENSE file in the project root for full license information.
 // 
+#define NOMINMAX /* windows.h, or more correctly windef.h, defines min as a macro... */
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
 #include <windows.h>
@@ -11,6 +12,8 @@
 #include "Exceptions.hpp"
 #include "SHA256.hpp"
 
+#include <algorithm>
+#include <limits>
 #include <memory>
 #include <vector>
 
@@ -44,65 +47,97 @@ namespace MSIX {
         }                                                                                  \
     }    
 
-    bool SHA256::ComputeHash(std::uint8_t* buffer, std::uint32_t cbBuffer, std::vector<uint8_t>& hash)
+    struct SHA256::Context
+    {
+        unique_alg_handle  algHandle;
+        unique_hash_handle hashHandle;
+        DWORD              hashLength = 0;
+
+        // Create a hash handle for the next digest
+        void CreateHash()
+        {
+            BCRYPT_HASH_HANDLE hashHandleT;
+            ThrowStatusIfFailed(BCryptCreateHash(
+                algHandle.get(),            // Handle to an algorithm provider                 
+                &hashHandleT,               // A pointer to a hash handle - can be a hash or hmac object
+                nullptr,                    // Pointer to the buffer that recieves the hash/hmac object
+                0,                          // Size of the buffer in bytes
+                nullptr,                    // A pointer to a key to use for the hash or MAC
+                0,                          // Size of the key in bytes
+                0),                         // Flags
+            "failed computing SHA256 hash");
+            hashHandle.reset(hashHandleT);
+        }
+    };
+
+    SHA256::SHA256() : m_context(std::make_unique<Context>())
     {
-        BCRYPT_HASH_HANDLE hashHandleT;
         BCRYPT_ALG_HANDLE algHandleT;
-        DWORD hashLength = 0;
         DWORD resultLength = 0;
 
         // Open an algorithm handle
-        // This code passes BCRYPT_HASH_REUSABLE_FLAG with BCryptAlgorithmProvider(...) to load a provider which supports reusable hash
         ThrowStatusIfFailed(BCryptOpenAlgorithmProvider(
             &algHandleT,                // Alg Handle pointer
             BCRYPT_SHA256_ALGORITHM,    // Cryptographic Algorithm name (null terminated unicode string)
             nullptr,                    // Provider name; if null, the default provider is loaded
-            0),                         // Flags; Loads a provider which supports reusable hash
+            0),                         // Flags
         "failed computing SHA256 hash");
 
         // Obtain the length of the hash
-        unique_alg_handle algHandle(algHandleT);        
+        m_context->algHandle.reset(algHandleT);
         ThrowStatusIfFailed(BCryptGetProperty(
-            algHandle.get(),            // Handle to a CNG object
+            m_context->algHandle.get(), // Handle to a CNG object
             BCRYPT_HASH_LENGTH,         // Property name (null terminated unicode string)
-            (PBYTE)&hashLength,         // Address of the output buffer which recieves the property value
-            sizeof(hashLength),         // Size of the buffer in bytes
+            (PBYTE)&m_context->hashLength, // Address of the output buffer which recieves the property value
+            sizeof(m_context->hashLength), // Size of the buffer in bytes
             &resultLength,              // Number of bytes that were copied into the buffer
             0),                         // Flags
         "failed computing SHA256 hash");
-        ThrowErrorIf(Error::Unexpected, (resultLength != sizeof(hashLength)), "failed computing SHA256 hash");
+        ThrowErrorIf(Error::Unexpected, (resultLength != sizeof(m_context->hashLength)), "failed computing SHA256 hash");
 
-        // Size the hash buffer appropriately
-        hash.resize(hashLength);
-
-        // Create a hash handle
-        ThrowStatusIfFailed(BCryptCreateHash(
-            algHandle.get(),            // Handle to an algorithm provider                 
-            &hashHandleT,               // A pointer to a hash handle - can be a hash or hmac object
-            nullptr,                    // Pointer to the buffer that recieves the hash/hmac object
-            0,                          // Size of the buffer in bytes
-            nullptr,                    // A pointer to a key to use for the hash or MAC
-            0,                          // Size of the key in bytes
-            0),                         // Flags
-        "failed computing SHA256 hash");
+        m_context->CreateHash();
+    }
 
-        // Hash the message(s)
-        unique_hash_handle hashHandle(hashHandleT);        
-        ThrowStatusIfFailed(BCryptHashData(
-            hashHandle.get(),           // Handle to the hash or MAC object
-            (PBYTE)buffer,              // A pointer to a buffer that contains the data to hash
-            cbBuffer,                   // Size of the buffer in bytes
-            0),                         // Flags
-        "failed computing SHA256 hash");
+    SHA256::~SHA256() {}
+
+    void SHA256::Update(const std::uint8_t* buffer, std::size_t cbBuffer)
+    {   // BCryptHashData takes a ULONG count, so larger buffers are hashed a piece at a time.
+        while (cbBuffer != 0)
+        {
+            ULONG count = static_cast<ULONG>(std::min(cbBuffer, static_cast<std::size_t>(std::numeric_limits<ULONG>::max())));
+            ThrowStatusIfFailed(BCryptHashData(
+                m_context->hashHandle.get(), // Handle to the hash or MAC object
+                (PBYTE)buffer,              // A pointer to a buffer that contains the data to hash
+                count,                      // Size of the buffer in bytes
+                0),                         // Flags
+            "failed computing SHA256 hash");
+            buffer += count;
+            cbBuffer -= count;
+        }
+    }
+
+    void SHA256::Finalize(std::vector<uint8_t>& hash)
+    {
+        // Size the hash buffer appropriately
+        hash.resize(m_context->hashLength);
 
         // Obtain the hash of the message(s) into the hash buffer
         ThrowStatusIfFailed(BCryptFinishHash(
-            hashHandle.get(),           // Handle to the hash or MAC object
+            m_context->hashHandle.get(), // Handle to the hash or MAC object
             hash.data(),                // A pointer to a buffer that receives the hash or MAC value
-            hashLength,                 // Size of the buffer in bytes
+            m_context->hashLength,      // Size of the buffer in bytes
             0),                         // Flags
         "failed computing SHA256 hash");
 
+        // A finished hash handle can't be used again, so create the one for the next digest.
+        m_context->CreateHash();
+    }
+
+    bool SHA256::ComputeHash(std::uint8_t* buffer, std::uint32_t cbBuffer, std::vector<uint8_t>& hash)
+    {
+        SHA256 hasher;
+        hasher.Update(buffer, cbBuffer);
+        hasher.Finalize(hash);
         return true;
     }
 }
@@ -0,0 +1,812 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+// A small XML parser with no dependencies, for reading the few attributes the package needs out of its footprint
+// files. Documents are checked to be well formed, but aren't validated against schemas, and DTDs aren't supported.
+// Attribute values are not copied out of the document buffer until someone asks for one.
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstring>
+
+#include "Exceptions.hpp"
+#include "StreamBase.hpp"
+#include "IXml.hpp"
+
+EXTERN_C const IID IID_ILiteXmlElement;
+
+#ifndef WIN32
+// {5b0e4a8d-1f6c-4d3b-9e27-8c4f2a61d0b3}
+interface ILiteXmlElement : public IUnknown
+#else
+#include "Unknwn.h"
+#include "Objidl.h"
+class ILiteXmlElement : public IUnknown
+#endif
+// An internal interface for XML document object model
+{
+public:
+    virtual std::size_t GetIndex() = 0;
+};
+
+SpecializeUuidOfImpl(ILiteXmlElement);
+
+namespace MSIX {
+
+// Part of the document buffer.
+struct XmlText
+{
+    XmlText() = default;
+    XmlText(const char* d, std::size_t s) : data(d), size(s) {}
+
+    bool Equals(const char* other, std::size_t otherSize) const { return (size == otherSize) && ((size == 0) || (std::memcmp(data, other, size) == 0)); }
+    bool operator==(const XmlText& other) const { return Equals(other.data, other.size); }
+    bool operator==(const std::string& other) const { return Equals(other.data(), other.size()); }
+
+    // The name without its namespace prefix.
+    XmlText LocalName() const
+    {
+        auto colon = static_cast<const char*>(std::memchr(data, ':', size));
+        return (colon == nullptr) ? *this : XmlText(colon + 1, size - (colon + 1 - data));
+    }
+
+    // The namespace prefix of the name, empty if it has none.
+    XmlText Prefix() const
+    {
+        auto colon = static_cast<const char*>(std::memchr(data, ':', size));
+        return (colon == nullptr) ? XmlText() : XmlText(data, colon - data);
+    }
+
+    const char*  data = nullptr;
+    std::size_t  size = 0;
+};
+
+struct XmlAttribute
+{
+    XmlText name;
+    XmlText value;  // as it is in the document, before references are replaced
+};
+
+// The namespaces the root elements of the footprint files can be in.
+static const std::vector<std::string> blockMapNamespaces = {
+    "http://schemas.microsoft.com/appx/2010/blockmap",
+    "http://schemas.microsoft.com/appx/2015/blockmap",
+    "http://schemas.microsoft.com/appx/2017/blockmap",
+};
+
+static const std::vector<std::string> manifestNamespaces = {
+    "http://schemas.microsoft.com/appx/2010/manifest",
+    "http://schemas.microsoft.com/appx/manifest/foundation/windows10",
+};
+
+// The element names of a query. Absolute ones start at the document's root element, which has to be in one of
+// 'namespaces', the others at the element they are asked about. The other elements are matched by local name.
+struct XmlPath
+{
+    bool                            absolute;
+    std::vector<std::string>        steps;
+    const std::vector<std::string>* namespaces;
+};
+
+static std::map<XmlQueryName, XmlPath> xPaths = {
+    {XmlQueryName::Package_Identity                             ,{true,  {"Package", "Identity"},           &manifestNamespaces}},
+    {XmlQueryName::BlockMap_File                                ,{true,  {"BlockMap", "File"},              &blockMapNamespaces}},
+    {XmlQueryName::BlockMap_File_Block                          ,{false, {"Block"},                         nullptr}},
+};
+
+// The absolute paths of the queries, for ForEachElementInStream.
+static std::map<XmlQueryName, XmlPath> elementPaths = {
+    {XmlQueryName::Package_Identity                             ,{true,  {"Package", "Identity"},           &manifestNamespaces}},
+    {XmlQueryName::BlockMap_File                                ,{true,  {"BlockMap", "File"},              &blockMapNamespaces}},
+    {XmlQueryName::BlockMap_File_Block                          ,{true,  {"BlockMap", "File", "Block"},     &blockMapNamespaces}},
+};
+
+static bool IsRootNamespace(const XmlPath& path, const std::string& uri)
+{
+    return (path.namespaces == nullptr) || (std::find(path.namespaces->begin(), path.namespaces->end(), uri) != path.namespaces->end());
+}
+
+static std::map<XmlAttributeName, std::string> attributeNames = {
+    {XmlAttributeName::Package_Identity_Name                    ,"Name"},
+    {XmlAttributeName::Package_Identity_ProcessorArchitecture   ,"ProcessorArchitecture"},
+    {XmlAttributeName::Package_Identity_Publisher               ,"Publisher"},
+    {XmlAttributeName::Package_Identity_Version                 ,"Version"},
+    {XmlAttributeName::Package_Identity_ResourceId              ,"ResourceId"},
+
+    {XmlAttributeName::BlockMap_File_Name                       ,"Name"},
+    {XmlAttributeName::BlockMap_File_LocalFileHeaderSize        ,"LfhSize"},
+    {XmlAttributeName::BlockMap_File_Block_Size                 ,"Size"},
+    {XmlAttributeName::BlockMap_File_Block_Hash                 ,"Hash"},
+};
+
+static bool IsSpace(char c) { return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n'); }
+
+static bool IsNameStart(char c)
+{
+    return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || (c == '_') || (c == ':') ||
+        (static_cast<unsigned char>(c) >= 0x80);
+}
+
+static bool IsNameChar(char c)
+{
+    return IsNameStart(c) || ((c >= '0') && (c <= '9')) || (c == '-') || (c == '.');
+}
+
+static void AppendUtf8(std::string* output, std::uint32_t codePoint)
+{
+    if (output == nullptr) { return; }
+    if (codePoint < 0x80)
+    {   output->push_back(static_cast<char>(codePoint));
+    }
+    else if (codePoint < 0x800)
+    {   output->push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+        output->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+    else if (codePoint < 0x10000)
+    {   output->push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+        output->push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        output->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+    else
+    {   output->push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+        output->push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+        output->push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        output->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+// Replaces the references in 'text' with what they stand for, and, for attribute values, whitespace with spaces.
+// Only checks them if 'output' is null.
+static void DecodeText(const XmlText& text, bool attribute, std::string* output)
+{
+    const char* end = text.data + text.size;
+    for (const char* c = text.data; c < end; c++)
+    {
+        if (*c == '&')
+        {
+            auto semicolon = static_cast<const char*>(std::memchr(c, ';', end - c));
+            ThrowErrorIf(Error::XmlFatal, (semicolon == nullptr), "Unterminated reference");
+            XmlText name(c + 1, semicolon - (c + 1));
+            if      (name.Equals("lt",   2)) { AppendUtf8(output, '<'); }
+            else if (name.Equals("gt",   2)) { AppendUtf8(output, '>'); }
+            else if (name.Equals("amp",  3)) { AppendUtf8(output, '&'); }
+            else if (name.Equals("quot", 4)) { AppendUtf8(output, '"'); }
+            else if (name.Equals("apos", 4)) { AppendUtf8(output, '\''); }
+            else
+            {   // &#decimal; or &#xhex;
+                ThrowErrorIf(Error::XmlFatal, ((name.size < 2) || (name.data[0] != '#')), "Undefined entity reference");
+                bool hex = (name.data[1] == 'x');
+                const char* digit = name.data + (hex ? 2 : 1);
+                ThrowErrorIf(Error::XmlFatal, (digit == semicolon), "Empty character reference");
+                std::uint32_t codePoint = 0;
+                for (; digit < semicolon; digit++)
+                {
+                    std::uint32_t value;
+                    if      ((*digit >= '0') && (*digit <= '9'))         { value = *digit - '0'; }
+                    else if (hex && (*digit >= 'a') && (*digit <= 'f'))  { value = *digit - 'a' + 10; }
+                    else if (hex && (*digit >= 'A') && (*digit <= 'F'))  { value = *digit - 'A' + 10; }
+                    else { ThrowError(Error::XmlFatal); }
+                    codePoint = (codePoint * (hex ? 16 : 10)) + value;
+                    ThrowErrorIf(Error::XmlFatal, (codePoint > 0x10FFFF), "Character reference out of range");
+                }
+                ThrowErrorIf(Error::XmlFatal, ((codePoint == 0) || ((codePoint >= 0xD800) && (codePoint <= 0xDFFF))),
+                    "Character reference to an invalid character");
+                AppendUtf8(output, codePoint);
+            }
+            c = semicolon;
+        }
+        else if (attribute && IsSpace(*c))
+        {   // A line break, \r\n included, is a single space.
+            if ((*c == '\r') && (c + 1 < end) && (c[1] == '\n')) { c++; }
+            if (output) { output->push_back(' '); }
+        }
+        else if (output)
+        {   output->push_back(*c);
+        }
+    }
+}
+
+static std::string DecodeAttribute(const XmlAttribute* attribute)
+{
+    std::string result;
+    if (attribute != nullptr) { DecodeText(attribute->value, true, &result); }
+    return result;
+}
+
+// Returns nothing if 'text' isn't valid base64, as for an attribute that isn't there.
+static std::vector<std::uint8_t> DecodeBase64(const std::string& text)
+{
+    std::vector<std::uint8_t> result;
+    result.reserve((text.size() / 4) * 3);
+    std::uint32_t bits = 0;
+    std::size_t count = 0;
+    std::size_t padding = 0;
+    for (char c : text)
+    {
+        std::uint32_t value;
+        if      ((c >= 'A') && (c <= 'Z')) { value = c - 'A'; }
+        else if ((c >= 'a') && (c <= 'z')) { value = c - 'a' + 26; }
+        else if ((c >= '0') && (c <= '9')) { value = c - '0' + 52; }
+        else if (c == '+') { value = 62; }
+        else if (c == '/') { value = 63; }
+        else if (c == ' ') { continue; }
+        else if ((c == '=') && (count % 4 >= 2) && (padding < 2)) { padding++; value = 0; }
+        else { return std::vector<std::uint8_t>(); }
+        if ((padding > 0) && (c != '=')) { return std::vector<std::uint8_t>(); }
+
+        bits = (bits << 6) | value;
+        if (++count % 4 == 0)
+        {
+            result.push_back(static_cast<std::uint8_t>(bits >> 16));
+            if (padding < 2) { result.push_back(static_cast<std::uint8_t>(bits >> 8)); }
+            if (padding < 1) { result.push_back(static_cast<std::uint8_t>(bits)); }
+            bits = 0;
+        }
+    }
+    if (count % 4 != 0) { return std::vector<std::uint8_t>(); }
+    return result;
+}
+
+// Reads a document from a stream a piece at a time, as UTF-8. Documents in UTF-16, which have to start with a byte
+// order mark, are converted as they are read.
+class XmlSource
+{
+public:
+    XmlSource(const ComPtr<IStream>& stream) : m_stream(stream)
+    {
+        LARGE_INTEGER start = { 0 };
+        ThrowHrIfFailed(m_stream->Seek(start, StreamBase::Reference::START, nullptr));
+    }
+
+    // Reads up to 'size' more bytes of the stream, and appends what they hold of the document to 'document'.
+    // Returns false once the end of the stream has been reached, and the stream is back at its start.
+    bool Read(std::vector<char>& document, std::size_t size)
+    {
+        if (m_ended) { return false; }
+        std::size_t pending = m_raw.size();
+        m_raw.resize(pending + size);
+        ULONG read = 0;
+        ThrowHrIfFailed(m_stream->Read(m_raw.data() + pending, static_cast<ULONG>(size), &read));
+        m_raw.resize(pending + read);
+        m_ended = (read == 0);
+
+        std::size_t used = 0;
+        if (!m_started)
+        {   // wait for enough of the document to tell the byte order mark apart
+            if ((m_raw.size() < 3) && !m_ended) { return true; }
+            m_started = true;
+            if ((m_raw.size() >= 2) && (((m_raw[0] == 0xFF) && (m_raw[1] == 0xFE)) || ((m_raw[0] == 0xFE) && (m_raw[1] == 0xFF))))
+            {   m_utf16 = true;
+                m_bigEndian = (m_raw[0] == 0xFE);
+                used = 2;
+            }
+            else if ((m_raw.size() >= 3) && (m_raw[0] == 0xEF) && (m_raw[1] == 0xBB) && (m_raw[2] == 0xBF))
+            {   used = 3;
+            }
+        }
+
+        if (m_utf16)
+        {
+            std::string utf8;
+            utf8.reserve((m_raw.size() - used) / 2);
+            while (used + 1 < m_raw.size())
+            {
+                std::uint32_t unit = Unit(used);
+                std::size_t units = 1;
+                if ((unit >= 0xD800) && (unit <= 0xDBFF))
+                {
+                    if (used + 3 < m_raw.size())
+                    {   std::uint32_t low = Unit(used + 2);
+                        ThrowErrorIf(Error::XmlFatal, ((low < 0xDC00) || (low > 0xDFFF)), "Invalid UTF-16 surrogate pair");
+                        unit = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+                        units = 2;
+                    }
+                    else if (!m_ended)
+                    {   break; // the low surrogate is in the next piece
+                    }
+                }
+                ThrowErrorIf(Error::XmlFatal, ((unit >= 0xD800) && (unit <= 0xDFFF)), "Invalid UTF-16 surrogate");
+                AppendUtf8(&utf8, unit);
+                used += 2 * units;
+            }
+            document.insert(document.end(), utf8.begin(), utf8.end());
+        }
+        else
+        {   document.insert(document.end(), m_raw.begin() + used, m_raw.end());
+            used = m_raw.size();
+        }
+        m_raw.erase(m_raw.begin(), m_raw.begin() + used);
+
+        if (m_ended)
+        {   // move the underlying stream back to the beginning, as a whole read of it would.
+            LARGE_INTEGER start = { 0 };
+            ThrowHrIfFailed(m_stream->Seek(start, StreamBase::Reference::START, nullptr));
+        }
+        return !m_ended;
+    }
+
+protected:
+    std::uint32_t Unit(std::size_t offset)
+    {
+        return m_bigEndian ? ((m_raw[offset] << 8) | m_raw[offset + 1]) : ((m_raw[offset + 1] << 8) | m_raw[offset]);
+    }
+
+    ComPtr<IStream>             m_stream;
+    std::vector<std::uint8_t>   m_raw;          // read, but not yet appended to the document
+    bool                        m_started = false;
+    bool                        m_ended = false;
+    bool                        m_utf16 = false;
+    bool                        m_bigEndian = false;
+};
+
+// Reads the whole stream, as UTF-8.
+static std::vector<char> ReadDocument(const ComPtr<IStream>& stream)
+{
+    XmlSource source(stream);
+    std::vector<char> document;
+    while (source.Read(document, DEFAULT_IO_SIZE)) {}
+    return document;
+}
+
+static const std::size_t NoNamespace = static_cast<std::size_t>(-1);
+
+// Pulls the start and end tags out of a document one at a time, checking that it is well formed as it goes.
+// Everything else (the declaration, comments, processing instructions, text) is checked and skipped. The document
+// is either all in memory, or read from a source as it is parsed, keeping no more of it than the piece being parsed.
+class XmlReader
+{
+public:
+    XmlReader(const char* begin, const char* end) : m_position(begin), m_end(end) {}
+    XmlReader(XmlSource& source) : m_source(&source), m_position(nullptr), m_end(nullptr) {}
+
+    // Moves to the next start or end tag. An empty element has both. Returns false at the end of the document.
+    bool Read()
+    {
+        if (m_closing)
+        {   m_path.pop_back();
+            m_pathNamespaces.pop_back();
+            m_namespaces.resize(m_namespaces.size() - m_namespaceCounts.back());
+            m_namespaceCounts.pop_back();
+            m_closing = false;
+        }
+        if (m_emptyElement)
+        {   m_emptyElement = false;
+            m_closing = true;
+            m_isStart = false;
+            return true;
+        }
+
+        while (true)
+        {
+            Fill();
+            if (m_position == m_end)
+            {   ThrowErrorIf(Error::XmlFatal, (!m_hasRoot || !m_path.empty()), "Unexpected end of XML document");
+                return false;
+            }
+
+            if (*m_position != '<')
+            {
+                auto next = static_cast<const char*>(std::memchr(m_position, '<', m_end - m_position));
+                XmlText text(m_position, (next ? next : m_end) - m_position);
+                if (m_path.empty())
+                {   for (std::size_t i = 0; i < text.size; i++)
+                    {   ThrowErrorIf(Error::XmlFatal, !IsSpace(text.data[i]), "Text outside of the root element");
+                    }
+                }
+                else
+                {   DecodeText(text, false, nullptr);
+                }
+                m_position += text.size;
+            }
+            else if (StartsWith("<!--"))
+            {   Skip(4, "-->");
+            }
+            else if (StartsWith("<![CDATA["))
+            {   ThrowErrorIf(Error::XmlFatal, m_path.empty(), "CDATA outside of the root element");
+                Skip(9, "]]>");
+            }
+            else if (StartsWith("<!"))
+            {   ThrowErrorIf(Error::XmlFatal, true, "DTDs are not supported");
+            }
+            else if (StartsWith("<?"))
+            {   Skip(2, "?>");
+            }
+            else if (StartsWith("</"))
+            {
+                m_position += 2;
+                m_name = ReadName();
+                SkipSpace();
+                Expect('>');
+                ThrowErrorIf(Error::XmlFatal, (m_path.empty() || !(m_name == m_path.back())), "End tag does not match start tag");
+                m_closing = true;
+                m_isStart = false;
+                return true;
+            }
+            else
+            {
+                ThrowErrorIf(Error::XmlFatal, (m_hasRoot && m_path.empty()), "More than one root element");
+                m_position++;
+                m_name = ReadName();
+                ReadAttributes();
+                m_path.emplace_back(m_name.data, m_name.size);
+                DeclareNamespaces();
+                m_hasRoot = true;
+                m_isStart = true;
+                return true;
+            }
+        }
+    }
+
+    bool IsStart() { return m_isStart; }
+
+    // The name of the current tag, valid until the next Read.
+    const XmlText& Name() { return m_name; }
+
+    // The names of the open elements, the current one last.
+    const std::vector<std::string>& Path() { return m_path; }
+
+    // The namespace URI of the open element at 'depth', empty if it isn't in one.
+    const std::string& NamespaceUri(std::size_t depth)
+    {
+        static const std::string none;
+        std::size_t index = m_pathNamespaces[depth];
+        return (index == NoNamespace) ? none : m_namespaces[index].uri;
+    }
+
+    // The attributes of the current start tag, valid until the next Read.
+    const std::vector<XmlAttribute>& Attributes() { return m_attributes; }
+
+protected:
+    struct XmlNamespace
+    {
+        std::string prefix;
+        std::string uri;
+    };
+
+    // When reading from a source, makes sure the buffer holds the whole of the next token, so that nothing parsed
+    // out of it moves while it is in use. What has been parsed already is dropped first, and at least as much again
+    // as is left is read, so that a long token isn't scanned over and over.
+    void Fill()
+    {
+        while ((m_source != nullptr) && !HasWholeToken())
+        {
+            std::size_t parsed = m_buffer.empty() ? 0 : (m_position - m_buffer.data());
+            m_buffer.erase(m_buffer.begin(), m_buffer.begin() + parsed);
+            bool more = m_source->Read(m_buffer, std::max(static_cast<std::size_t>(DEFAULT_IO_SIZE), m_buffer.size()));
+            m_position = m_buffer.data();
+            m_end = m_buffer.data() + m_buffer.size();
+            if (!more) { m_source = nullptr; }
+        }
+    }
+
+    // Whether the buffer holds the next token up to its end: text up to the next tag, or a comment, CDATA section,
+    // processing instruction or tag up to its terminator.
+    bool HasWholeToken()
+    {
+        if (m_position == m_end) { return false; }
+        std::size_t size = m_end - m_position;
+        if (*m_position != '<') { return std::memchr(m_position, '<', size) != nullptr; }
+        if (size < 9) { return false; } // not yet enough to tell a CDATA section apart
+        if (StartsWith("<!--")) { return Find(4, "-->"); }
+        if (StartsWith("<![CDATA[")) { return Find(9, "]]>"); }
+        if (StartsWith("<?")) { return Find(2, "?>"); }
+
+        // a tag, which ends at the first '>' that isn't in an attribute value
+        char quote = 0;
+        for (const char* c = m_position + 1; c < m_end; c++)
+        {
+            if (quote != 0) { if (*c == quote) { quote = 0; } }
+            else if ((*c == '"') || (*c == '\'')) { quote = *c; }
+            else if (*c == '>') { return true; }
+        }
+        return false;
+    }
+
+    bool Find(std::size_t skip, const char* terminator)
+    {
+        std::size_t size = std::strlen(terminator);
+        for (const char* c = m_position + skip; static_cast<std::size_t>(m_end - c) >= size; c++)
+        {   if (std::memcmp(c, terminator, size) == 0) { return true; }
+        }
+        return false;
+    }
+
+    // Adds the namespaces the current start tag declares, and resolves the namespace of its element.
+    void DeclareNamespaces()
+    {
+        std::size_t declared = 0;
+        for (const auto& attribute : m_attributes)
+        {
+            XmlNamespace declaration;
+            if (attribute.name.Prefix().Equals("xmlns", 5))
+            {   XmlText prefix = attribute.name.LocalName();
+                declaration.prefix.assign(prefix.data, prefix.size);
+            }
+            else if (!attribute.name.Equals("xmlns", 5))
+            {   continue;
+            }
+            DecodeText(attribute.value, true, &declaration.uri);
+            m_namespaces.push_back(declaration);
+            declared++;
+        }
+        m_namespaceCounts.push_back(declared);
+
+        XmlText prefix = m_name.Prefix();
+        std::size_t index = m_namespaces.size();
+        while ((index > 0) && !(prefix == m_namespaces[index - 1].prefix)) { index--; }
+        ThrowErrorIf(Error::XmlFatal, ((index == 0) && (prefix.size != 0) && !prefix.Equals("xml", 3)), "Undeclared namespace prefix");
+        m_pathNamespaces.push_back((index == 0) ? NoNamespace : (index - 1));
+    }
+
+    bool StartsWith(const char* text)
+    {
+        std::size_t size = std::strlen(text);
+        return (static_cast<std::size_t>(m_end - m_position) >= size) && (std::memcmp(m_position, text, size) == 0);
+    }
+
+    // Moves past 'skip' characters, and then past 'terminator'.
+    void Skip(std::size_t skip, const char* terminator)
+    {
+        std::size_t size = std::strlen(terminator);
+        for (m_position += skip; static_cast<std::size_t>(m_end - m_position) >= size; m_position++)
+        {   if (std::memcmp(m_position, terminator, size) == 0)
+            {   m_position += size;
+                return;
+            }
+        }
+        ThrowErrorIf(Error::XmlFatal, true, "Unexpected end of XML document");
+    }
+
+    bool SkipSpace()
+    {
+        const char* start = m_position;
+        while ((m_position < m_end) && IsSpace(*m_position)) { m_position++; }
+        return m_position != start;
+    }
+
+    void Expect(char c)
+    {
+        ThrowErrorIf(Error::XmlFatal, ((m_position == m_end) || (*m_position != c)), "Malformed XML tag");
+        m_position++;
+    }
+
+    XmlText ReadName()
+    {
+        const char* start = m_position;
+        ThrowErrorIf(Error::XmlFatal, ((m_position == m_end) || !IsNameStart(*m_position)), "Malformed XML name");
+        while ((m_position < m_end) && IsNameChar(*m_position)) { m_position++; }
+        return XmlText(start, m_position - start);
+    }
+
+    void ReadAttributes()
+    {
+        m_attributes.clear();
+        while (true)
+        {
+            bool separated = SkipSpace();
+            ThrowErrorIf(Error::XmlFatal, (m_position == m_end), "Unexpected end of XML document");
+            if (*m_position == '>')
+            {   m_position++;
+                return;
+            }
+            if (*m_position == '/')
+            {   m_position++;
+                Expect('>');
+                m_emptyElement = true;
+                return;
+            }
+            ThrowErrorIf(Error::XmlFatal, !separated, "Attributes must be separated by whitespace");
+
+            XmlAttribute attribute;
+            attribute.name = ReadName();
+            SkipSpace();
+            Expect('=');
+            SkipSpace();
+            ThrowErrorIf(Error::XmlFatal, ((m_position == m_end) || ((*m_position != '"') && (*m_position != '\''))), "Attribute value must be quoted");
+            char quote = *m_position++;
+            auto close = static_cast<const char*>(std::memchr(m_position, quote, m_end - m_position));
+            ThrowErrorIf(Error::XmlFatal, (close == nullptr), "Unexpected end of XML document");
+            attribute.value = XmlText(m_position, close - m_position);
+            ThrowErrorIf(Error::XmlFatal, (std::memchr(attribute.value.data, '<', attribute.value.size) != nullptr), "'<' in attribute value");
+            DecodeText(attribute.value, true, nullptr);
+            m_position = close + 1;
+
+            for (const auto& other : m_attributes)
+            {   ThrowErrorIf(Error::XmlFatal, (other.name == attribute.name), "Duplicate attribute");
+            }
+            m_attributes.push_back(attribute);
+        }
+    }
+
+    XmlSource*                  m_source = nullptr;
+    std::vector<char>           m_buffer;           // the part of the document read from the source but not parsed
+    const char*                 m_position;
+    const char*                 m_end;
+    XmlText                     m_name;
+    std::vector<std::string>    m_path;
+    std::vector<std::size_t>    m_pathNamespaces;   // indexes into m_namespaces, of the open elements' namespaces
+    std::vector<XmlNamespace>   m_namespaces;       // the declarations in scope, innermost last
+    std::vector<std::size_t>    m_namespaceCounts;  // how many of them each open element declared
+    std::vector<XmlAttribute>   m_attributes;
+    bool                        m_hasRoot = false;
+    bool                        m_isStart = false;
+    bool                        m_emptyElement = false;
+    bool                        m_closing = false;
+};
+
+static const XmlAttribute* FindAttribute(const XmlAttribute* attributes, std::size_t count, XmlAttributeName attribute)
+{
+    const auto& name = attributeNames[attribute];
+    for (std::size_t i = 0; i < count; i++)
+    {   if (attributes[i].name == name) { return &attributes[i]; }
+    }
+    return nullptr;
+}
+
+class LiteXmlElement final : public ComClass<LiteXmlElement, IXmlElement, ILiteXmlElement>
+{
+public:
+    LiteXmlElement(const XmlAttribute* attributes, std::size_t count, std::size_t index) :
+        m_attributes(attributes), m_count(count), m_index(index)
+    {}
+
+    void SetAttributes(const XmlAttribute* attributes, std::size_t count)
+    {
+        m_attributes = attributes;
+        m_count = count;
+    }
+
+    // IXmlElement
+    std::string GetAttributeValue(XmlAttributeName attribute) override
+    {
+        return DecodeAttribute(FindAttribute(m_attributes, m_count, attribute));
+    }
+
+    std::vector<std::uint8_t> GetBase64DecodedAttributeValue(XmlAttributeName attribute) override
+    {
+        return DecodeBase64(GetAttributeValue(attribute));
+    }
+
+    // ILiteXmlElement
+    std::size_t GetIndex() override { return m_index; }
+
+protected:
+    const XmlAttribute* m_attributes;
+    std::size_t         m_count;
+    std::size_t         m_index;
+};
+
+class LiteXmlDom final : public ComClass<LiteXmlDom, IXmlDom>
+{
+public:
+    LiteXmlDom(const ComPtr<IStream>& stream) : m_stream(stream), m_document(ReadDocument(stream))
+    {   // Elements are kept in document order, so an element's descendants are the ones up to its 'end'.
+        XmlReader reader(m_document.data(), m_document.data() + m_document.size());
+        std::vector<std::size_t> open;
+        while (reader.Read())
+        {
+            if (reader.IsStart())
+            {
+                if (reader.Path().size() == 1) { m_rootNamespace = reader.NamespaceUri(0); }
+                Element element;
+                element.name = reader.Name().LocalName();
+                element.firstAttribute = m_attributes.size();
+                element.countAttributes = reader.Attributes().size();
+                m_attributes.insert(m_attributes.end(), reader.Attributes().begin(), reader.Attributes().end());
+                open.push_back(m_elements.size());
+                m_elements.push_back(element);
+            }
+            else
+            {   m_elements[open.back()].end = m_elements.size();
+                open.pop_back();
+            }
+        }
+    }
+
+    // IXmlDom
+    MSIX::ComPtr<IXmlElement> GetDocument() override { return MakeElement(0); }
+
+    bool ForEachElementIn(const ComPtr<IXmlElement>& root, XmlQueryName query, XmlVisitor& visitor) override
+    {
+        ComPtr<ILiteXmlElement> element;
+        ThrowHrIfFailed(root->QueryInterface(UuidOfImpl<ILiteXmlElement>::iid, reinterpret_cast<void**>(&element)));
+
+        const auto& path = xPaths[query];
+        if (path.absolute)
+        {   return !(m_elements[0].name == path.steps[0]) || !IsRootNamespace(path, m_rootNamespace) || VisitChildren(0, path, 1, visitor);
+        }
+        return VisitChildren(element->GetIndex(), path, 0, visitor);
+    }
+
+protected:
+    struct Element
+    {
+        XmlText     name;
+        std::size_t firstAttribute;
+        std::size_t countAttributes;
+        std::size_t end;            // index after its last descendant
+    };
+
+    ComPtr<IXmlElement> MakeElement(std::size_t index)
+    {
+        const auto& element = m_elements[index];
+        return ComPtr<IXmlElement>::Make<LiteXmlElement>(m_attributes.data() + element.firstAttribute, element.countAttributes, index);
+    }
+
+    bool VisitChildren(std::size_t parent, const XmlPath& path, std::size_t step, XmlVisitor& visitor)
+    {
+        for (std::size_t child = parent + 1; child < m_elements[parent].end; child = m_elements[child].end)
+        {
+            if (!(m_elements[child].name == path.steps[step])) { continue; }
+            if (step + 1 < path.steps.size())
+            {   if (!VisitChildren(child, path, step + 1, visitor)) { return false; }
+            }
+            else if (!visitor.Callback(visitor.context, MakeElement(child)))
+            {   return false;
+            }
+        }
+        return true;
+    }
+
+    ComPtr<IStream>             m_stream;
+    std::vector<char>           m_document;
+    std::vector<Element>        m_elements;
+    std::vector<XmlAttribute>   m_attributes;
+    std::string                 m_rootNamespace;
+};
+
+class LiteXmlFactory final : public ComClass<LiteXmlFactory, IXmlFactory>
+{
+public:
+    LiteXmlFactory(IMSIXFactory* factory) : m_factory(factory) {}
+
+    ComPtr<IXmlDom> CreateDomFromStream(XmlContentType footPrintType, const ComPtr<IStream>& stream) override
+    {
+        switch (footPrintType)
+        {
+            case XmlContentType::AppxBlockMapXml:
+            case XmlContentType::AppxManifestXml:
+            case XmlContentType::ContentTypeXml:
+                return ComPtr<IXmlDom>::Make<LiteXmlDom>(stream);
+        }
+        ThrowError(Error::InvalidParameter);
+    }
+
+    // The document is parsed as it is read, so the visitor sees elements before the rest of the stream has been read,
+    // and before a stream that validates what it reads has checked it. Whatever it builds from them has to be thrown
+    // away if this throws.
+    bool ForEachElementInStream(XmlContentType footPrintType, const ComPtr<IStream>& stream, XmlElementVisitor& visitor) override
+    {
+        XmlSource source(stream);
+        XmlReader reader(source);
+        auto element = ComPtr<LiteXmlElement>::Make<LiteXmlElement>(nullptr, 0, 0);
+        auto item = element.As<IXmlElement>();
+        while (reader.Read())
+        {
+            if (!reader.IsStart()) { continue; }
+            const auto& open = reader.Path();
+            for (const auto& query : elementPaths)
+            {
+                const auto& steps = query.second.steps;
+                if (steps.size() != open.size()) { continue; }
+                bool matches = true;
+                for (std::size_t i = 0; matches && (i < steps.size()); i++) { matches = (XmlText(open[i].data(), open[i].size()).LocalName() == steps[i]); }
+                if (!matches || !IsRootNamespace(query.second, reader.NamespaceUri(0))) { continue; }
+
+                element->SetAttributes(reader.Attributes().data(), reader.Attributes().size());
+                if (!visitor.Callback(visitor.context, query.first, item)) { return false; }
+            }
+        }
+        return true;
+    }
+
+protected:
+    IMSIXFactory* m_factory;
+};
+
+ComPtr<IXmlFactory> CreateXmlFactory(IMSIXFactory* factory) { return ComPtr<IXmlFactory>::Make<LiteXmlFactory>(factory); }
+
+} // namespace MSIX
@@ -566,6 +566,44 @@ public:
             HasIgnorableNamespaces);
     }
 
+    bool ForEachElementInStream(XmlContentType footPrintType, const ComPtr<IStream>& stream, XmlElementVisitor& visitor) override
+    {   // MSXML6 only parses whole documents, so this walks the DOM instead, in the same order a reader would see it.
+        auto dom = CreateDomFromStream(footPrintType, stream);
+        struct _context
+        {
+            IXmlDom*            dom;
+            XmlElementVisitor*  visitor;
+        };
+        _context context = { dom.Get(), &visitor };
+
+        switch (footPrintType)
+        {
+            case XmlContentType::AppxBlockMapXml:
+            {   XmlVisitor fileVisitor(static_cast<void*>(&context), [](void* c, const ComPtr<IXmlElement>& fileNode)->bool
+                {
+                    _context* context = reinterpret_cast<_context*>(c);
+                    if (!context->visitor->Callback(context->visitor->context, XmlQueryName::BlockMap_File, fileNode)) { return false; }
+                    XmlVisitor blockVisitor(static_cast<void*>(context->visitor), [](void* v, const ComPtr<IXmlElement>& blockNode)->bool
+                    {
+                        XmlElementVisitor* visitor = reinterpret_cast<XmlElementVisitor*>(v);
+                        return visitor->Callback(visitor->context, XmlQueryName::BlockMap_File_Block, blockNode);
+                    });
+                    return context->dom->ForEachElementIn(fileNode, XmlQueryName::BlockMap_File_Block, blockVisitor);
+                });
+                return dom->ForEachElementIn(dom->GetDocument(), XmlQueryName::BlockMap_File, fileVisitor);
+            }
+            case XmlContentType::AppxManifestXml:
+            {   XmlVisitor identityVisitor(static_cast<void*>(&visitor), [](void* v, const ComPtr<IXmlElement>& identityNode)->bool
+                {
+                    XmlElementVisitor* visitor = reinterpret_cast<XmlElementVisitor*>(v);
+                    return visitor->Callback(visitor->context, XmlQueryName::Package_Identity, identityNode);
+                });
+                return dom->ForEachElementIn(dom->GetDocument(), XmlQueryName::Package_Identity, identityVisitor);
+            }
+        }
+        return true;
+    }
+
 protected:
     bool            m_CoInitialized;
     IMSIXFactory*   m_factory;
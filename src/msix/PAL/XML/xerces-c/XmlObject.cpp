@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <mutex>
 
 #include "Exceptions.hpp"
 #include "StreamBase.hpp"
@@ -19,7 +20,14 @@
 #include "xercesc/framework/XMLGrammarPoolImpl.hpp"
 #include "xercesc/parsers/AbstractDOMParser.hpp"
 #include "xercesc/parsers/XercesDOMParser.hpp"
+#include "xercesc/framework/XMLPScanToken.hpp"
 #include "xercesc/sax/ErrorHandler.hpp"
+#include "xercesc/sax/InputSource.hpp"
+#include "xercesc/sax2/Attributes.hpp"
+#include "xercesc/sax2/DefaultHandler.hpp"
+#include "xercesc/sax2/SAX2XMLReader.hpp"
+#include "xercesc/sax2/XMLReaderFactory.hpp"
+#include "xercesc/util/BinInputStream.hpp"
 #include "xercesc/util/PlatformUtils.hpp"
 #include "xercesc/util/XMLString.hpp"
 #include "xercesc/util/Base64.hpp"
@@ -52,6 +60,13 @@ static std::map<XmlQueryName, std::string> xPaths = {
     {XmlQueryName::BlockMap_File_Block                          ,"./Block"},
 };
 
+// The absolute paths of the queries, as XercesElementReader builds them while it reads.
+static std::map<std::string, XmlQueryName> elementPaths = {
+    {"/Package/Identity"                                        ,XmlQueryName::Package_Identity},
+    {"/BlockMap/File"                                           ,XmlQueryName::BlockMap_File},
+    {"/BlockMap/File/Block"                                     ,XmlQueryName::BlockMap_File_Block},
+};
+
 static std::map<XmlAttributeName, std::string> attributeNames = {
     {XmlAttributeName::Package_Identity_Name                    ,"Name"},
     {XmlAttributeName::Package_Identity_ProcessorArchitecture   ,"ProcessorArchitecture"},
@@ -221,6 +236,25 @@ protected:
     XMLByte* m_ptr = nullptr;             
 };    
 
+static std::string TranscodeAttribute(const XMLCh* value)
+{
+    if (value == nullptr) { return std::string(); }
+    XercesCharPtr text(XMLString::transcode(value));
+    return std::string(text.Get());
+}
+
+static std::vector<std::uint8_t> DecodeBase64Attribute(const XMLCh* value)
+{
+    if (value == nullptr) { return std::vector<std::uint8_t>(); }
+    XMLSize_t len = 0;
+    XercesXMLBytePtr decodedData(XERCES_CPP_NAMESPACE::Base64::decodeToXMLByte(value, &len));
+    std::vector<std::uint8_t> result(len);
+    for(XMLSize_t index=0; index < len; index++)
+    {   result[index] = static_cast<std::uint8_t>(decodedData.Get()[index]);
+    }
+    return result;
+}
+
 class XercesElement final : public ComClass<XercesElement, IXmlElement, IXercesElement>
 {
 public:
@@ -230,22 +264,13 @@ public:
     std::string GetAttributeValue(XmlAttributeName attribute) override
     {
         XercesXMLChPtr nameAttr(XMLString::transcode(attributeNames[attribute].c_str()));
-        XercesCharPtr value(XMLString::transcode(m_element->getAttribute(nameAttr.Get())));
-        return std::string(value.Get());
+        return TranscodeAttribute(m_element->getAttribute(nameAttr.Get()));
     }
 
     std::vector<std::uint8_t> GetBase64DecodedAttributeValue(XmlAttributeName attribute) override
     {
         XercesXMLChPtr nameAttr(XMLString::transcode(attributeNames[attribute].c_str()));
-        XMLSize_t len = 0;
-        XercesXMLBytePtr decodedData(XERCES_CPP_NAMESPACE::Base64::decodeToXMLByte(
-            m_element->getAttribute(nameAttr.Get()),
-            &len));
-        std::vector<std::uint8_t> result(len);
-        for(XMLSize_t index=0; index < len; index++)
-        {   result[index] = static_cast<std::uint8_t>(decodedData.Get()[index]);
-        }
-        return result;        
+        return DecodeBase64Attribute(m_element->getAttribute(nameAttr.Get()));
     }
 
     // IXercesElement
@@ -258,42 +283,21 @@ protected:
 class XercesDom final : public ComClass<XercesDom, IXmlDom>
 {
 public:
-    XercesDom(const ComPtr<IStream>& stream, std::vector<ComPtr<IStream>>* schemas = nullptr) :  m_stream(stream)
+    // Validates against the schemas in 'grammarPool', if there is one. See XercesFactory::GetGrammarPool.
+    XercesDom(const ComPtr<IStream>& stream, const std::shared_ptr<XERCES_CPP_NAMESPACE::XMLGrammarPoolImpl>& grammarPool = nullptr) :
+        m_stream(stream), m_grammarPool(grammarPool)
     {
         auto buffer = Helper::CreateBufferFromStream(stream);
         std::unique_ptr<XERCES_CPP_NAMESPACE::MemBufInputSource> source = std::make_unique<XERCES_CPP_NAMESPACE::MemBufInputSource>(
             reinterpret_cast<const XMLByte*>(&buffer[0]), buffer.size(), "XML File");
 
-        // Create parser and grammar pool
-        auto grammarPool = std::make_unique<XERCES_CPP_NAMESPACE::XMLGrammarPoolImpl>(XERCES_CPP_NAMESPACE::XMLPlatformUtils::fgMemoryManager);
-        m_parser = std::make_unique<XERCES_CPP_NAMESPACE::XercesDOMParser>(nullptr, XERCES_CPP_NAMESPACE::XMLPlatformUtils::fgMemoryManager, grammarPool.get());
-        
-        bool HasSchemas = ((schemas != nullptr) && (schemas->begin() != schemas->end()));
-        m_parser->setValidationScheme(HasSchemas ? 
-            XERCES_CPP_NAMESPACE::AbstractDOMParser::ValSchemes::Val_Always : 
-            XERCES_CPP_NAMESPACE::AbstractDOMParser::ValSchemes::Val_Never
-        );
-        m_parser->cacheGrammarFromParse(HasSchemas);            
-        m_parser->setDoSchema(HasSchemas);
-        m_parser->setDoNamespaces(HasSchemas);
-        m_parser->setHandleMultipleImports(HasSchemas); // TODO: do we need to handle the case where there aren't multiple schemas with the same namespace?
-        m_parser->setValidationSchemaFullChecking(HasSchemas);
-
-        if (HasSchemas)
-        {   // Disable DTD and prevent XXE attacks.  See https://www.owasp.org/index.php/XML_External_Entity_(XXE)_Prevention_Cheat_Sheet#libxerces-c for additional details.
-            m_parser->setIgnoreCachedDTD(true);
-            m_parser->setSkipDTDValidation(true);
-            m_parser->setCreateEntityReferenceNodes(false);
-        }
-
-        // Add schemas
-        if (HasSchemas)
-        {   for(auto& schema : *schemas)
-            {   auto schemaBuffer = Helper::CreateBufferFromStream(schema);
-                auto item = std::make_unique<XERCES_CPP_NAMESPACE::MemBufInputSource>(
-                    reinterpret_cast<const XMLByte*>(&schemaBuffer[0]), schemaBuffer.size(), "Schema");
-                m_parser->loadGrammar(*item, XERCES_CPP_NAMESPACE::Grammar::GrammarType::SchemaGrammarType, true);
-            }           
+        // Create parser
+        m_parser = std::make_unique<XERCES_CPP_NAMESPACE::XercesDOMParser>(nullptr, XERCES_CPP_NAMESPACE::XMLPlatformUtils::fgMemoryManager, m_grammarPool.get());
+        ConfigureParser(*m_parser, !!m_grammarPool);
+        if (m_grammarPool)
+        {   // The pool is locked, so use its grammars without adding any.
+            m_parser->cacheGrammarFromParse(false);
+            m_parser->useCachedGrammarInParse(true);
         }
 
         // Set the error handler for the parser
@@ -313,13 +317,8 @@ public:
         ComPtr<IXercesElement> element;
         ThrowHrIfFailed(root->QueryInterface(UuidOfImpl<IXercesElement>::iid, reinterpret_cast<void**>(&element)));
 
-        XercesXMLChPtr xPath(XMLString::transcode(xPaths[query].c_str()));
-        // TODO: Do we need to always create a resolver, or can we reuse it once we create one?
-        XercesPtr<DOMXPathNSResolver> resolver(m_parser->getDocument()->createNSResolver(m_parser->getDocument()));
-        XercesPtr<DOMXPathResult> result(m_parser->getDocument()->evaluate(
-            xPath.Get(),
+        XercesPtr<DOMXPathResult> result(GetExpression(query)->evaluate(
             element->GetElement(),
-            resolver.Get(),
             DOMXPathResult::ORDERED_NODE_SNAPSHOT_TYPE,
             nullptr));
         
@@ -336,9 +335,156 @@ public:
         return true;
     }
 
+    // Sets 'parser' up to validate against the schemas of its grammar pool, or not at all.
+    static void ConfigureParser(XERCES_CPP_NAMESPACE::XercesDOMParser& parser, bool HasSchemas)
+    {
+        parser.setValidationScheme(HasSchemas ? 
+            XERCES_CPP_NAMESPACE::AbstractDOMParser::ValSchemes::Val_Always : 
+            XERCES_CPP_NAMESPACE::AbstractDOMParser::ValSchemes::Val_Never
+        );
+        parser.cacheGrammarFromParse(HasSchemas);            
+        parser.setDoSchema(HasSchemas);
+        parser.setDoNamespaces(HasSchemas);
+        parser.setHandleMultipleImports(HasSchemas); // TODO: do we need to handle the case where there aren't multiple schemas with the same namespace?
+        parser.setValidationSchemaFullChecking(HasSchemas);
+
+        if (HasSchemas)
+        {   // Disable DTD and prevent XXE attacks.  See https://www.owasp.org/index.php/XML_External_Entity_(XXE)_Prevention_Cheat_Sheet#libxerces-c for additional details.
+            parser.setIgnoreCachedDTD(true);
+            parser.setSkipDTDValidation(true);
+            parser.setCreateEntityReferenceNodes(false);
+        }
+    }
+
 protected:
-    std::unique_ptr<XERCES_CPP_NAMESPACE::XercesDOMParser> m_parser;
+    // Compiles the XPath of 'query' the first time it is asked for. The blockmap asks for ./Block once per File.
+    DOMXPathExpression* GetExpression(XmlQueryName query)
+    {
+        auto expression = m_expressions.find(query);
+        if (expression == m_expressions.end())
+        {
+            auto document = m_parser->getDocument();
+            if (!m_resolver.Get()) { m_resolver = XercesPtr<DOMXPathNSResolver>(document->createNSResolver(document)); }
+            XercesXMLChPtr xPath(XMLString::transcode(xPaths[query].c_str()));
+            expression = m_expressions.emplace(query, XercesPtr<DOMXPathExpression>(document->createExpression(xPath.Get(), m_resolver.Get()))).first;
+        }
+        return expression->second.Get();
+    }
+
     ComPtr<IStream> m_stream;    
+    std::shared_ptr<XERCES_CPP_NAMESPACE::XMLGrammarPoolImpl>   m_grammarPool;
+    std::unique_ptr<XERCES_CPP_NAMESPACE::XercesDOMParser>      m_parser;
+    XercesPtr<DOMXPathNSResolver>                               m_resolver;
+    std::map<XmlQueryName, XercesPtr<DOMXPathExpression>>       m_expressions;
+};
+
+// Hands Xerces the contents of an IStream as it asks for them, rather than all at once.
+class XercesStreamInput final : public XERCES_CPP_NAMESPACE::BinInputStream
+{
+public:
+    XercesStreamInput(const ComPtr<IStream>& stream) : m_stream(stream) {}
+
+    XMLFilePos curPos() const override { return m_position; }
+
+    XMLSize_t readBytes(XMLByte* const toFill, const XMLSize_t maxToRead) override
+    {
+        ULONG actualRead = 0;
+        ThrowHrIfFailed(m_stream->Read(toFill, static_cast<ULONG>(maxToRead), &actualRead));
+        m_position += actualRead;
+        return actualRead;
+    }
+
+    const XMLCh* getContentType() const override { return nullptr; }
+
+protected:
+    ComPtr<IStream> m_stream;
+    XMLFilePos      m_position = 0;
+};
+
+class XercesStreamInputSource final : public XERCES_CPP_NAMESPACE::InputSource
+{
+public:
+    XercesStreamInputSource(const ComPtr<IStream>& stream) : InputSource("XML File"), m_stream(stream) {}
+
+    XERCES_CPP_NAMESPACE::BinInputStream* makeStream() const override { return new XercesStreamInput(m_stream); }
+
+protected:
+    ComPtr<IStream> m_stream;
+};
+
+// The element a SAX2 reader is on. Only its attributes are known, and only until the reader moves past it.
+class XercesSaxElement final : public ComClass<XercesSaxElement, IXmlElement>
+{
+public:
+    XercesSaxElement()
+    {
+        for (const auto& name : attributeNames)
+        {   m_names.emplace(name.first, XercesXMLChPtr(XMLString::transcode(name.second.c_str())));
+        }
+    }
+
+    void SetAttributes(const XERCES_CPP_NAMESPACE::Attributes* attributes) { m_attributes = attributes; }
+
+    // IXmlElement
+    std::string GetAttributeValue(XmlAttributeName attribute) override
+    {
+        return TranscodeAttribute(m_attributes->getValue(m_names.at(attribute).Get()));
+    }
+
+    std::vector<std::uint8_t> GetBase64DecodedAttributeValue(XmlAttributeName attribute) override
+    {
+        return DecodeBase64Attribute(m_attributes->getValue(m_names.at(attribute).Get()));
+    }
+
+protected:
+    std::map<XmlAttributeName, XercesXMLChPtr> m_names;
+    const XERCES_CPP_NAMESPACE::Attributes*    m_attributes = nullptr;
+};
+
+// Keeps track of where a SAX2 reader is in the document, and reports the elements that elementPaths knows about to
+// the visitor. Only the path to the current element is kept.
+class XercesElementReader final : public XERCES_CPP_NAMESPACE::DefaultHandler
+{
+public:
+    XercesElementReader(XmlElementVisitor& visitor) : m_visitor(visitor)
+    {
+        m_element = ComPtr<XercesSaxElement>::Make<XercesSaxElement>();
+        m_item = m_element.As<IXmlElement>();
+    }
+
+    bool Stopped() { return m_stopped; }
+
+    void startElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname,
+        const XERCES_CPP_NAMESPACE::Attributes& attributes) override
+    {
+        m_parents.push_back(m_path.size());
+        m_path += '/';
+        // Without namespaces there's only the qualified name. None of the names we look for are outside of ASCII.
+        const XMLCh* name = ((localname != nullptr) && (*localname != 0)) ? localname : qname;
+        for (; *name != 0; name++) { m_path += (*name < 0x80) ? static_cast<char>(*name) : '?'; }
+
+        auto query = elementPaths.find(m_path);
+        if (!m_stopped && (query != elementPaths.end()))
+        {
+            m_element->SetAttributes(&attributes);
+            m_stopped = !m_visitor.Callback(m_visitor.context, query->second, m_item);
+            m_element->SetAttributes(nullptr);
+        }
+    }
+
+    void endElement(const XMLCh* const uri, const XMLCh* const localname, const XMLCh* const qname) override
+    {
+        m_path.resize(m_parents.back());
+        m_parents.pop_back();
+    }
+
+protected:
+    XmlElementVisitor&          m_visitor;
+    ComPtr<XercesSaxElement>    m_element;
+    ComPtr<IXmlElement>         m_item;
+    std::string                 m_path;
+    std::vector<std::size_t>    m_parents;  // length of m_path at each open element
+    bool                        m_stopped = false;
 };
 
 class XercesFactory final : public ComClass<XercesFactory, IXmlFactory>
@@ -350,7 +496,8 @@ public:
     }
 
     ~XercesFactory()
-    {
+    {   // The grammars have to go before Xerces does.
+        m_grammarPools.clear();
         XERCES_CPP_NAMESPACE::XMLPlatformUtils::Terminate();
     }
 
@@ -359,21 +506,103 @@ public:
         switch (footPrintType)
         {
             case XmlContentType::AppxBlockMapXml:
-            {   auto blockMapSchema = GetResources(m_factory, Resource::Type::BlockMap);
-                return ComPtr<IXmlDom>::Make<XercesDom>(stream, &blockMapSchema);
-            }
+                return ComPtr<IXmlDom>::Make<XercesDom>(stream, GetGrammarPool(Resource::Type::BlockMap));
             case XmlContentType::AppxManifestXml:
                 // TODO: pass schemas to validate AppxManifest. This only validates that is a well-formed xml
                 return ComPtr<IXmlDom>::Make<XercesDom>(stream);
             case XmlContentType::ContentTypeXml:
-            {   auto contentTypeSchema = GetResources(m_factory, Resource::Type::ContentType);
-                return ComPtr<IXmlDom>::Make<XercesDom>(stream, &contentTypeSchema);
-            }
+                return ComPtr<IXmlDom>::Make<XercesDom>(stream, GetGrammarPool(Resource::Type::ContentType));
         }
         ThrowError(Error::InvalidParameter);
     }
+
+    bool ForEachElementInStream(XmlContentType footPrintType, const ComPtr<IStream>& stream, XmlElementVisitor& visitor) override
+    {
+        std::shared_ptr<XERCES_CPP_NAMESPACE::XMLGrammarPoolImpl> grammarPool;
+        switch (footPrintType)
+        {
+            case XmlContentType::AppxBlockMapXml:
+                grammarPool = GetGrammarPool(Resource::Type::BlockMap);
+                break;
+            case XmlContentType::AppxManifestXml:
+                break;
+            case XmlContentType::ContentTypeXml:
+                grammarPool = GetGrammarPool(Resource::Type::ContentType);
+                break;
+            default:
+                ThrowError(Error::InvalidParameter);
+        }
+
+        // Same settings as XercesDom, so that a document gets the same errors from either.
+        std::unique_ptr<XERCES_CPP_NAMESPACE::SAX2XMLReader> reader(XERCES_CPP_NAMESPACE::XMLReaderFactory::createXMLReader(
+            XERCES_CPP_NAMESPACE::XMLPlatformUtils::fgMemoryManager, grammarPool.get()));
+
+        bool HasSchemas = !!grammarPool;
+        reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgSAX2CoreValidation, HasSchemas);
+        reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgXercesDynamic, false);
+        reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgXercesCacheGrammarFromParse, false);
+        reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgXercesUseCachedGrammarInParse, HasSchemas);
+        reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgXercesSchema, HasSchemas);
+        reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgSAX2CoreNameSpaces, HasSchemas);
+        reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgXercesHandleMultipleImports, HasSchemas);
+        reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgXercesSchemaFullChecking, HasSchemas);
+
+        if (HasSchemas)
+        {   // Disable DTD and prevent XXE attacks, as XercesDom does.
+            reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgXercesIgnoreCachedDTD, true);
+            reader->setFeature(XERCES_CPP_NAMESPACE::XMLUni::fgXercesSkipDTDValidation, true);
+        }
+
+        auto errorHandler = std::make_unique<ParsingException>();
+        XercesElementReader elementReader(visitor);
+        reader->setErrorHandler(errorHandler.get());
+        reader->setContentHandler(&elementReader);
+
+        // Pull the document through a piece at a time, which also lets a visitor that is done stop the read.
+        LARGE_INTEGER li = {0};
+        ThrowHrIfFailed(stream->Seek(li, StreamBase::Reference::START, nullptr));
+        XercesStreamInputSource source(stream);
+        XERCES_CPP_NAMESPACE::XMLPScanToken token;
+        bool more = reader->parseFirst(source, token);
+        while (more && !elementReader.Stopped()) { more = reader->parseNext(token); }
+        if (more) { reader->parseReset(token); }
+        ThrowHrIfFailed(stream->Seek(li, StreamBase::Reference::START, nullptr));
+        return !elementReader.Stopped();
+    }
+
 protected:
+    // Parses the schemas of 'type' the first time a document needs them, and locks the pool they go into. A locked
+    // pool can't change, so every parser this factory makes can validate against it, from any thread. There's no
+    // pool, and so no validation, if the build didn't embed any schemas of that type.
+    std::shared_ptr<XERCES_CPP_NAMESPACE::XMLGrammarPoolImpl> GetGrammarPool(Resource::Type type)
+    {
+        std::lock_guard<std::mutex> lock(m_grammarPoolsLock);
+        auto grammarPool = m_grammarPools.find(type);
+        if (grammarPool == m_grammarPools.end())
+        {
+            std::shared_ptr<XERCES_CPP_NAMESPACE::XMLGrammarPoolImpl> pool;
+            auto schemas = GetResources(m_factory, type);
+            if (!schemas.empty())
+            {
+                pool = std::make_shared<XERCES_CPP_NAMESPACE::XMLGrammarPoolImpl>(XERCES_CPP_NAMESPACE::XMLPlatformUtils::fgMemoryManager);
+                XERCES_CPP_NAMESPACE::XercesDOMParser loader(nullptr, XERCES_CPP_NAMESPACE::XMLPlatformUtils::fgMemoryManager, pool.get());
+                XercesDom::ConfigureParser(loader, true);
+                for(auto& schema : schemas)
+                {   auto schemaBuffer = Helper::CreateBufferFromStream(schema);
+                    auto item = std::make_unique<XERCES_CPP_NAMESPACE::MemBufInputSource>(
+                        reinterpret_cast<const XMLByte*>(&schemaBuffer[0]), schemaBuffer.size(), "Schema");
+                    loader.loadGrammar(*item, XERCES_CPP_NAMESPACE::Grammar::GrammarType::SchemaGrammarType, true);
+                }
+                pool->lockPool();
+            }
+            grammarPool = m_grammarPools.emplace(type, pool).first;
+        }
+        return grammarPool->second;
+    }
+
     IMSIXFactory* m_factory;
+    std::mutex    m_grammarPoolsLock;
+    std::map<Resource::Type, std::shared_ptr<XERCES_CPP_NAMESPACE::XMLGrammarPoolImpl>> m_grammarPools;
 };
 
 ComPtr<IXmlFactory> CreateXmlFactory(IMSIXFactory* factory) { return ComPtr<IXmlFactory>::Make<XercesFactory>(factory); }
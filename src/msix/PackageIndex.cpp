@@ -0,0 +1,433 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#include "PackageIndex.hpp"
+#include "Exceptions.hpp"
+#include "StreamBase.hpp"
+#include "SHA256.hpp"
+#include "UnicodeConversion.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+/* Layout of an index file, with all integers little endian:
+    header: "MSIXIDX\0"
+            uint32  version
+            uint32  validation options the package was opened with
+            uint64  size of the package
+            uint64  modification time of the package
+            32 byte SHA-256 of the last bytes of the package, which hold its end of central directory record(s)
+            32 byte SHA-256 of the body
+            uint64  size of the body
+    body:   the members of PackageIndex in the order they are declared in. Strings and byte arrays are prefixed by
+            their uint32 length and arrays of records by their uint32 count.
+*/
+
+namespace MSIX {
+
+    static const char          IndexMagic[8]   = { 'M', 'S', 'I', 'X', 'I', 'D', 'X', '\0' };
+    static const std::uint32_t IndexVersion    = 1;
+    static const std::size_t   HashSize        = 32;
+    static const std::size_t   IndexHeaderSize = sizeof(IndexMagic) + 4 + 4 + 8 + 8 + HashSize + HashSize + 8;
+
+    // The end of central directory record, preceded by the zip64 end of central directory locator and record. As
+    // packages can't have an archive comment these are always the last bytes of a package, when it has them all.
+    static const std::uint64_t EndOfPackageSize = 22 + 20 + 56;
+
+    class IndexWriter
+    {
+    public:
+        template <class T>
+        void Write(T value)
+        {
+            for (std::size_t i = 0; i < sizeof(T); i++)
+            {   m_data.push_back(static_cast<std::uint8_t>(static_cast<std::uint64_t>(value) >> (8 * i)));
+            }
+        }
+
+        void Write(const std::uint8_t* data, std::size_t size) { m_data.insert(m_data.end(), data, data + size); }
+
+        void WriteBytes(const std::vector<std::uint8_t>& bytes)
+        {
+            Write(static_cast<std::uint32_t>(bytes.size()));
+            Write(bytes.data(), bytes.size());
+        }
+
+        void WriteString(const std::string& value)
+        {
+            Write(static_cast<std::uint32_t>(value.size()));
+            Write(reinterpret_cast<const std::uint8_t*>(value.data()), value.size());
+        }
+
+        std::vector<std::uint8_t>& Data() { return m_data; }
+
+    protected:
+        std::vector<std::uint8_t> m_data;
+    };
+
+    // Reads from an index in memory. A read past the end yields zeroes and invalidates the reader instead of throwing,
+    // as a truncated or otherwise unusable index only means the package has to be opened the long way.
+    class IndexReader
+    {
+    public:
+        IndexReader(const std::uint8_t* data, std::uint64_t size) : m_data(data), m_size(size) {}
+
+        template <class T>
+        T Read()
+        {
+            std::uint64_t value = 0;
+            if (Fits(sizeof(T)))
+            {   for (std::size_t i = 0; i < sizeof(T); i++)
+                {   value |= static_cast<std::uint64_t>(m_data[m_position + i]) << (8 * i);
+                }
+                m_position += sizeof(T);
+            }
+            return static_cast<T>(value);
+        }
+
+        const std::uint8_t* Read(std::uint64_t size)
+        {
+            if (!Fits(size)) { return nullptr; }
+            const std::uint8_t* result = m_data + m_position;
+            m_position += size;
+            return result;
+        }
+
+        std::vector<std::uint8_t> ReadBytes()
+        {
+            std::uint32_t size = Read<std::uint32_t>();
+            const std::uint8_t* data = Read(size);
+            return (data == nullptr) ? std::vector<std::uint8_t>() : std::vector<std::uint8_t>(data, data + size);
+        }
+
+        std::string ReadString()
+        {
+            std::uint32_t size = Read<std::uint32_t>();
+            const std::uint8_t* data = Read(size);
+            return (data == nullptr) ? std::string() : std::string(reinterpret_cast<const char*>(data), size);
+        }
+
+        bool IsValid() const { return m_valid; }
+        bool IsAtEnd() const { return m_position == m_size; }
+
+    protected:
+        bool Fits(std::uint64_t size)
+        {
+            m_valid = m_valid && (size <= (m_size - m_position));
+            return m_valid;
+        }
+
+        const std::uint8_t* m_data;
+        std::uint64_t       m_size;
+        std::uint64_t       m_position = 0;
+        bool                m_valid = true;
+    };
+
+    // Identifies a package file, and where its index goes.
+    struct PackageKey
+    {
+        std::string               indexPath;
+        std::uint64_t             size = 0;
+        std::uint64_t             modificationTime = 0;
+        std::vector<std::uint8_t> endOfPackageHash;
+    };
+
+    static bool GetFileStat(const std::string& path, std::uint64_t& size, std::uint64_t& modificationTime)
+    {
+        #ifdef WIN32
+        struct _stat64 fileStat;
+        if (_wstat64(utf8_to_utf16(path).c_str(), &fileStat) != 0) { return false; }
+        #else
+        struct stat fileStat;
+        if (stat(path.c_str(), &fileStat) != 0) { return false; }
+        #endif
+        size = static_cast<std::uint64_t>(fileStat.st_size);
+        modificationTime = static_cast<std::uint64_t>(fileStat.st_mtime);
+        return true;
+    }
+
+    static FILE* OpenIndexFile(const std::string& path, const char* mode)
+    {
+        FILE* file = nullptr;
+        #ifdef WIN32
+        if (_wfopen_s(&file, utf8_to_utf16(path).c_str(), utf8_to_utf16(mode).c_str()) != 0) { return nullptr; }
+        #else
+        file = std::fopen(path.c_str(), mode);
+        #endif
+        return file;
+    }
+
+    static bool RemoveIndexFile(const std::string& path)
+    {
+        #ifdef WIN32
+        return (_wremove(utf8_to_utf16(path).c_str()) == 0);
+        #else
+        return (std::remove(path.c_str()) == 0);
+        #endif
+    }
+
+    static bool RenameIndexFile(const std::string& from, const std::string& to)
+    {
+        #ifdef WIN32
+        return (_wrename(utf8_to_utf16(from).c_str(), utf8_to_utf16(to).c_str()) == 0);
+        #else
+        return (std::rename(from.c_str(), to.c_str()) == 0);
+        #endif
+    }
+
+    // Unique to this process and call, so that packages opened at the same time, by this process or others, never
+    // write to the same temporary file.
+    static std::string GetTemporaryPath(const std::string& path)
+    {
+        static std::atomic<std::uint32_t> count(0);
+        #ifdef WIN32
+        auto processId = _getpid();
+        #else
+        auto processId = getpid();
+        #endif
+        return path + "." + std::to_string(processId) + "." + std::to_string(count++) + ".tmp";
+    }
+
+    // Reads all of the file at 'path', which must be 'size' bytes long.
+    static bool ReadIndexFile(const std::string& path, std::uint64_t size, std::vector<std::uint8_t>& data)
+    {
+        if (size > std::numeric_limits<std::uint32_t>::max()) { return false; }
+        FILE* file = OpenIndexFile(path, "rb");
+        if (file == nullptr) { return false; }
+        data.resize(static_cast<std::size_t>(size));
+        bool read = (std::fread(data.data(), 1, data.size(), file) == data.size()) && (std::fgetc(file) == EOF) && !std::ferror(file);
+        std::fclose(file);
+        return read;
+    }
+
+    // Returns false when 'package' isn't a stream over a file, as then there is nowhere to keep an index.
+    static bool GetPackageKey(const ComPtr<IStream>& package, PackageKey& key)
+    {
+        ComPtr<IStreamInternal> streamInternal;
+        if (FAILED(package->QueryInterface(UuidOfImpl<IStreamInternal>::iid, reinterpret_cast<void**>(&streamInternal)))) { return false; }
+        std::string path = streamInternal->GetFilePath();
+        if (path.empty() || !GetFileStat(path, key.size, key.modificationTime)) { return false; }
+        key.indexPath = path + ".msixindex";
+
+        std::vector<std::uint8_t> endOfPackage(static_cast<std::size_t>(std::min(key.size, EndOfPackageSize)));
+        LARGE_INTEGER pos = {0};
+        pos.QuadPart = -static_cast<std::int64_t>(endOfPackage.size());
+        ThrowHrIfFailed(package->Seek(pos, StreamBase::Reference::END, nullptr));
+        ULONG bytesRead = 0;
+        ThrowHrIfFailed(package->Read(endOfPackage.data(), static_cast<ULONG>(endOfPackage.size()), &bytesRead));
+        if (bytesRead != endOfPackage.size()) { return false; }
+        SHA256::ComputeHash(endOfPackage.data(), static_cast<std::uint32_t>(endOfPackage.size()), key.endOfPackageHash);
+        return true;
+    }
+
+    static std::uint32_t GetIndexedOptions(MSIX_VALIDATION_OPTION validation)
+    {
+        return static_cast<std::uint32_t>(validation) & ~static_cast<std::uint32_t>(MSIX_VALIDATION_OPTION_USEPACKAGEINDEX);
+    }
+
+    static void WriteBody(const PackageIndex& index, IndexWriter& writer)
+    {
+        writer.Write(static_cast<std::uint32_t>(index.files.size()));
+        for (const auto& file : index.files)
+        {
+            writer.WriteString(file.name);
+            writer.Write(file.dataOffset);
+            writer.Write(file.compressedSize);
+            writer.Write(file.uncompressedSize);
+            writer.Write(static_cast<std::uint8_t>(file.isCompressed));
+        }
+
+        writer.Write(static_cast<std::uint8_t>(index.hasDigests));
+        writer.Write(static_cast<std::uint8_t>(index.signatureOrigin));
+        writer.WriteString(index.signaturePublisher);
+        writer.WriteBytes(index.fileRecordsDigest);
+        writer.WriteBytes(index.centralDirectoryDigest);
+        writer.WriteBytes(index.contentTypesDigest);
+        writer.WriteBytes(index.blockMapDigest);
+        writer.WriteBytes(index.codeIntegrityDigest);
+
+        writer.Write(static_cast<std::uint32_t>(index.blockMapFiles.size()));
+        for (const auto& file : index.blockMapFiles)
+        {
+            writer.WriteString(file.name);
+            writer.Write(file.size);
+            writer.Write(file.localFileHeaderSize);
+            writer.Write(static_cast<std::uint32_t>(file.countBlocks));
+            for (std::size_t i = file.firstBlock; i < file.firstBlock + file.countBlocks; i++)
+            {
+                const auto& block = index.blocks[i];
+                writer.Write(block.compressedSize);
+                writer.WriteBytes(std::vector<std::uint8_t>(block.hash.begin(), block.hash.end()));
+            }
+        }
+
+        writer.WriteString(index.name);
+        writer.WriteString(index.version);
+        writer.WriteString(index.resourceId);
+        writer.WriteString(index.architecture);
+        writer.WriteString(index.publisher);
+    }
+
+    static bool ReadBody(IndexReader& reader, PackageIndex& index)
+    {
+        std::uint32_t countFiles = reader.Read<std::uint32_t>();
+        for (std::uint32_t i = 0; (i < countFiles) && reader.IsValid(); i++)
+        {
+            ZipFileLocation file;
+            file.name             = reader.ReadString();
+            file.dataOffset       = reader.Read<std::uint64_t>();
+            file.compressedSize   = reader.Read<std::uint64_t>();
+            file.uncompressedSize = reader.Read<std::uint64_t>();
+            file.isCompressed     = (reader.Read<std::uint8_t>() != 0);
+            index.files.push_back(std::move(file));
+        }
+
+        index.hasDigests = (reader.Read<std::uint8_t>() != 0);
+        std::uint8_t origin = reader.Read<std::uint8_t>();
+        if (origin > static_cast<std::uint8_t>(SignatureOrigin::Unsigned)) { return false; }
+        index.signatureOrigin        = static_cast<SignatureOrigin>(origin);
+        index.signaturePublisher     = reader.ReadString();
+        index.fileRecordsDigest      = reader.ReadBytes();
+        index.centralDirectoryDigest = reader.ReadBytes();
+        index.contentTypesDigest     = reader.ReadBytes();
+        index.blockMapDigest         = reader.ReadBytes();
+        index.codeIntegrityDigest    = reader.ReadBytes();
+
+        std::uint32_t countBlockMapFiles = reader.Read<std::uint32_t>();
+        for (std::uint32_t i = 0; (i < countBlockMapFiles) && reader.IsValid(); i++)
+        {
+            PackageIndex::BlockMapFile file;
+            file.name                = reader.ReadString();
+            file.size                = reader.Read<std::uint64_t>();
+            file.localFileHeaderSize = reader.Read<std::uint32_t>();
+            std::uint32_t countBlocks = reader.Read<std::uint32_t>();
+            file.firstBlock  = index.blocks.size();
+            file.countBlocks = countBlocks;
+            for (std::uint32_t j = 0; (j < countBlocks) && reader.IsValid(); j++)
+            {
+                Block block;
+                block.compressedSize = reader.Read<std::uint64_t>();
+                auto hash            = reader.ReadBytes();
+                if (hash.size() != block.hash.size()) { return false; }
+                std::copy(hash.begin(), hash.end(), block.hash.begin());
+                index.blocks.push_back(block);
+            }
+            index.blockMapFiles.push_back(std::move(file));
+        }
+
+        index.name         = reader.ReadString();
+        index.version      = reader.ReadString();
+        index.resourceId   = reader.ReadString();
+        index.architecture = reader.ReadString();
+        index.publisher    = reader.ReadString();
+        return reader.IsValid() && reader.IsAtEnd();
+    }
+
+    // The index only ever saves work, so whatever goes wrong with it, or the package while it's keyed, is left for
+    // the normal open that follows to report or not.
+    std::unique_ptr<PackageIndex> PackageIndex::Load(const ComPtr<IStream>& package, MSIX_VALIDATION_OPTION validation) try
+    {
+        PackageKey key;
+        std::uint64_t indexSize = 0;
+        std::uint64_t indexModificationTime = 0;
+        if (!GetPackageKey(package, key) || !GetFileStat(key.indexPath, indexSize, indexModificationTime) || (indexSize < IndexHeaderSize))
+        {   return nullptr;
+        }
+
+        // Read in one go, and parsed from memory; the index may be replaced while it's open, but not what was read.
+        std::vector<std::uint8_t> index;
+        if (!ReadIndexFile(key.indexPath, indexSize, index)) { return nullptr; }
+        const std::uint8_t* data = index.data();
+
+        IndexReader header(data, IndexHeaderSize);
+        const std::uint8_t* magic   = header.Read(sizeof(IndexMagic));
+        std::uint32_t version       = header.Read<std::uint32_t>();
+        std::uint32_t options       = header.Read<std::uint32_t>();
+        std::uint64_t packageSize   = header.Read<std::uint64_t>();
+        std::uint64_t packageTime   = header.Read<std::uint64_t>();
+        const std::uint8_t* endHash = header.Read(HashSize);
+        const std::uint8_t* hash    = header.Read(HashSize);
+        std::uint64_t bodySize      = header.Read<std::uint64_t>();
+        if (!header.IsValid() ||
+            (std::memcmp(magic, IndexMagic, sizeof(IndexMagic)) != 0) ||
+            (version != IndexVersion) ||
+            (options != GetIndexedOptions(validation)) ||
+            (packageSize != key.size) ||
+            (packageTime != key.modificationTime) ||
+            (key.endOfPackageHash.size() != HashSize) ||
+            (std::memcmp(endHash, key.endOfPackageHash.data(), HashSize) != 0) ||
+            (bodySize != (index.size() - IndexHeaderSize)) ||
+            (bodySize > std::numeric_limits<std::uint32_t>::max()))
+        {   return nullptr;
+        }
+
+        const std::uint8_t* body = data + IndexHeaderSize;
+        std::vector<std::uint8_t> bodyHash;
+        SHA256::ComputeHash(const_cast<std::uint8_t*>(body), static_cast<std::uint32_t>(bodySize), bodyHash);
+        if ((bodyHash.size() != HashSize) || (std::memcmp(hash, bodyHash.data(), HashSize) != 0)) { return nullptr; }
+
+        auto result = std::make_unique<PackageIndex>();
+        IndexReader reader(body, bodySize);
+        if (!ReadBody(reader, *result)) { return nullptr; }
+        return result;
+    }
+    catch (...)
+    {   return nullptr;
+    }
+
+    // Not having written the index is never an error, whatever the reason.
+    void PackageIndex::Save(const ComPtr<IStream>& package, MSIX_VALIDATION_OPTION validation) const try
+    {
+        PackageKey key;
+        if (!GetPackageKey(package, key) || (key.endOfPackageHash.size() != HashSize)) { return; }
+
+        IndexWriter body;
+        WriteBody(*this, body);
+        if (body.Data().size() > std::numeric_limits<std::uint32_t>::max()) { return; }
+        std::vector<std::uint8_t> bodyHash;
+        SHA256::ComputeHash(body.Data().data(), static_cast<std::uint32_t>(body.Data().size()), bodyHash);
+
+        IndexWriter header;
+        header.Write(reinterpret_cast<const std::uint8_t*>(IndexMagic), sizeof(IndexMagic));
+        header.Write(IndexVersion);
+        header.Write(GetIndexedOptions(validation));
+        header.Write(key.size);
+        header.Write(key.modificationTime);
+        header.Write(key.endOfPackageHash.data(), HashSize);
+        header.Write(bodyHash.data(), HashSize);
+        header.Write(static_cast<std::uint64_t>(body.Data().size()));
+
+        // Written under a temporary name and then renamed into place, so that anyone opening the package meanwhile
+        // either finds no index or a complete one.
+        std::string temporaryPath = GetTemporaryPath(key.indexPath);
+        FILE* file = OpenIndexFile(temporaryPath, "wb");
+        if (file == nullptr) { return; }
+        bool written =
+            (std::fwrite(header.Data().data(), 1, header.Data().size(), file) == header.Data().size()) &&
+            (std::fwrite(body.Data().data(), 1, body.Data().size(), file) == body.Data().size());
+        written = (std::fclose(file) == 0) && written;
+        if (written)
+        {   RemoveIndexFile(key.indexPath);
+            written = RenameIndexFile(temporaryPath, key.indexPath);
+        }
+        if (!written) { RemoveIndexFile(temporaryPath); }
+    }
+    catch (...)
+    {
+    }
+}
@@ -0,0 +1,287 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#include "Exceptions.hpp"
+#include "SHA256.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+// On x64, buffers are hashed eight at a time with AVX2 when the processor has it, the way OpenSSL does it for TLS
+// records. Processors that have the SHA extensions hash one buffer faster than that, and both OpenSSL and CNG use
+// them on their own, so those go through the SHA256 PAL one buffer at a time instead.
+#if defined(__x86_64__) || defined(_M_X64)
+#define MSIX_SHA256_MULTIBUFFER 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_FUNCTION
+#else
+#include <cpuid.h>
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace MSIX {
+
+#if MSIX_SHA256_MULTIBUFFER
+    namespace {
+
+        const std::size_t SHA256_BLOCK_SIZE = 64;
+        const std::size_t SHA256_LANES = 8;
+
+        const std::uint32_t SHA256_K[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+        };
+
+        const std::uint32_t SHA256_H0[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+        };
+
+        void CpuId(std::uint32_t leaf, std::uint32_t registers[4])
+        {
+        #ifdef _MSC_VER
+            int info[4] = { 0 };
+            __cpuidex(info, static_cast<int>(leaf), 0);
+            for (int i = 0; i < 4; i++) { registers[i] = static_cast<std::uint32_t>(info[i]); }
+        #else
+            registers[0] = registers[1] = registers[2] = registers[3] = 0;
+            __get_cpuid_count(leaf, 0, &registers[0], &registers[1], &registers[2], &registers[3]);
+        #endif
+        }
+
+        // Whether the processor has AVX2 and the SHA extensions, as far as the multi-buffer kernel is concerned.
+        struct Features
+        {
+            bool avx2 = false;
+            bool shaExtensions = false;
+        };
+
+        Features GetFeatures()
+        {
+            Features features;
+            std::uint32_t registers[4];
+            CpuId(0, registers);
+            if (registers[0] < 7) { return features; }
+
+            // AVX2 is only usable if the OS saves the AVX registers too.
+            CpuId(1, registers);
+            bool osSavesAvx = (registers[2] & (1u << 27)) && (registers[2] & (1u << 28));
+            if (osSavesAvx)
+            {
+            #ifdef _MSC_VER
+                std::uint64_t xcr0 = _xgetbv(0);
+            #else
+                std::uint32_t eax = 0, edx = 0;
+                __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+                std::uint64_t xcr0 = (static_cast<std::uint64_t>(edx) << 32) | eax;
+            #endif
+                osSavesAvx = ((xcr0 & 0x6) == 0x6);
+            }
+
+            CpuId(7, registers);
+            features.avx2 = osSavesAvx && ((registers[1] & (1u << 5)) != 0);
+            features.shaExtensions = (registers[1] & (1u << 29)) != 0;
+            return features;
+        }
+
+        // A buffer being hashed in one of the lanes: its whole blocks, followed by the rest of it padded out to one
+        // or two more blocks.
+        struct Lane
+        {
+            const std::uint8_t* data = nullptr;
+            std::size_t blocks = 0;
+            std::size_t totalBlocks = 0;
+            std::uint8_t tail[2 * SHA256_BLOCK_SIZE];
+
+            void Assign(const std::uint8_t* buffer, std::size_t size)
+            {
+                data = buffer;
+                blocks = size / SHA256_BLOCK_SIZE;
+                std::size_t rest = size % SHA256_BLOCK_SIZE;
+                std::size_t tailBlocks = ((rest + 9) > SHA256_BLOCK_SIZE) ? 2 : 1;
+                totalBlocks = blocks + tailBlocks;
+
+                std::memset(tail, 0, sizeof(tail));
+                if (rest != 0) { std::memcpy(tail, buffer + (blocks * SHA256_BLOCK_SIZE), rest); }
+                tail[rest] = 0x80;
+                std::uint64_t bits = static_cast<std::uint64_t>(size) * 8;
+                for (std::size_t i = 0; i < 8; i++)
+                {   tail[(tailBlocks * SHA256_BLOCK_SIZE) - 1 - i] = static_cast<std::uint8_t>(bits >> (8 * i));
+                }
+            }
+
+            const std::uint8_t* Block(std::size_t index) const
+            {
+                return (index < blocks) ? (data + (index * SHA256_BLOCK_SIZE)) : (tail + ((index - blocks) * SHA256_BLOCK_SIZE));
+            }
+        };
+
+        template <int n>
+        AVX2_FUNCTION inline __m256i Rotr(__m256i x) { return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n)); }
+
+        AVX2_FUNCTION inline __m256i Add(__m256i a, __m256i b) { return _mm256_add_epi32(a, b); }
+        AVX2_FUNCTION inline __m256i Xor(__m256i a, __m256i b, __m256i c) { return _mm256_xor_si256(_mm256_xor_si256(a, b), c); }
+
+        // Loads 32 bytes of each lane's block and transposes them, so that w[k] holds the k'th big-endian word of
+        // every lane.
+        AVX2_FUNCTION inline void LoadWords(const std::uint8_t* const blocks[SHA256_LANES], std::size_t offset, __m256i w[8])
+        {
+            const __m256i byteSwap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                                      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+            __m256i r[8];
+            for (std::size_t lane = 0; lane < SHA256_LANES; lane++)
+            {   r[lane] = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks[lane] + offset)), byteSwap);
+            }
+
+            __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+            __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+            __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+            __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+            __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+            __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+            __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+            __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+
+            __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+            __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+            __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+            __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+            __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+            __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+            __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+            __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+            w[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+            w[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+            w[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+            w[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+            w[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+            w[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+            w[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+            w[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+        }
+
+        // Runs one block of each lane through the compression function. Lanes not in 'active' keep their state.
+        AVX2_FUNCTION void Compress(__m256i state[8], const std::uint8_t* const blocks[SHA256_LANES], __m256i active)
+        {
+            __m256i w[64];
+            LoadWords(blocks, 0, &w[0]);
+            LoadWords(blocks, 32, &w[8]);
+            for (std::size_t t = 16; t < 64; t++)
+            {
+                __m256i s0 = Xor(Rotr<7>(w[t - 15]), Rotr<18>(w[t - 15]), _mm256_srli_epi32(w[t - 15], 3));
+                __m256i s1 = Xor(Rotr<17>(w[t - 2]), Rotr<19>(w[t - 2]), _mm256_srli_epi32(w[t - 2], 10));
+                w[t] = Add(Add(s1, w[t - 7]), Add(s0, w[t - 16]));
+            }
+
+            __m256i a = state[0], b = state[1], c = state[2], d = state[3];
+            __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+            for (std::size_t t = 0; t < 64; t++)
+            {
+                __m256i S1 = Xor(Rotr<6>(e), Rotr<11>(e), Rotr<25>(e));
+                __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+                __m256i t1 = Add(Add(Add(h, S1), Add(ch, w[t])), _mm256_set1_epi32(static_cast<int>(SHA256_K[t])));
+                __m256i S0 = Xor(Rotr<2>(a), Rotr<13>(a), Rotr<22>(a));
+                __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+                h = g; g = f; f = e;
+                e = Add(d, t1);
+                d = c; c = b; b = a;
+                a = Add(t1, Add(S0, maj));
+            }
+
+            __m256i result[8] = { a, b, c, d, e, f, g, h };
+            for (std::size_t i = 0; i < 8; i++)
+            {   state[i] = _mm256_blendv_epi8(state[i], Add(state[i], result[i]), active);
+            }
+        }
+
+        // Hashes up to eight buffers side by side. Unused lanes hash the first buffer again, and are ignored.
+        AVX2_FUNCTION void HashLanes(const Lane* lanes, std::size_t count, std::vector<std::uint8_t>* const hashes[SHA256_LANES])
+        {
+            __m256i state[8];
+            for (std::size_t i = 0; i < 8; i++) { state[i] = _mm256_set1_epi32(static_cast<int>(SHA256_H0[i])); }
+
+            std::size_t maxBlocks = 0;
+            for (std::size_t lane = 0; lane < count; lane++) { maxBlocks = std::max(maxBlocks, lanes[lane].totalBlocks); }
+
+            const std::uint8_t* blocks[SHA256_LANES];
+            for (std::size_t index = 0; index < maxBlocks; index++)
+            {
+                alignas(32) std::int32_t mask[SHA256_LANES];
+                for (std::size_t lane = 0; lane < SHA256_LANES; lane++)
+                {
+                    bool active = (lane < count) && (index < lanes[lane].totalBlocks);
+                    blocks[lane] = active ? lanes[lane].Block(index) : lanes[0].tail;
+                    mask[lane] = active ? -1 : 0;
+                }
+                Compress(state, blocks, _mm256_load_si256(reinterpret_cast<const __m256i*>(mask)));
+            }
+
+            alignas(32) std::uint32_t words[8][SHA256_LANES];
+            for (std::size_t i = 0; i < 8; i++) { _mm256_store_si256(reinterpret_cast<__m256i*>(words[i]), state[i]); }
+            for (std::size_t lane = 0; lane < count; lane++)
+            {
+                std::vector<std::uint8_t>& hash = *hashes[lane];
+                hash.resize(32);
+                for (std::size_t i = 0; i < 8; i++)
+                {
+                    hash[(4 * i) + 0] = static_cast<std::uint8_t>(words[i][lane] >> 24);
+                    hash[(4 * i) + 1] = static_cast<std::uint8_t>(words[i][lane] >> 16);
+                    hash[(4 * i) + 2] = static_cast<std::uint8_t>(words[i][lane] >> 8);
+                    hash[(4 * i) + 3] = static_cast<std::uint8_t>(words[i][lane]);
+                }
+            }
+        }
+    }
+#endif
+
+    void SHA256::ComputeHashes(std::size_t count, const std::uint8_t* const* buffers, const std::size_t* cbBuffers, std::vector<uint8_t>* hashes, Kernel kernel)
+    {
+    #if MSIX_SHA256_MULTIBUFFER
+        static const Features features = GetFeatures();
+        ThrowErrorIf(Error::NotSupported, ((kernel == Kernel::MultiBuffer) && !features.avx2), "the processor doesn't have AVX2");
+        bool useMultiBuffer = (kernel == Kernel::MultiBuffer) ||
+            ((kernel == Kernel::Default) && features.avx2 && !features.shaExtensions && (count > 1));
+        if (useMultiBuffer)
+        {   // Lanes move in step, so hash buffers of similar sizes together.
+            std::vector<std::size_t> order(count);
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return cbBuffers[a] < cbBuffers[b]; });
+
+            Lane lanes[SHA256_LANES];
+            std::vector<std::uint8_t>* laneHashes[SHA256_LANES];
+            for (std::size_t first = 0; first < count; first += SHA256_LANES)
+            {
+                std::size_t lanesUsed = std::min(SHA256_LANES, count - first);
+                for (std::size_t lane = 0; lane < lanesUsed; lane++)
+                {
+                    std::size_t index = order[first + lane];
+                    lanes[lane].Assign(buffers[index], cbBuffers[index]);
+                    laneHashes[lane] = &hashes[index];
+                }
+                HashLanes(lanes, lanesUsed, laneHashes);
+            }
+            return;
+        }
+    #else
+        ThrowErrorIf(Error::NotSupported, (kernel == Kernel::MultiBuffer), "there is no multi-buffer kernel for this processor");
+    #endif
+
+        SHA256 hasher;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            hasher.Update(buffers[i], cbBuffers[i]);
+            hasher.Finalize(hashes[i]);
+        }
+    }
+} // namespace MSIX {
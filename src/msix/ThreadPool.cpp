@@ -0,0 +1,103 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#include "Exceptions.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+namespace MSIX {
+
+    ThreadPool::ThreadPool(std::size_t concurrency) : m_concurrency(concurrency)
+    {
+        if (m_concurrency == 0) { m_concurrency = std::max(1u, std::thread::hardware_concurrency()); }
+    }
+
+    void ThreadPool::SetConcurrency(std::size_t concurrency)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        ThrowErrorIf(Error::NotSupported, !m_workers.empty(), "the thread pool has already been started");
+        m_concurrency = (concurrency == 0) ? std::max(1u, std::thread::hardware_concurrency()) : concurrency;
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {   std::lock_guard<std::mutex> lock(m_lock);
+            m_stopping = true;
+        }
+        m_workAvailable.notify_all();
+        for (auto& worker : m_workers) { worker.join(); }
+    }
+
+    void ThreadPool::ForEach(std::size_t count, const std::function<void(std::size_t)>& work)
+    {
+        if (count == 0) { return; }
+        if ((m_concurrency == 1) || (count == 1))
+        {   for (std::size_t index = 0; index < count; index++) { work(index); }
+            return;
+        }
+
+        auto job = std::make_shared<Job>(count, work);
+        {   std::lock_guard<std::mutex> lock(m_lock);
+            if (m_workers.empty()) { Start(); }
+            m_jobs.push_back(job);
+        }
+        m_workAvailable.notify_all();
+
+        Work(job);
+
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_jobCompleted.wait(lock, [&]() { return job->completed == job->count; });
+        if (job->exception) { std::rethrow_exception(job->exception); }
+    }
+
+    void ThreadPool::Start()
+    {
+        for (std::size_t i = 1; i < m_concurrency; i++)
+        {   m_workers.emplace_back([this]() { WorkerMain(); });
+        }
+    }
+
+    void ThreadPool::Work(const std::shared_ptr<Job>& job)
+    {
+        std::size_t index;
+        while ((index = job->next++) < job->count)
+        {
+            std::exception_ptr exception;
+            if (!job->failed)
+            {
+                try
+                {   job->work(index);
+                }
+                catch (...)
+                {   exception = std::current_exception();
+                    job->failed = true;
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(m_lock);
+            if (exception && !job->exception) { job->exception = exception; }
+            if (++(job->completed) == job->count) { m_jobCompleted.notify_all(); }
+        }
+
+        // Every index has been handed out, so no one else needs to pick this job up.
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto queued = std::find(m_jobs.begin(), m_jobs.end(), job);
+        if (queued != m_jobs.end()) { m_jobs.erase(queued); }
+    }
+
+    void ThreadPool::WorkerMain()
+    {
+        while (true)
+        {
+            std::shared_ptr<Job> job;
+            {   std::unique_lock<std::mutex> lock(m_lock);
+                m_workAvailable.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+                if (m_stopping) { return; }
+                job = m_jobs.front();
+            }
+            Work(job);
+        }
+    }
+}
@@ -0,0 +1,307 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#define NOMINMAX /* windows.h, or more correctly windef.h, defines min as a macro... */
+#include "Exceptions.hpp"
+#include "Inflater.hpp"
+#include "SHA256.hpp"
+#include "UnpackPipeline.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+namespace MSIX {
+
+    // How many blocks the verifier hashes together; as many as SHA256::ComputeHashes hashes side by side.
+    static const std::size_t PIPELINE_HASH_BATCH = 8;
+
+    UnpackPipeline::UnpackPipeline(const ComPtr<IStream>& archive, std::vector<File> files, const ComPtr<IStorageObject>& to) :
+        m_archive(archive), m_files(std::move(files)), m_to(to),
+        m_extents(PIPELINE_READS_QUEUED), m_inflated(PIPELINE_BLOCKS_QUEUED), m_verified(PIPELINE_BLOCKS_QUEUED),
+        m_failure(std::numeric_limits<std::uint64_t>::max())
+    {
+        m_archive->QueryInterface(UuidOfImpl<IStreamInternal>::iid, reinterpret_cast<void**>(&m_archiveInternal));
+    }
+
+    void UnpackPipeline::Run()
+    {
+        // Joins the stages that were started however Run is left. Unless the last stage ran to its end, as when a
+        // thread couldn't be started, the queues are abandoned first so that the stages running don't wait forever
+        // on the ones that aren't.
+        struct Stages
+        {
+            Stages(UnpackPipeline& pipeline) : m_pipeline(pipeline) { m_threads.reserve(3); }
+            ~Stages()
+            {
+                if (!m_finished) { m_pipeline.Abandon(); }
+                for (auto& thread : m_threads) { thread.join(); }
+            }
+
+            UnpackPipeline&          m_pipeline;
+            std::vector<std::thread> m_threads;
+            bool                     m_finished = false;
+        };
+
+        {
+            Stages stages(*this);
+            stages.m_threads.emplace_back([this]() { ReadFiles(); });
+            stages.m_threads.emplace_back([this]() { InflateFiles(); });
+            stages.m_threads.emplace_back([this]() { VerifyBlocks(); });
+            WriteBlocks();
+            stages.m_finished = true;
+        }
+        if (m_exception) { std::rethrow_exception(m_exception); }
+    }
+
+    // As with BlockMapStream, a file is made of as many of its blocks as its size calls for, and no more.
+    std::uint64_t UnpackPipeline::OutputSize(std::size_t file) const
+    {
+        const File& entry = m_files[file];
+        std::uint64_t size = entry.location.isCompressed ? entry.location.uncompressedSize : entry.location.compressedSize;
+        return std::min(size, static_cast<std::uint64_t>(entry.blocks.size()) * BLOCKMAP_BLOCK_SIZE);
+    }
+
+    // How much of the file's data in the archive there is to read.
+    std::uint64_t UnpackPipeline::DataSize(std::size_t file) const
+    {
+        return m_files[file].location.isCompressed ? m_files[file].location.compressedSize : OutputSize(file);
+    }
+
+    void UnpackPipeline::Fail(std::size_t file, std::size_t block, std::exception_ptr exception)
+    {
+        std::lock_guard<std::mutex> lock(m_failureLock);
+        if (Position(file, block) < m_failure)
+        {   m_failure = Position(file, block);
+            m_exception = exception;
+        }
+    }
+
+    void UnpackPipeline::Abandon()
+    {
+        m_extents.Abandon();
+        m_inflated.Abandon();
+        m_verified.Abandon();
+    }
+
+    // Reads the rest of a file a PIPELINE_READ_SIZE at a time or, when it's smaller than that, it together with the
+    // files that follow it in the archive for as long as they fit into one read.
+    void UnpackPipeline::ReadFiles()
+    {
+        std::size_t first = 0;
+        std::uint64_t position = 0; // in the data of the first file
+        while ((first < m_files.size()) && !Stopped(first, static_cast<std::size_t>(position / BLOCKMAP_BLOCK_SIZE)))
+        {
+            try
+            {
+                std::uint64_t start = m_files[first].location.dataOffset + position;
+                std::uint64_t end = start + std::min(DataSize(first) - position, PIPELINE_READ_SIZE);
+                std::size_t last = first + 1;
+                if ((position == 0) && (DataSize(first) <= PIPELINE_READ_SIZE))
+                {
+                    while ((last < m_files.size()) && (m_files[last].location.dataOffset >= end) &&
+                        ((m_files[last].location.dataOffset + DataSize(last) - start) <= PIPELINE_READ_SIZE))
+                    {   end = m_files[last].location.dataOffset + DataSize(last);
+                        last++;
+                    }
+                }
+
+                // Mapped archives are read in place, unless there's a stored file among what's read: its bytes are
+                // validated and written as they are, so they're copied out of the mapping first and what's written
+                // is what was validated.
+                std::size_t size = static_cast<std::size_t>(end - start);
+                std::shared_ptr<std::vector<std::uint8_t>> buffer;
+                bool stored = std::any_of(m_files.begin() + first, m_files.begin() + last, [](const File& file) { return !file.location.isCompressed; });
+                const std::uint8_t* data = (m_archiveInternal && !stored) ? m_archiveInternal->GetMappedData(start, size) : nullptr;
+                if (data == nullptr)
+                {
+                    buffer = std::make_shared<std::vector<std::uint8_t>>(size);
+                    ULONG read = StreamBase::ReadAt(m_archive.Get(), m_archiveInternal.Get(), start, buffer->data(), static_cast<ULONG>(size));
+                    ThrowErrorIf(Error::FileRead, (read != size), "read failed");
+                    data = buffer->data();
+                }
+
+                for (std::size_t file = first; file < last; file++)
+                {
+                    std::uint64_t offset = (file == first) ? position : 0;
+                    std::uint64_t from = m_files[file].location.dataOffset + offset;
+                    std::uint64_t count = (last == first + 1) ? (end - from) : DataSize(file);
+                    m_extents.Push(Extent{file, offset, data + (from - start), static_cast<std::size_t>(count), buffer});
+                }
+
+                if ((last == first + 1) && (position + (end - start) < DataSize(first)))
+                {   position += end - start;
+                }
+                else
+                {   first = last;
+                    position = 0;
+                }
+            }
+            catch (...)
+            {   Fail(first, static_cast<std::size_t>(position / BLOCKMAP_BLOCK_SIZE), std::current_exception());
+            }
+        }
+        m_extents.Close();
+    }
+
+    // Cuts stored files into blocks as they are, and inflates compressed ones a block at a time.
+    void UnpackPipeline::InflateFiles()
+    {
+        Inflater inflater;
+        std::size_t block = 0;
+        std::shared_ptr<std::vector<std::uint8_t>> output;
+        std::size_t filled = 0;
+
+        Extent extent;
+        while (m_extents.Pop(extent))
+        {
+            if (extent.offset == 0)
+            {   block = 0;
+                filled = 0;
+                if (m_files[extent.file].location.isCompressed) { inflater.Reset(); }
+            }
+            if (Stopped(extent.file, block)) { continue; }
+
+            try
+            {
+                std::uint64_t outputSize = OutputSize(extent.file);
+                if (outputSize == 0)
+                {   m_inflated.Push(Chunk{extent.file, 0, nullptr, 0, true, nullptr});
+                    continue;
+                }
+
+                auto blockSize = [&]() { return static_cast<std::size_t>(std::min(BLOCKMAP_BLOCK_SIZE, outputSize - (block * BLOCKMAP_BLOCK_SIZE))); };
+                if (!m_files[extent.file].location.isCompressed)
+                {   // Extents of a stored file start at one of its blocks.
+                    std::size_t offset = 0;
+                    while ((offset < extent.size) && !Stopped(extent.file, block))
+                    {
+                        std::size_t size = std::min(blockSize(), extent.size - offset);
+                        bool last = ((block * BLOCKMAP_BLOCK_SIZE) + size == outputSize);
+                        m_inflated.Push(Chunk{extent.file, block, extent.data + offset, size, last, extent.buffer});
+                        offset += size;
+                        block++;
+                    }
+                    continue;
+                }
+
+                const std::uint8_t* input = extent.data;
+                std::size_t inputSize = extent.size;
+                while (((block * BLOCKMAP_BLOCK_SIZE) < outputSize) && !Stopped(extent.file, block))
+                {
+                    if (!output) { output = std::make_shared<std::vector<std::uint8_t>>(static_cast<std::size_t>(BLOCKMAP_BLOCK_SIZE)); }
+                    std::uint8_t* next = output->data() + filled;
+                    std::size_t available = blockSize() - filled;
+                    std::size_t inputBefore = inputSize;
+                    std::size_t availableBefore = available;
+                    auto result = inflater.Inflate(input, inputSize, next, available);
+                    ThrowErrorIf(Error::InflateCorruptData, (result == Inflater::Result::Corrupt), "inflate failed unexpectedly.");
+                    bool progress = (inputBefore != inputSize) || (availableBefore != available);
+                    filled = blockSize() - available;
+                    if (available == 0)
+                    {
+                        bool last = ((block * BLOCKMAP_BLOCK_SIZE) + filled == outputSize);
+                        m_inflated.Push(Chunk{extent.file, block, output->data(), filled, last, output});
+                        output.reset();
+                        filled = 0;
+                        block++;
+                    }
+                    else if ((result == Inflater::Result::End) || !progress)
+                    {   break;
+                    }
+                }
+
+                // As for an InflateStream, running out of compressed data before the end of the file is a failed read.
+                bool lastExtent = (extent.offset + extent.size == DataSize(extent.file));
+                ThrowErrorIf(Error::FileRead, lastExtent && ((block * BLOCKMAP_BLOCK_SIZE) < outputSize),
+                    "Getting nothing back is unexpected here.");
+            }
+            catch (...)
+            {   Fail(extent.file, block, std::current_exception());
+            }
+        }
+        m_inflated.Close();
+    }
+
+    // Checks blocks against the blockmap, hashing several side by side when there are several waiting.
+    void UnpackPipeline::VerifyBlocks()
+    {
+        std::vector<Chunk> chunks;
+        std::vector<const std::uint8_t*> data;
+        std::vector<std::size_t> sizes;
+        std::vector<std::vector<std::uint8_t>> hashes(PIPELINE_HASH_BATCH);
+
+        Chunk chunk;
+        while (m_inflated.Pop(chunk))
+        {
+            // Blocks come in order, so if the batch can't be hashed, the first of them is the first to fail.
+            std::size_t firstFile = chunk.file;
+            std::size_t firstBlock = chunk.block;
+            try
+            {
+                chunks.clear();
+                do
+                {   if (!Stopped(chunk.file, chunk.block)) { chunks.push_back(std::move(chunk)); }
+                } while ((chunks.size() < PIPELINE_HASH_BATCH) && m_inflated.TryPop(chunk));
+
+                data.clear();
+                sizes.clear();
+                for (const auto& item : chunks)
+                {   data.push_back(item.data);
+                    sizes.push_back(item.size);
+                }
+                SHA256::ComputeHashes(chunks.size(), data.data(), sizes.data(), hashes.data());
+            }
+            catch (...)
+            {   Fail(firstFile, firstBlock, std::current_exception());
+                continue;
+            }
+
+            for (std::size_t i = 0; i < chunks.size(); i++)
+            {
+                Chunk& item = chunks[i];
+                if (Stopped(item.file, item.block)) { continue; }
+                try
+                {   if (item.size != 0)
+                    {   const auto& expected = m_files[item.file].blocks[item.block].hash;
+                        ThrowErrorIfNot(Error::SignatureInvalid,
+                            (hashes[i].size() == expected.size()) && std::equal(expected.begin(), expected.end(), hashes[i].begin()),
+                            "Signature hash doesn't match digest hash");
+                    }
+                    m_verified.Push(std::move(item));
+                }
+                catch (...)
+                {   Fail(item.file, item.block, std::current_exception());
+                }
+            }
+        }
+        m_verified.Close();
+    }
+
+    void UnpackPipeline::WriteBlocks()
+    {
+        ComPtr<IStream> target;
+        Chunk chunk;
+        while (m_verified.Pop(chunk))
+        {
+            if (Stopped(chunk.file, chunk.block)) { continue; }
+            try
+            {
+                if (chunk.block == 0) { target = m_to->OpenFile(m_files[chunk.file].targetName, FileStream::Mode::WRITE_UPDATE); }
+                std::size_t offset = 0;
+                while (offset < chunk.size)
+                {
+                    ULONG written = 0;
+                    ThrowHrIfFailed(target->Write(chunk.data + offset, static_cast<ULONG>(chunk.size - offset), &written));
+                    ThrowErrorIf(Error::FileWrite, (written == 0), "write failed");
+                    offset += written;
+                }
+                if (chunk.last) { target = ComPtr<IStream>(); }
+            }
+            catch (...)
+            {   Fail(chunk.file, chunk.block, std::current_exception());
+            }
+        }
+    }
+}
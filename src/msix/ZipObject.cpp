@@ -10,12 +10,14 @@
 #include "ZipFileStream.hpp"
 #include "InflateStream.hpp"
 #include "VectorStream.hpp"
+#include "Counters.hpp"
 
 #include <memory>
 #include <string>
 #include <limits>
 #include <functional>
 #include <algorithm>
+#include <cstring>
 namespace MSIX {
 /* Zip File Structure
 [LocalFileHeader 1]
@@ -135,6 +137,9 @@ constexpr static const GeneralPurposeBitFlags UnsupportedFlagsMask =
     GeneralPurposeBitFlags::UNSUPPORTED_14 |
     GeneralPurposeBitFlags::UNSUPPORTED_15;
 
+// the largest central directory that is read into memory in one go; larger ones are parsed straight off the stream.
+constexpr static const std::uint64_t MaximumCentralDirectoryBufferSize = 16 * 1024 * 1024; // 16MB
+
 //////////////////////////////////////////////////////////////////////////////////////////////
 //                              General Zip validation policies                             //
 //////////////////////////////////////////////////////////////////////////////////////////////
@@ -296,6 +301,7 @@ public:
             break;
         case 16:
             ThrowHrIfFailed(m_stream->Seek({0}, StreamBase::Reference::CURRENT, &pos));
+            pos.QuadPart += m_streamOffset;
             if (!GetIsZip64())
             {   ThrowErrorIf(Error::ZipCentralDirectoryHeader, (Field<16>().value >= pos.QuadPart), "invalid relative header offset");
             }
@@ -309,6 +315,7 @@ public:
             {
                 LARGE_INTEGER zero = {0};
                 ThrowHrIfFailed(m_stream->Seek(zero, StreamBase::Reference::CURRENT, &pos));
+                pos.QuadPart += m_streamOffset;
                 auto vectorStream = ComPtr<IStream>::Make<VectorStream>(&Field<18>().value);
                 m_extendedInfo = std::make_unique<Zip64ExtendedInformation>(pos, vectorStream.Get());
                 ThrowErrorIfNot(Error::ZipCentralDirectoryHeader,(Field<18>().value.size() >= m_extendedInfo->Size()),"Unexpected extended info size");
@@ -320,7 +327,8 @@ public:
         }
     }
 
-    CentralDirectoryFileHeader(bool isZip64, IStream* s) : m_isZip64(isZip64), m_stream(s)
+    // 's' is the stream the header is read from, and 'streamOffset' is where that stream starts in the archive.
+    CentralDirectoryFileHeader(bool isZip64, IStream* s, std::uint64_t streamOffset = 0) : m_isZip64(isZip64), m_stream(s), m_streamOffset(streamOffset)
     {
         ConfigureField<10>();
         ConfigureField<11>();
@@ -416,6 +424,7 @@ private:
 
     std::unique_ptr<Zip64ExtendedInformation> m_extendedInfo;
     ComPtr<IStream> m_stream;
+    std::uint64_t m_streamOffset = 0;
     bool m_isZip64 = false;
 };//class CentralDirectoryFileHeader
 
@@ -456,7 +465,7 @@ public:
         {
         case 2:
             ThrowErrorIfNot(Error::ZipLocalFileHeader, ((Field<2>().value & static_cast<std::uint16_t>(UnsupportedFlagsMask)) == 0), "unsupported flag(s) specified");
-            ThrowErrorIfNot(Error::ZipLocalFileHeader, (IsGeneralPurposeBitSet() == m_directoryEntry->IsGeneralPurposeBitSet()), "inconsistent general purpose bits specified");        
+            ThrowErrorIfNot(Error::ZipLocalFileHeader, (IsGeneralPurposeBitSet() == m_directoryEntry.isGeneralPurposeBitSet), "inconsistent general purpose bits specified");        
             break;
         case 6:
             ThrowErrorIfNot(Error::ZipLocalFileHeader, (!IsGeneralPurposeBitSet() || (Field<6>().value == 0)), "Invalid Zip CRC");
@@ -477,7 +486,7 @@ public:
         }
     }
 
-    LocalFileHeader(std::shared_ptr<CentralDirectoryFileHeader> directoryEntry) : m_isZip64(directoryEntry->GetIsZip64()), m_directoryEntry(directoryEntry)
+    LocalFileHeader(const ZipEntry& directoryEntry) : m_directoryEntry(directoryEntry)
     {
         ConfigureField<2>();
         ConfigureField<6>();
@@ -493,12 +502,16 @@ public:
     GeneralPurposeBitFlags GetGeneralPurposeBitFlags() noexcept { return static_cast<GeneralPurposeBitFlags>(Field<2>().value); }
     CompressionType GetCompressionType() noexcept { return static_cast<CompressionType>(Field<3>().value); }
 
+    // Sizes that don't fit in the 32 bit fields are 0xFFFFFFFF here and only the central directory (via its zip64
+    // extended information) has the real values.
     std::uint64_t GetCompressedSize() noexcept
-    {   return IsGeneralPurposeBitSet() ? m_directoryEntry->GetCompressedSize() : static_cast<std::uint64_t>(Field<7>().value);
+    {   return (IsGeneralPurposeBitSet() || (Field<7>().value == std::numeric_limits<std::uint32_t>::max())) ?
+            m_directoryEntry.compressedSize : static_cast<std::uint64_t>(Field<7>().value);
     }
 
     std::uint64_t GetUncompressedSize() noexcept
-    {   return IsGeneralPurposeBitSet() ? m_directoryEntry->GetUncompressedSize() : static_cast<std::uint64_t>(Field<8>().value);
+    {   return (IsGeneralPurposeBitSet() || (Field<8>().value == std::numeric_limits<std::uint32_t>::max())) ?
+            m_directoryEntry.uncompressedSize : static_cast<std::uint64_t>(Field<8>().value);
     }
 
     std::uint16_t GetFileNameLength()                  noexcept { return Field<9>().value;  }
@@ -523,8 +536,7 @@ public:
         SetFileNameLength(static_cast<std::uint16_t>(name.size()));
     }
 protected:
-    bool                                        m_isZip64        = false;
-    std::shared_ptr<CentralDirectoryFileHeader> m_directoryEntry = nullptr;
+    const ZipEntry& m_directoryEntry;
 }; //class LocalFileHeader
 
 //////////////////////////////////////////////////////////////////////////////////////////////
@@ -729,6 +741,7 @@ public:
     bool GetIsZip64()                                           noexcept { return m_isZip64; }
     std::uint64_t GetNumberOfCentralDirectoryEntries()          noexcept { return static_cast<std::uint64_t>(Field<3>().value); }
     std::uint64_t GetStartOfCentralDirectory()                  noexcept { return static_cast<std::uint64_t>(Field<6>().value); }
+    std::uint64_t GetSizeOfCentralDirectory()                   noexcept { return static_cast<std::uint64_t>(Field<5>().value); }
 
 private:
     bool m_isZip64 = false;
@@ -745,44 +758,288 @@ private:
     void SetCommentLength(std::uint16_t value)                  noexcept { Field<7>().value = value; }
 };//class EndCentralDirectoryRecord
 
+//////////////////////////////////////////////////////////////////////////////////////////////
+//                              ZipEntryTable member implementation                         //
+//////////////////////////////////////////////////////////////////////////////////////////////
+const std::uint32_t ZipEntryTable::NotFound;
+
+void ZipEntryTable::Reserve(std::size_t count)
+{
+    m_nameOffsets.reserve(count);
+    m_nameLengths.reserve(count);
+    m_localHeaderOffsets.reserve(count);
+    m_compressedSizes.reserve(count);
+    m_uncompressedSizes.reserve(count);
+    m_compressionMethods.reserve(count);
+    m_generalPurposeBits.reserve(count);
+}
+
+std::uint32_t ZipEntryTable::Add(const std::string& name, const ZipEntry& entry)
+{
+    // keep the index at most half full.
+    if ((Size() + 1) * 2 > m_index.size()) { Rehash(std::max(static_cast<std::size_t>(64), m_index.size() * 2)); }
+
+    std::size_t slot = 0;
+    std::uint32_t existing = Lookup(name.data(), name.size(), &slot);
+    if (existing != NotFound) { return existing; }
+    ThrowErrorIf(Error::ZipCentralDirectoryHeader, (m_names.size() + name.size() > std::numeric_limits<std::uint32_t>::max()), "central directory too large");
+
+    std::uint32_t index = static_cast<std::uint32_t>(Size());
+    m_nameOffsets.push_back(static_cast<std::uint32_t>(m_names.size()));
+    m_nameLengths.push_back(static_cast<std::uint16_t>(name.size()));
+    m_names.insert(m_names.end(), name.begin(), name.end());
+    m_localHeaderOffsets.push_back(entry.localHeaderOffset);
+    m_compressedSizes.push_back(entry.compressedSize);
+    m_uncompressedSizes.push_back(entry.uncompressedSize);
+    m_compressionMethods.push_back(entry.compressionMethod);
+    m_generalPurposeBits.push_back(entry.isGeneralPurposeBitSet);
+    m_index[slot] = index;
+    return index;
+}
+
+std::uint32_t ZipEntryTable::Find(const std::string& name) const
+{
+    if (m_index.empty()) { return NotFound; }
+    std::size_t slot = 0;
+    return Lookup(name.data(), name.size(), &slot);
+}
+
+ZipEntry ZipEntryTable::GetEntry(std::uint32_t index) const
+{
+    ZipEntry entry;
+    entry.localHeaderOffset      = m_localHeaderOffsets[index];
+    entry.compressedSize         = m_compressedSizes[index];
+    entry.uncompressedSize       = m_uncompressedSizes[index];
+    entry.compressionMethod      = m_compressionMethods[index];
+    entry.isGeneralPurposeBitSet = m_generalPurposeBits[index];
+    return entry;
+}
+
+// Returns the index of the entry named 'name', or NotFound with 'slot' set to the empty slot it would go in.
+std::uint32_t ZipEntryTable::Lookup(const char* name, std::size_t length, std::size_t* slot) const
+{   // FNV-1a
+    std::uint32_t hash = 2166136261u;
+    for (std::size_t i = 0; i < length; i++)
+    {
+        hash ^= static_cast<std::uint8_t>(name[i]);
+        hash *= 16777619u;
+    }
+
+    std::size_t mask = m_index.size() - 1;
+    for (*slot = hash & mask; m_index[*slot] != NotFound; *slot = (*slot + 1) & mask)
+    {
+        std::uint32_t index = m_index[*slot];
+        if ((m_nameLengths[index] == length) && (std::memcmp(&m_names[m_nameOffsets[index]], name, length) == 0))
+        {   return index;
+        }
+    }
+    return NotFound;
+}
+
+void ZipEntryTable::Rehash(std::size_t capacity)
+{
+    m_index.assign(capacity, NotFound);
+    for (std::uint32_t index = 0; index < Size(); index++)
+    {
+        std::size_t slot = 0;
+        Lookup(&m_names[m_nameOffsets[index]], m_nameLengths[index], &slot);
+        m_index[slot] = index;
+    }
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////
 //                              ZipObject member implementation                             //
 //////////////////////////////////////////////////////////////////////////////////////////////                                                          
 std::vector<std::string> ZipObject::GetFileNames(FileNameOptions)
 {
     std::vector<std::string> result;
-    std::for_each(m_streams.begin(), m_streams.end(), [&result](auto it)
+    result.reserve(m_entries.Size());
+    for (std::uint32_t index = 0; index < m_entries.Size(); index++)
     {
-        result.push_back(it.first);
-    });
+        result.push_back(m_entries.GetName(index));
+    }
+    std::sort(result.begin(), result.end());
     return result;
 }
 
 ComPtr<IStream> ZipObject::GetFile(const std::string& fileName)
-{   // TODO: Make this on-demand populate m_streams and then pull from there.
-    auto result = m_streams.find(fileName);
-    if (result == m_streams.end())
+{
+    std::uint32_t index = m_entries.Find(fileName);
+    if (index == ZipEntryTable::NotFound)
     {
         return ComPtr<IStream>();
-    }        
-    return result->second;
+    }
+
+    // Not asked for before, so go read its local file header and create the stream for it.
+    if (!m_streams[index])
+    {
+        std::vector<std::uint32_t> entries(1, index);
+        ResolveEntries(entries);
+    }
+    return m_streams[index];
+}
+
+bool ZipObject::GetFileLocation(const std::string& fileName, ZipFileLocation& location)
+{
+    std::uint32_t index = m_entries.Find(fileName);
+    if (index == ZipEntryTable::NotFound) { return false; }
+    if (!m_streams[index])
+    {
+        std::vector<std::uint32_t> entries(1, index);
+        ResolveEntries(entries);
+    }
+    location = m_locations[index];
+    return true;
+}
+
+void ZipObject::PrepareFiles()
+{   // Visit the local file headers in the order they are in the archive, so that reading them is sequential.
+    std::vector<std::uint32_t> entries;
+    for (std::uint32_t index = 0; index < m_entries.Size(); index++)
+    {
+        if (!m_streams[index]) { entries.push_back(index); }
+    }
+    std::stable_sort(entries.begin(), entries.end(), [this](std::uint32_t a, std::uint32_t b)
+    {
+        return m_entries.GetLocalHeaderOffset(a) < m_entries.GetLocalHeaderOffset(b);
+    });
+    ResolveEntries(entries);
+}
+
+bool ZipObject::SupportsConcurrentReads()
+{   // Every file's stream reads the archive positionally, which is safe from any number of threads when the archive
+    // is mapped; other streams may have to go through their seek pointer.
+    ComPtr<IStreamInternal> streamInternal;
+    if (FAILED(m_stream->QueryInterface(UuidOfImpl<IStreamInternal>::iid, reinterpret_cast<void**>(&streamInternal)))) { return false; }
+    return (streamInternal->GetMappedData(0, m_archiveSize) != nullptr);
+}
+
+// Reads and validates the local file headers of 'entries' and creates their streams. Headers are read a window
+// at a time, so neighbouring headers (e.g. those of small files) are served by the same read.
+void ZipObject::ResolveEntries(std::vector<std::uint32_t>& entries)
+{
+    static const std::uint64_t windowSize = 65536;
+    static const std::uint64_t fixedHeaderSize = 30;  // everything up to the file name
+    std::vector<std::uint8_t> window;
+    std::uint64_t windowStart = 0;
+    auto windowStream = ComPtr<IStream>::Make<VectorStream>(&window);
+
+    auto readWindow = [&](std::uint64_t offset, std::uint64_t size)
+    {
+        size = std::min(size, (offset < m_archiveSize) ? (m_archiveSize - offset) : 0);
+        window.resize(static_cast<std::size_t>(size));
+        windowStart = offset;
+        LARGE_INTEGER pos = {0};
+        pos.QuadPart = offset;
+        ThrowHrIfFailed(m_stream->Seek(pos, MSIX::StreamBase::Reference::START, nullptr));
+        ULONG bytesRead = 0;
+        ThrowHrIfFailed(m_stream->Read(window.data(), static_cast<ULONG>(size), &bytesRead));
+        window.resize(bytesRead);
+
+        Global::Counters::Increment(MSIX_COUNTER_ZIP_LOCAL_HEADER_READS);
+        if (offset < m_lastHeaderRead) { Global::Counters::Increment(MSIX_COUNTER_ZIP_LOCAL_HEADER_BACKWARD_SEEKS); }
+        m_lastHeaderRead = offset;
+    };
+
+    for (auto index : entries)
+    {
+        ZipEntry entry = m_entries.GetEntry(index);
+        std::string fileName = m_entries.GetName(index);
+        std::uint64_t offset = entry.localHeaderOffset;
+        if ((offset < windowStart) || ((offset + fixedHeaderSize) > (windowStart + window.size())))
+        {   readWindow(offset, windowSize);
+        }
+        std::size_t position = static_cast<std::size_t>(offset - windowStart);
+        if ((position + fixedHeaderSize) <= window.size())
+        {   // file name and extra field lengths are the last two fields of the fixed part of the header.
+            std::uint64_t headerSize = fixedHeaderSize +
+                (window[position + 26] | (window[position + 27] << 8)) + (window[position + 28] | (window[position + 29] << 8));
+            if ((position + headerSize) > window.size())
+            {   readWindow(offset, headerSize);
+                position = 0;
+            }
+        }
+
+        LARGE_INTEGER pos = {0};
+        pos.QuadPart = position;
+        ThrowHrIfFailed(windowStream->Seek(pos, MSIX::StreamBase::Reference::START, nullptr));
+        LocalFileHeader localFileHeader(entry);
+        localFileHeader.Read(windowStream.Get());
+        Global::Counters::Increment(MSIX_COUNTER_ZIP_LOCAL_HEADERS);
+
+        ZipFileLocation& location = m_locations[index];
+        location.name             = std::move(fileName);
+        location.dataOffset       = offset + localFileHeader.Size();
+        location.compressedSize   = localFileHeader.GetCompressedSize();
+        location.uncompressedSize = localFileHeader.GetUncompressedSize();
+        location.isCompressed     = localFileHeader.GetCompressionType() == CompressionType::Deflate;
+        m_streams[index] = CreateFileStream(location);
+    }
+}
+
+ComPtr<IStream> ZipObject::CreateFileStream(const ZipFileLocation& location)
+{
+    auto fileStream = ComPtr<IStream>::Make<ZipFileStream>(
+        location.name,
+        "TODO: Implement", // TODO: put value from content type 
+        m_factory,
+        location.isCompressed,
+        location.dataOffset,
+        location.compressedSize,
+        m_stream
+        );
+
+    if (location.isCompressed)
+    {
+        fileStream = ComPtr<IStream>::Make<InflateStream>(fileStream.Get(), location.uncompressedSize);
+    }
+    return fileStream;
+}
+
+std::vector<ZipFileLocation> ZipObject::GetFileLocations()
+{
+    PrepareFiles();
+    return m_locations;
+}
+
+ZipObject::ZipObject(IMSIXFactory* appxFactory, const ComPtr<IStream>& stream, const std::vector<ZipFileLocation>& files) :
+    m_factory(appxFactory), m_stream(stream)
+{
+    m_entries.Reserve(files.size());
+    for (const auto& location : files)
+    {   // only the local file headers need what's in the central directory, and they have been validated already.
+        ZipEntry entry;
+        entry.localHeaderOffset      = 0;
+        entry.compressedSize         = location.compressedSize;
+        entry.uncompressedSize       = location.uncompressedSize;
+        entry.isGeneralPurposeBitSet = false;
+        entry.compressionMethod      = static_cast<std::uint16_t>(location.isCompressed ? CompressionType::Deflate : CompressionType::Store);
+        std::uint32_t index = m_entries.Add(location.name, entry);
+        ThrowErrorIf(Error::Unexpected, (index != m_streams.size()), "duplicate file location");
+        m_streams.push_back(CreateFileStream(location));
+        m_locations.push_back(location);
+    }
 }
 
 ZipObject::ZipObject(IMSIXFactory* appxFactory, const ComPtr<IStream>& stream) : m_factory(appxFactory), m_stream(stream)
 {   // Confirm that the file IS the correct format
     EndCentralDirectoryRecord endCentralDirectoryRecord;
     LARGE_INTEGER pos = {0};
+    ULARGE_INTEGER offsetEndOfCD = {0};
     pos.QuadPart = -1 * endCentralDirectoryRecord.Size();
-    ThrowHrIfFailed(m_stream->Seek(pos, StreamBase::Reference::END, nullptr));
+    ThrowHrIfFailed(m_stream->Seek(pos, StreamBase::Reference::END, &offsetEndOfCD));
     endCentralDirectoryRecord.Read(m_stream.Get());
+    m_archiveSize = offsetEndOfCD.QuadPart + endCentralDirectoryRecord.Size();
 
     // find where the zip central directory exists.
     std::uint64_t offsetStartOfCD = 0;
+    std::uint64_t sizeOfCD = 0;
     std::uint64_t totalNumberOfEntries = 0;
     Zip64EndOfCentralDirectoryLocator zip64Locator(m_stream.Get());        
     if (!endCentralDirectoryRecord.GetArchiveHasZip64Locator())
     {
         offsetStartOfCD      = endCentralDirectoryRecord.GetStartOfCentralDirectory();
+        sizeOfCD             = endCentralDirectoryRecord.GetSizeOfCentralDirectory();
         totalNumberOfEntries = endCentralDirectoryRecord.GetNumberOfCentralDirectoryEntries();
     }
     else
@@ -797,53 +1054,60 @@ ZipObject::ZipObject(IMSIXFactory* appxFactory, const ComPtr<IStream>& stream) :
         ThrowHrIfFailed(m_stream->Seek(pos, StreamBase::Reference::START, nullptr));
         zip64EndOfCentralDirectory.Read(m_stream.Get());            
         offsetStartOfCD = zip64EndOfCentralDirectory.GetOffsetStartOfCD();
+        sizeOfCD = zip64EndOfCentralDirectory.GetSizeOfCD();
         totalNumberOfEntries = zip64EndOfCentralDirectory.GetTotalNumberOfEntries();
+        offsetEndOfCD.QuadPart = zip64Locator.GetRelativeOffset();
     }
 
-    // read the zip central directory
-    std::map<std::string, std::shared_ptr<CentralDirectoryFileHeader>> centralDirectory;
+    // read the zip central directory, keeping only what is needed to get to each file later on. Everything from
+    // the start of the directory up to the end of central directory record(s) is read in one go, and the headers
+    // are parsed from memory. Where the directory starts comes from the package and isn't checked yet, so this is
+    // only done when the span is no bigger than the size recorded for the directory, nor than
+    // MaximumCentralDirectoryBufferSize. Otherwise the headers are parsed straight off the stream, which reports
+    // whatever is wrong with them.
+    std::vector<std::uint8_t> centralDirectoryBuffer;
+    ComPtr<IStream> centralDirectory = m_stream;
+    std::uint64_t centralDirectoryOffset = 0;
     pos.QuadPart = offsetStartOfCD;
     ThrowHrIfFailed(m_stream->Seek(pos, StreamBase::Reference::START, nullptr));
+    if ((offsetStartOfCD < offsetEndOfCD.QuadPart) &&
+        ((offsetEndOfCD.QuadPart - offsetStartOfCD) <= std::min(sizeOfCD, MaximumCentralDirectoryBufferSize)))
+    {
+        std::uint64_t bufferSize = offsetEndOfCD.QuadPart - offsetStartOfCD;
+        centralDirectoryBuffer.resize(static_cast<std::size_t>(bufferSize));
+        ULONG bytesRead = 0;
+        ThrowHrIfFailed(m_stream->Read(centralDirectoryBuffer.data(), static_cast<ULONG>(bufferSize), &bytesRead));
+        ThrowErrorIfNot(Error::FileRead, (bytesRead == bufferSize), "failed to read the central directory");
+        centralDirectory = ComPtr<IStream>::Make<VectorStream>(&centralDirectoryBuffer);
+        centralDirectoryOffset = offsetStartOfCD;
+    }
+
+    if (!centralDirectoryBuffer.empty())
+    {   // the smallest possible header is 46 bytes, which bounds how many entries there can actually be.
+        m_entries.Reserve(static_cast<std::size_t>(std::min(totalNumberOfEntries, static_cast<std::uint64_t>(centralDirectoryBuffer.size() / 46))));
+    }
     for (std::uint32_t index = 0; index < totalNumberOfEntries; index++)
     {
-        auto centralFileHeader = std::make_shared<CentralDirectoryFileHeader>(endCentralDirectoryRecord.GetIsZip64(), m_stream.Get());
-        centralFileHeader->Read(m_stream.Get());
+        CentralDirectoryFileHeader centralFileHeader(endCentralDirectoryRecord.GetIsZip64(), centralDirectory.Get(), centralDirectoryOffset);
+        centralFileHeader.Read(centralDirectory.Get());
+        ZipEntry entry;
+        entry.localHeaderOffset      = centralFileHeader.GetRelativeOffsetOfLocalHeader();
+        entry.compressedSize         = centralFileHeader.GetCompressedSize();
+        entry.uncompressedSize       = centralFileHeader.GetUncompressedSize();
+        entry.isGeneralPurposeBitSet = centralFileHeader.IsGeneralPurposeBitSet();
+        entry.compressionMethod      = centralFileHeader.GetCompressionMethod();
         // TODO: ensure that there are no collisions on name!
-        centralDirectory.insert(std::make_pair(centralFileHeader->GetFileName(), centralFileHeader));
+        m_entries.Add(centralFileHeader.GetFileName(), entry);
     }
+    m_streams.resize(m_entries.Size());
+    m_locations.resize(m_entries.Size());
 
     if (endCentralDirectoryRecord.GetArchiveHasZip64Locator())
     {   // We should have no data between the end of the last central directory header and the start of the EoCD
         ULARGE_INTEGER uPos = {0};
-        ThrowHrIfFailed(m_stream->Seek({0}, StreamBase::Reference::CURRENT, &uPos));
+        ThrowHrIfFailed(centralDirectory->Seek({0}, StreamBase::Reference::CURRENT, &uPos));
+        uPos.QuadPart += centralDirectoryOffset;
         ThrowErrorIfNot(Error::ZipHiddenData, (uPos.QuadPart == zip64Locator.GetRelativeOffset()), "hidden data unsupported");
     }
-
-    // TODO: change population of m_streams into cache semantics and move into ZipObject::GetFile
-    // Read the file repository
-    for (const auto& centralFileHeader : centralDirectory)
-    {
-        pos.QuadPart = centralFileHeader.second->GetRelativeOffsetOfLocalHeader();
-        ThrowHrIfFailed(m_stream->Seek(pos, MSIX::StreamBase::Reference::START, nullptr));
-        auto localFileHeader = std::make_shared<LocalFileHeader>(centralFileHeader.second);
-        localFileHeader->Read(m_stream.Get());
-
-        auto fileStream = ComPtr<IStream>::Make<ZipFileStream>(
-            centralFileHeader.second->GetFileName(),
-            "TODO: Implement", // TODO: put value from content type 
-            m_factory,
-            localFileHeader->GetCompressionType() == CompressionType::Deflate,
-            centralFileHeader.second->GetRelativeOffsetOfLocalHeader() + localFileHeader->Size(),
-            localFileHeader->GetCompressedSize(),                
-            m_stream
-            );
-
-        if (localFileHeader->GetCompressionType() == CompressionType::Deflate)
-        {
-            fileStream = ComPtr<IStream>::Make<InflateStream>(fileStream.Get(), localFileHeader->GetUncompressedSize());
-        }
-
-        m_streams.insert(std::make_pair(centralFileHeader.second->GetFileName(), std::move(fileStream)));
-    }
 } // ZipObject::ZipObject
 } // namespace MSIX
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "Exceptions.hpp"
 #include "StreamBase.hpp"
 #include "FileStream.hpp"
+#include "MappedFileStream.hpp"
 #include "RangeStream.hpp"
 #include "ZipObject.hpp"
 #include "DirectoryObject.hpp"
@@ -14,6 +15,7 @@
 #include "AppxPackageObject.hpp"
 #include "AppxFactory.hpp"
 #include "Log.hpp"
+#include "Counters.hpp"
 
 #include <string>
 #include <memory>
@@ -70,6 +72,25 @@ MSIX_API HRESULT STDMETHODCALLTYPE UnpackPackage(
     return static_cast<HRESULT>(MSIX::Error::OK);
 } CATCH_RETURN();
 
+MSIX_API HRESULT STDMETHODCALLTYPE VerifyPackage(
+    MSIX_VALIDATION_OPTION validationOption,
+    char* utf8SourcePackage,
+    MSIX_VERIFY_FILE_CALLBACK* callback,
+    void* context) noexcept try
+{
+    ThrowErrorIf(MSIX::Error::InvalidParameter, (utf8SourcePackage == nullptr), "Invalid parameters");
+
+    MSIX::ComPtr<IAppxFactory> factory;
+    ThrowHrIfFailed(CoCreateAppxFactoryWithHeap(InternalAllocate, InternalFree, validationOption, &factory));
+
+    MSIX::ComPtr<IStream> stream;
+    ThrowHrIfFailed(CreateStreamOnFile(utf8SourcePackage, true, &stream));
+
+    MSIX::ComPtr<IAppxPackageReader> reader;
+    ThrowHrIfFailed(factory->CreatePackageReader(stream.Get(), &reader));
+    return reader.As<IMsixPackageVerifier>()->VerifyPayloadFiles(callback, context);
+} CATCH_RETURN();
+
 MSIX_API HRESULT STDMETHODCALLTYPE GetLogTextUTF8(COTASKMEMALLOC* memalloc, char** logText) noexcept try
 {
     ThrowErrorIf(MSIX::Error::InvalidParameter, (logText == nullptr || *logText != nullptr), "bad pointer" );
@@ -84,13 +105,33 @@ MSIX_API HRESULT STDMETHODCALLTYPE GetLogTextUTF8(COTASKMEMALLOC* memalloc, char
     return static_cast<HRESULT>(MSIX::Error::OK);
 } CATCH_RETURN();
 
+MSIX_API HRESULT STDMETHODCALLTYPE GetCounter(MSIX_COUNTER counter, UINT64* value) noexcept try
+{
+    ThrowErrorIf(MSIX::Error::InvalidParameter, (value == nullptr), "bad pointer");
+    *value = MSIX::Global::Counters::Get(counter);
+    return static_cast<HRESULT>(MSIX::Error::OK);
+} CATCH_RETURN();
+
 MSIX_API HRESULT STDMETHODCALLTYPE CreateStreamOnFile(
     char* utf8File,
     bool forRead,
     IStream** stream) noexcept try
 {
-    MSIX::FileStream::Mode mode = forRead ? MSIX::FileStream::Mode::READ : MSIX::FileStream::Mode::WRITE_UPDATE;
-    *stream = MSIX::ComPtr<IStream>::Make<MSIX::FileStream>(utf8File, mode).Detach();
+    if (forRead)
+    {   // Packages are only ever read, so map them and let the stream stack consume the mapped bytes directly. Those
+        // that are too large to map, or can't be for any other reason, are read through the file system instead.
+        auto mapped = MSIX::ComPtr<MSIX::MappedFileStream>::Make<MSIX::MappedFileStream>(utf8File);
+        if (mapped->IsMapped())
+        {   *stream = mapped.As<IStream>().Detach();
+        }
+        else
+        {   mapped->Close();
+            *stream = MSIX::ComPtr<IStream>::Make<MSIX::FileStream>(utf8File, MSIX::FileStream::Mode::READ).Detach();
+        }
+    }
+    else
+    {   *stream = MSIX::ComPtr<IStream>::Make<MSIX::FileStream>(utf8File, MSIX::FileStream::Mode::WRITE_UPDATE).Detach();
+    }
     return static_cast<HRESULT>(MSIX::Error::OK);
 } CATCH_RETURN();
 
@@ -99,9 +140,8 @@ MSIX_API HRESULT STDMETHODCALLTYPE CreateStreamOnFileUTF16(
     bool forRead,
     IStream** stream) noexcept try
 {
-    MSIX::FileStream::Mode mode = forRead ? MSIX::FileStream::Mode::READ : MSIX::FileStream::Mode::WRITE_UPDATE;
-    *stream = MSIX::ComPtr<IStream>::Make<MSIX::FileStream>(MSIX::utf16_to_utf8(utf16File), mode).Detach();
-    return static_cast<HRESULT>(MSIX::Error::OK);
+    std::string utf8File = MSIX::utf16_to_utf8(utf16File);
+    return CreateStreamOnFile(const_cast<char*>(utf8File.c_str()), forRead, stream);
 } CATCH_RETURN();
 
 MSIX_API HRESULT STDMETHODCALLTYPE CoCreateAppxFactoryWithHeap(
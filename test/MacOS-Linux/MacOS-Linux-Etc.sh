@@ -47,10 +47,78 @@ function RunTest {
     fi
 }
 
+function RunVerifyTest {
+    local SUCCESS="$1"
+    local PACKAGE="$2"
+    local ARGS="$3"
+    echo "------------------------------------------------------"
+    echo $BINDIR/makemsix verify -p $PACKAGE $ARGS
+    echo "------------------------------------------------------"
+    $BINDIR/makemsix verify -p $PACKAGE $ARGS
+    local RESULT=$?
+    echo "expect: "$SUCCESS", got: "$RESULT
+    if [ $RESULT -eq $SUCCESS ]
+    then
+        echo "succeeded" 
+    else
+        echo "FAILED"
+        TESTFAILED=1
+    fi
+}
+
+# Unpacks PACKAGE with ARGS and fails when that doesn't unpack the same files as going without ARGS does.
+function RunCompareTest {
+    local PACKAGE="$1"
+    local ARGS="$2"
+    local EXTRAARGS="$3"
+    rm -f -r ./../unpack-expected
+    $BINDIR/makemsix unpack -d ./../unpack-expected -p $PACKAGE $ARGS > /dev/null
+    RunTest 0 $PACKAGE "$ARGS $EXTRAARGS"
+    echo "compare with: "$BINDIR/makemsix unpack -d ./../unpack-expected -p $PACKAGE $ARGS
+    if diff -r ./../unpack-expected ./../unpack
+    then
+        echo "succeeded"
+    else
+        echo "FAILED"
+        TESTFAILED=1
+    fi
+    rm -f -r ./../unpack-expected
+}
+
+# Copies PACKAGE into ./../tampered, where tests are free to change it.
+function CopyPackage {
+    mkdir -p ./../tampered
+    cp -p "$1" ./../tampered/
+}
+
+# Overwrites the byte at OFFSET in PACKAGE without changing the package's modification time.
+function TamperPackage {
+    local PACKAGE="$1"
+    local OFFSET="$2"
+    touch -r $PACKAGE ./../tampered/timestamp
+    printf '\x55' | dd of=$PACKAGE bs=1 seek=$OFFSET conv=notrunc 2> /dev/null
+    touch -r ./../tampered/timestamp $PACKAGE
+}
+
+# Fails unless CONDITION, a test expression, holds.
+function Check {
+    local DESCRIPTION="$1"
+    shift
+    echo "check: "$DESCRIPTION
+    if [ "$@" ]
+    then
+        echo "succeeded"
+    else
+        echo "FAILED"
+        TESTFAILED=1
+    fi
+}
+
 FindBinFolder
 # return code is last two digits, but in decimal, not hex.  e.g. 0x8bad0002 == 2, 0x8bad0041 == 65, etc...
 # common codes:
 # SignatureInvalid        = ERROR_FACILITY + 0x0041 == 65
+# InflateCorruptData      = ERROR_FACILITY + 0x0023 == 35
 
 RunTest 2  ./../appx/Empty.appx -sv
 RunTest 0  ./../appx/HelloWorld.appx -ss
@@ -59,12 +127,14 @@ RunTest 66 ./../appx/SignedTamperedBlockMap-TRUST_E_BAD_DIGEST.appx
 RunTest 65 ./../appx/SignedTamperedBlockMap-TRUST_E_BAD_DIGEST.appx -sv
 RunTest 66 ./../appx/SignedTamperedCD-TRUST_E_BAD_DIGEST.appx
 RunTest 66 ./../appx/SignedTamperedCodeIntegrity-TRUST_E_BAD_DIGEST.appx
+RunTest 65 ./../appx/SignedTamperedCodeIntegrity-TRUST_E_BAD_DIGEST.appx -sv
 RunTest 66 ./../appx/SignedTamperedContentTypes-TRUST_E_BAD_DIGEST.appx
 RunTest 66 ./../appx/SignedUntrustedCert-CERT_E_CHAINING.appx
 RunTest 0  ./../appx/StoreSigned_Desktop_x64_MoviesTV.appx
 RunTest 0 ./../appx/TestAppxPackage_Win32.appx -ss
 RunTest 0 ./../appx/TestAppxPackage_x64.appx -ss
 RunTest 18 ./../appx/UnsignedZip64WithCI-APPX_E_MISSING_REQUIRED_FILE.appx
+RunTest 0 ./../appx/UnsignedZip64MultiBlock.appx -ss
 RunTest 1 ./../appx/FileDoesNotExist.appx -ss
 RunTest 81 ./../appx/BlockMap/Missing_Manifest_in_blockmap.appx -ss
 RunTest 81 ./../appx/BlockMap/ContentTypes_in_blockmap.appx -ss
@@ -76,6 +146,58 @@ RunTest 81 ./../appx/BlockMap/File_missing_from_blockmap.appx -ss
 RunTest 51 ./../appx/BlockMap/No_blockmap.appx -ss
 RunTest 3 ./../appx/BlockMap/Bad_Namespace_Blockmap.appx -ss
 RunTest 81 ./../appx/BlockMap/Duplicate_file_in_blockmap.appx -ss
+# the first run writes the package's index, the second one opens the package from it rather than write it again
+CopyPackage ./../appx/UnsignedZip64MultiBlock.appx
+INDEXED=./../tampered/UnsignedZip64MultiBlock.appx
+RunCompareTest $INDEXED -ss -pi
+Check "index written" -e $INDEXED.msixindex
+touch -t 200001010000 $INDEXED.msixindex
+RunCompareTest $INDEXED -ss -pi
+Check "index used" ! $INDEXED.msixindex -nt $INDEXED
+# files changed behind the index's back are still caught: a payload file, at an offset in the stored rand.bin,
+# and a footprint file, at one in AppxManifest.xml
+TamperPackage $INDEXED 100000
+RunTest 65 $INDEXED "-ss -pi"
+CopyPackage ./../appx/UnsignedZip64MultiBlock.appx
+RunTest 0 $INDEXED "-ss -pi"
+TamperPackage $INDEXED 305650
+RunTest 65 $INDEXED "-ss -pi"
+rm -f -r ./../tampered
+# extracting on several threads writes the same files, and still catches a payload file that doesn't match its blocks
+RunCompareTest ./../appx/UnsignedZip64MultiBlock.appx -ss -mt
+RunCompareTest ./../appx/HelloWorld.appx -ss -mt
+CopyPackage ./../appx/UnsignedZip64MultiBlock.appx
+TamperPackage ./../tampered/UnsignedZip64MultiBlock.appx 100000
+RunTest 65 ./../tampered/UnsignedZip64MultiBlock.appx "-ss -mt"
+rm -f -r ./../tampered
+# so does extracting through the pipeline. A block that doesn't match fails in the verifier stage. With data that
+# doesn't inflate in big.txt as well, the inflater's failure comes first in the files, and it's the one reported.
+RunCompareTest ./../appx/UnsignedZip64MultiBlock.appx -ss -pl
+RunCompareTest ./../appx/HelloWorld.appx -ss -pl
+CopyPackage ./../appx/UnsignedZip64MultiBlock.appx
+TamperPackage ./../tampered/UnsignedZip64MultiBlock.appx 100000
+RunTest 65 ./../tampered/UnsignedZip64MultiBlock.appx "-ss -pl"
+TamperPackage ./../tampered/UnsignedZip64MultiBlock.appx 60
+RunTest 35 ./../tampered/UnsignedZip64MultiBlock.appx "-ss -pl"
+rm -f -r ./../tampered
+# verify reads every payload file without extracting any
+RunVerifyTest 0 ./../appx/HelloWorld.appx -ss
+RunVerifyTest 0 ./../appx/UnsignedZip64MultiBlock.appx -ss
+RunVerifyTest 65 ./../appx/SignedTamperedBlockMap-TRUST_E_BAD_DIGEST.appx -sv
+RunVerifyTest 81 ./../appx/BlockMap/Invalid_Bad_Block.appx -ss
+RunVerifyTest 81 ./../appx/BlockMap/Size_wrong_uncompressed.appx -ss
+# what the public API offers beyond unpacking
+echo "------------------------------------------------------"
+echo $BINDIR/ApiTests ./../appx
+echo "------------------------------------------------------"
+$BINDIR/ApiTests ./../appx
+Check "API tests passed" $? -eq 0
+# every way of hashing several buffers at once gives the same digests
+echo "------------------------------------------------------"
+echo $BINDIR/SHA256Tests
+echo "------------------------------------------------------"
+$BINDIR/SHA256Tests
+Check "SHA256 tests passed" $? -eq 0
 
     echo "-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-="
 if [ $TESTFAILED -ne 0 ]
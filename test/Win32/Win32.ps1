@@ -66,6 +66,28 @@ function RunTest([int] $SUCCESSCODE, [string] $PACKAGE, [string] $OPT) {
     }
 }
 
+function RunVerifyTest([int] $SUCCESSCODE, [string] $PACKAGE, [string] $OPT) {
+    $OPTIONS = "verify -p $PACKAGE $OPT"
+    write-host  "------------------------------------------------------"
+    write-host  "$BINDIR\makemsix.exe $OPTIONS"
+    write-host  "------------------------------------------------------"
+
+    $p = Start-Process $BINDIR\makemsix.exe -ArgumentList "$OPTIONS" -wait -NoNewWindow -PassThru
+    $ERRORCODE = $p.ExitCode
+    $a = "{0:x0}" -f $SUCCESSCODE
+    $b = "{0:x0}" -f $ERRORCODE
+    write-host  "expect: $a, got: $b"
+    if ( $ERRORCODE -eq $SUCCESSCODE ) 
+    {
+        write-host  "succeeded"
+    }
+    else
+    {
+        write-host  "FAILED"
+        $global:TESTFAILED=1    
+    }
+}
+
 FindBinFolder
 RunTest 0x8bad0002 .\..\appx\Empty.appx "-sv"
 RunTest 0x00000000 .\..\appx\HelloWorld.appx "-ss"
@@ -81,6 +103,7 @@ RunTest 0x00000000 .\..\appx\StoreSigned_Desktop_x64_MoviesTV.appx
 RunTest 0x00000000 .\..\appx\TestAppxPackage_Win32.appx "-ss"
 RunTest 0x00000000 .\..\appx\TestAppxPackage_x64.appx "-ss"
 RunTest 0x8bad0012 .\..\appx\UnsignedZip64WithCI-APPX_E_MISSING_REQUIRED_FILE.appx
+RunTest 0x00000000 .\..\appx\UnsignedZip64MultiBlock.appx "-ss"
 RunTest 0x8bad0001 .\..\appx\FileDoesNotExist.appx "-ss"
 RunTest 0x8bad0051 .\..\appx\BlockMap\Missing_Manifest_in_blockmap.appx "-ss"
 RunTest 0x8bad0051 .\..\appx\BlockMap\ContentTypes_in_blockmap.appx "-ss"
@@ -92,6 +115,15 @@ RunTest 0x8bad0051 .\..\appx\BlockMap\ContentTypes_in_blockmap.appx "-ss"
 RunTest 0x8bad0033 .\..\appx\BlockMap\No_blockmap.appx "-ss"
 RunTest 0x8bad1003 .\..\appx\BlockMap\Bad_Namespace_Blockmap.appx "-ss"
 RunTest 0x8bad0051 .\..\appx\BlockMap\Duplicate_file_in_blockmap.appx "-ss"
+# the first run writes the package's index, the second one opens the package from it
+Remove-Item .\..\appx\HelloWorld.appx.msixindex -ErrorAction SilentlyContinue
+RunTest 0 .\..\appx\HelloWorld.appx "-ss -pi"
+RunTest 0 .\..\appx\HelloWorld.appx "-ss -pi"
+Remove-Item .\..\appx\HelloWorld.appx.msixindex -ErrorAction SilentlyContinue
+# verify reads every payload file without extracting any
+RunVerifyTest 0x00000000 .\..\appx\HelloWorld.appx "-ss"
+RunVerifyTest 0x00000000 .\..\appx\UnsignedZip64MultiBlock.appx "-ss"
+RunVerifyTest 0x8bad0041 .\..\appx\SignedTamperedBlockMap-TRUST_E_BAD_DIGEST.appx "-sv"
 
 CleanupUnpackFolder
 
@@ -0,0 +1,266 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+// Tests of what the public API offers beyond unpacking, which makemsix doesn't reach: reading payload and footprint
+// files through their streams, and the factory's concurrency. Takes the directory that holds the test packages, and
+// returns how many tests failed.
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "AppxPackaging.hpp"
+#include "MSIXWindows.hpp"
+
+// Stripped down ComPtr provided for those platforms that do not already have a ComPtr class.
+template <class T>
+class ComPtr
+{
+public:
+    ComPtr() = default;
+    ~ComPtr() { InternalRelease(); }
+    inline T* operator->() const { return m_ptr; }
+    inline T* Get() const { return m_ptr; }
+
+    inline T** operator&()
+    {   InternalRelease();
+        return &m_ptr;
+    }
+
+protected:
+    T* m_ptr = nullptr;
+
+    inline void InternalRelease()
+    {
+        T* temp = m_ptr;
+        if (temp)
+        {   m_ptr = nullptr;
+            temp->Release();
+        }
+    }
+};
+
+LPVOID STDMETHODCALLTYPE MyAllocate(SIZE_T cb)  { return std::malloc(cb); }
+void STDMETHODCALLTYPE MyFree(LPVOID pv)        { std::free(pv); }
+
+const UINT64 BlockSize = 65536; // of the blocks in a blockmap
+const UINT64 ParallelInflateMinimumSize = 16 * BlockSize; // of the compressed files that are inflated on several threads
+const HRESULT ReadFailed = static_cast<HRESULT>(0x8BAD0003); // the SDK's own error for short reads
+const HRESULT SignatureInvalid = static_cast<HRESULT>(0x8BAD0041);
+
+static int failures = 0;
+
+static void Report(bool passed, const char* test, const std::string& package)
+{
+    std::printf("%s %s: %s\n", passed ? "PASS" : "FAILED", test, package.c_str());
+    if (!passed) { failures++; }
+}
+
+static HRESULT OpenPackage(IAppxFactory* factory, const std::string& path, IAppxPackageReader** package)
+{
+    ComPtr<IStream> inputStream;
+    HRESULT hr = CreateStreamOnFile(const_cast<char*>(path.c_str()), true, &inputStream);
+    if (SUCCEEDED(hr)) { hr = factory->CreatePackageReader(inputStream.Get(), package); }
+    return hr;
+}
+
+// Reads 'count' bytes from where 'stream' is.
+static HRESULT Read(IStream* stream, UINT64 count, std::vector<std::uint8_t>& data)
+{
+    data.resize(static_cast<std::size_t>(count));
+    ULONG read = 0;
+    HRESULT hr = stream->Read(data.data(), static_cast<ULONG>(count), &read);
+    if (SUCCEEDED(hr) && (read != count)) { hr = ReadFailed; }
+    return hr;
+}
+
+// Seeking into the middle of a compressed payload file starts inflating at the block the seek lands in. Reads every
+// compressed file of the package that spans several blocks from the start, and checks that reads from all over
+// each of them, in no particular order and through a package opened separately, read the same bytes.
+static void SeekIntoCompressedFiles(const std::string& path)
+{
+    ComPtr<IAppxFactory> factory;
+    ComPtr<IAppxPackageReader> sequentialPackage;
+    ComPtr<IAppxPackageReader> seekingPackage;
+    ComPtr<IAppxFilesEnumerator> sequentialFiles;
+    ComPtr<IAppxFilesEnumerator> seekingFiles;
+    HRESULT hr = CoCreateAppxFactoryWithHeap(MyAllocate, MyFree, MSIX_VALIDATION_OPTION_SKIPSIGNATURE, &factory);
+    if (SUCCEEDED(hr)) { hr = OpenPackage(factory.Get(), path, &sequentialPackage); }
+    if (SUCCEEDED(hr)) { hr = OpenPackage(factory.Get(), path, &seekingPackage); }
+    if (SUCCEEDED(hr)) { hr = sequentialPackage->GetPayloadFiles(&sequentialFiles); }
+    if (SUCCEEDED(hr)) { hr = seekingPackage->GetPayloadFiles(&seekingFiles); }
+
+    int tested = 0;
+    bool same = true;
+    BOOL hasCurrent = FALSE;
+    if (SUCCEEDED(hr)) { hr = sequentialFiles->GetHasCurrent(&hasCurrent); }
+    while (SUCCEEDED(hr) && same && hasCurrent)
+    {
+        ComPtr<IAppxFile> sequentialFile;
+        ComPtr<IAppxFile> seekingFile;
+        ComPtr<IStream> sequentialStream;
+        ComPtr<IStream> seekingStream;
+        APPX_COMPRESSION_OPTION compression = APPX_COMPRESSION_OPTION_NONE;
+        UINT64 size = 0;
+        hr = sequentialFiles->GetCurrent(&sequentialFile);
+        if (SUCCEEDED(hr)) { hr = seekingFiles->GetCurrent(&seekingFile); }
+        if (SUCCEEDED(hr)) { hr = sequentialFile->GetCompressionOption(&compression); }
+        if (SUCCEEDED(hr)) { hr = sequentialFile->GetSize(&size); }
+        if (SUCCEEDED(hr) && (compression != APPX_COMPRESSION_OPTION_NONE) && (size > BlockSize))
+        {
+            std::vector<std::uint8_t> expected;
+            hr = sequentialFile->GetStream(&sequentialStream);
+            if (SUCCEEDED(hr)) { hr = Read(sequentialStream.Get(), size, expected); }
+            if (SUCCEEDED(hr)) { hr = seekingFile->GetStream(&seekingStream); }
+
+            const UINT64 offsets[] = { size / 2, BlockSize, BlockSize - 7, size - 3, (3 * BlockSize) + 1, 1, 0, size / 3 };
+            for (auto offset : offsets)
+            {
+                if (FAILED(hr) || !same) { break; }
+                if (offset >= size) { continue; }
+                LARGE_INTEGER move = { 0 };
+                move.QuadPart = static_cast<LONGLONG>(offset);
+                std::vector<std::uint8_t> actual;
+                hr = seekingStream->Seek(move, STREAM_SEEK_SET, nullptr);
+                if (SUCCEEDED(hr)) { hr = Read(seekingStream.Get(), std::min(size - offset, static_cast<UINT64>(10000)), actual); }
+                same = SUCCEEDED(hr) && std::equal(actual.begin(), actual.end(), expected.begin() + static_cast<std::size_t>(offset));
+            }
+            tested++;
+        }
+        if (SUCCEEDED(hr)) { hr = sequentialFiles->MoveNext(&hasCurrent); }
+        if (SUCCEEDED(hr)) { hr = seekingFiles->MoveNext(&hasCurrent); }
+    }
+    Report(SUCCEEDED(hr) && same && (tested > 0), "SeekIntoCompressedFiles", path);
+}
+
+// Reads the file at 'path' into 'data'.
+static bool ReadFile(const char* path, std::vector<std::uint8_t>& data)
+{
+    FILE* file = std::fopen(path, "rb");
+    if (file == nullptr) { return false; }
+    std::uint8_t buffer[65536];
+    std::size_t read = 0;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file)) != 0) { data.insert(data.end(), buffer, buffer + read); }
+    bool failed = (std::ferror(file) != 0);
+    std::fclose(file);
+    return !failed;
+}
+
+// With more than one thread, copying a large compressed payload file inflates its blocks on several threads at
+// once. Copies every such file of the package from a factory with four threads, and checks that that counts blocks
+// inflated in parallel and copies the same bytes as reading the file through a factory with one thread does.
+static void InflateInParallel(const std::string& path)
+{
+    ComPtr<IAppxFactory> factory;
+    ComPtr<IAppxFactory> sequentialFactory;
+    ComPtr<IMsixFactoryConcurrency> concurrency;
+    ComPtr<IMsixFactoryConcurrency> sequentialConcurrency;
+    ComPtr<IAppxPackageReader> package;
+    ComPtr<IAppxPackageReader> sequentialPackage;
+    ComPtr<IAppxFilesEnumerator> files;
+    ComPtr<IAppxFilesEnumerator> sequentialFiles;
+    HRESULT hr = CoCreateAppxFactoryWithHeap(MyAllocate, MyFree, MSIX_VALIDATION_OPTION_SKIPSIGNATURE, &factory);
+    if (SUCCEEDED(hr)) { hr = factory->QueryInterface(IID_IMsixFactoryConcurrency, reinterpret_cast<void**>(&concurrency)); }
+    if (SUCCEEDED(hr)) { hr = concurrency->SetConcurrency(4); }
+    if (SUCCEEDED(hr)) { hr = CoCreateAppxFactoryWithHeap(MyAllocate, MyFree, MSIX_VALIDATION_OPTION_SKIPSIGNATURE, &sequentialFactory); }
+    if (SUCCEEDED(hr)) { hr = sequentialFactory->QueryInterface(IID_IMsixFactoryConcurrency, reinterpret_cast<void**>(&sequentialConcurrency)); }
+    if (SUCCEEDED(hr)) { hr = sequentialConcurrency->SetConcurrency(1); }
+    if (SUCCEEDED(hr)) { hr = OpenPackage(factory.Get(), path, &package); }
+    if (SUCCEEDED(hr)) { hr = OpenPackage(sequentialFactory.Get(), path, &sequentialPackage); }
+    if (SUCCEEDED(hr)) { hr = package->GetPayloadFiles(&files); }
+    if (SUCCEEDED(hr)) { hr = sequentialPackage->GetPayloadFiles(&sequentialFiles); }
+
+    UINT64 blocksBefore = 0;
+    UINT64 blocksAfter = 0;
+    if (SUCCEEDED(hr)) { hr = GetCounter(MSIX_COUNTER_BLOCKS_INFLATED_IN_PARALLEL, &blocksBefore); }
+
+    char copyPath[] = "ApiTests.tmp";
+    int tested = 0;
+    bool same = true;
+    BOOL hasCurrent = FALSE;
+    if (SUCCEEDED(hr)) { hr = files->GetHasCurrent(&hasCurrent); }
+    while (SUCCEEDED(hr) && same && hasCurrent)
+    {
+        ComPtr<IAppxFile> file;
+        ComPtr<IAppxFile> sequentialFile;
+        APPX_COMPRESSION_OPTION compression = APPX_COMPRESSION_OPTION_NONE;
+        UINT64 size = 0;
+        hr = files->GetCurrent(&file);
+        if (SUCCEEDED(hr)) { hr = sequentialFiles->GetCurrent(&sequentialFile); }
+        if (SUCCEEDED(hr)) { hr = file->GetCompressionOption(&compression); }
+        if (SUCCEEDED(hr)) { hr = file->GetSize(&size); }
+        if (SUCCEEDED(hr) && (compression != APPX_COMPRESSION_OPTION_NONE) && (size >= ParallelInflateMinimumSize))
+        {
+            std::vector<std::uint8_t> expected;
+            std::vector<std::uint8_t> actual;
+            {
+                ComPtr<IStream> stream;
+                ComPtr<IStream> sequentialStream;
+                ComPtr<IStream> copy;
+                ULARGE_INTEGER count = { 0 };
+                count.QuadPart = size;
+                hr = sequentialFile->GetStream(&sequentialStream);
+                if (SUCCEEDED(hr)) { hr = Read(sequentialStream.Get(), size, expected); }
+                if (SUCCEEDED(hr)) { hr = file->GetStream(&stream); }
+                if (SUCCEEDED(hr)) { hr = CreateStreamOnFile(copyPath, false, &copy); }
+                if (SUCCEEDED(hr)) { hr = stream->CopyTo(copy.Get(), count, nullptr, nullptr); }
+            }
+            same = SUCCEEDED(hr) && ReadFile(copyPath, actual) && (actual == expected);
+            std::remove(copyPath);
+            tested++;
+        }
+        if (SUCCEEDED(hr)) { hr = files->MoveNext(&hasCurrent); }
+        if (SUCCEEDED(hr)) { hr = sequentialFiles->MoveNext(&hasCurrent); }
+    }
+    if (SUCCEEDED(hr)) { hr = GetCounter(MSIX_COUNTER_BLOCKS_INFLATED_IN_PARALLEL, &blocksAfter); }
+    Report(SUCCEEDED(hr) && same && (tested > 0) && (blocksAfter > blocksBefore), "InflateInParallel", path);
+}
+
+// Footprint files covered by the signature are only hashed as they are read while the library parses them; a footprint
+// file handed to a caller is validated before any of it is read. Reads the package's code integrity catalog, which the
+// library doesn't parse, from the start a piece at a time, and checks that the first read fails when 'tampered', and
+// none do otherwise.
+static void ReadFootprintFileInPieces(const std::string& path, bool tampered)
+{
+    ComPtr<IAppxFactory> factory;
+    ComPtr<IAppxPackageReader> package;
+    ComPtr<IAppxFile> file;
+    ComPtr<IStream> stream;
+    UINT64 size = 0;
+    HRESULT hr = CoCreateAppxFactoryWithHeap(MyAllocate, MyFree, MSIX_VALIDATION_OPTION_ALLOWSIGNATUREORIGINUNKNOWN, &factory);
+    if (SUCCEEDED(hr)) { hr = OpenPackage(factory.Get(), path, &package); }
+    if (SUCCEEDED(hr)) { hr = package->GetFootprintFile(APPX_FOOTPRINT_FILE_TYPE_CODEINTEGRITY, &file); }
+    if (SUCCEEDED(hr)) { hr = file->GetStream(&stream); }
+    if (SUCCEEDED(hr)) { hr = file->GetSize(&size); }
+
+    const UINT64 pieceSize = 1000;
+    bool firstFailed = false;
+    UINT64 position = 0;
+    while (SUCCEEDED(hr) && !firstFailed && (position < size))
+    {
+        std::vector<std::uint8_t> data;
+        UINT64 count = std::min(size - position, pieceSize);
+        bool first = (position == 0);
+        hr = Read(stream.Get(), count, data);
+        if (first && tampered && (hr == SignatureInvalid))
+        {   firstFailed = true;
+            hr = S_OK;
+        }
+        position += count;
+    }
+    Report(SUCCEEDED(hr) && (size > pieceSize) && (firstFailed == tampered), "ReadFootprintFileInPieces", path);
+}
+
+int main(int argc, char* argv[])
+{
+    std::string directory = (argc > 1) ? argv[1] : ".";
+    SeekIntoCompressedFiles(directory + "/UnsignedZip64MultiBlock.appx");
+    SeekIntoCompressedFiles(directory + "/HelloWorld.appx");
+    InflateInParallel(directory + "/HelloWorld.appx");
+    ReadFootprintFileInPieces(directory + "/TestAppxPackage_x64.appx", false);
+    ReadFootprintFileInPieces(directory + "/SignedTamperedCodeIntegrity-TRUST_E_BAD_DIGEST.appx", true);
+    return failures;
+}
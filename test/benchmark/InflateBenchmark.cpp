@@ -0,0 +1,133 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+// Times extracting every payload file of the given packages to the null device, which for compressed files is
+// dominated by inflating and hashing them. Build it with each -DINFLATE / -DINFLATE_BLOCKS configuration to
+// compare those; InflateBenchmark.sh does that for the packages under test/appx.
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include "AppxPackaging.hpp"
+#include "MSIXWindows.hpp"
+
+#ifdef WIN32
+static char NullDevice[] = "NUL";
+#else
+static char NullDevice[] = "/dev/null";
+#endif
+
+// Stripped down ComPtr provided for those platforms that do not already have a ComPtr class.
+template <class T>
+class ComPtr
+{
+public:
+    ComPtr() = default;
+    ~ComPtr() { InternalRelease(); }
+    inline T* operator->() const { return m_ptr; }
+    inline T* Get() const { return m_ptr; }
+
+    inline T** operator&()
+    {   InternalRelease();
+        return &m_ptr;
+    }
+
+protected:
+    T* m_ptr = nullptr;
+
+    inline void InternalRelease()
+    {
+        T* temp = m_ptr;
+        if (temp)
+        {   m_ptr = nullptr;
+            temp->Release();
+        }
+    }
+};
+
+LPVOID STDMETHODCALLTYPE MyAllocate(SIZE_T cb)  { return std::malloc(cb); }
+void STDMETHODCALLTYPE MyFree(LPVOID pv)        { std::free(pv); }
+
+// Opens 'packageName' and copies each of its payload files to the null device, adding up their sizes in 'bytes'.
+HRESULT ExtractPayload(char* packageName, UINT64& bytes)
+{
+    ComPtr<IStream> inputStream;
+    ComPtr<IAppxFactory> factory;
+    ComPtr<IAppxPackageReader> package;
+    ComPtr<IAppxFilesEnumerator> files;
+    HRESULT hr = CreateStreamOnFile(packageName, true, &inputStream);
+    if (SUCCEEDED(hr)) { hr = CoCreateAppxFactoryWithHeap(MyAllocate, MyFree, MSIX_VALIDATION_OPTION_SKIPSIGNATURE, &factory); }
+    if (SUCCEEDED(hr)) { hr = factory->CreatePackageReader(inputStream.Get(), &package); }
+    if (SUCCEEDED(hr)) { hr = package->GetPayloadFiles(&files); }
+
+    BOOL hasCurrent = FALSE;
+    if (SUCCEEDED(hr)) { hr = files->GetHasCurrent(&hasCurrent); }
+    while (SUCCEEDED(hr) && hasCurrent)
+    {
+        ComPtr<IAppxFile> file;
+        ComPtr<IStream> fileStream;
+        ComPtr<IStream> nullStream;
+        UINT64 size = 0;
+        hr = files->GetCurrent(&file);
+        if (SUCCEEDED(hr)) { hr = file->GetSize(&size); }
+        if (SUCCEEDED(hr)) { hr = file->GetStream(&fileStream); }
+        if (SUCCEEDED(hr)) { hr = CreateStreamOnFile(NullDevice, false, &nullStream); }
+        if (SUCCEEDED(hr))
+        {
+            ULARGE_INTEGER count = { 0 };
+            count.QuadPart = size;
+            hr = fileStream->CopyTo(nullStream.Get(), count, nullptr, nullptr);
+            bytes += size;
+        }
+        if (SUCCEEDED(hr)) { hr = files->MoveNext(&hasCurrent); }
+    }
+    return hr;
+}
+
+int main(int argc, char* argv[])
+{
+    int iterations = 5;
+    std::vector<char*> packages;
+    for (int i = 1; i < argc; i++)
+    {
+        if ((std::strcmp(argv[i], "-n") == 0) && (i + 1 < argc)) { iterations = std::max(1, std::atoi(argv[++i])); }
+        else { packages.push_back(argv[i]); }
+    }
+    if (packages.empty())
+    {
+        std::printf("usage: %s [-n iterations] <package> [<package> ...]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("%-48s %12s %10s %10s\n", "package", "bytes", "best ms", "MB/s");
+    for (auto package : packages)
+    {
+        std::string name(package);
+        name = name.substr(name.find_last_of("/\\") + 1);
+        UINT64 bytes = 0;
+        double best = 0;
+        HRESULT hr = S_OK;
+        for (int i = 0; SUCCEEDED(hr) && (i < iterations); i++)
+        {
+            bytes = 0;
+            auto start = std::chrono::steady_clock::now();
+            hr = ExtractPayload(package, bytes);
+            double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            best = (i == 0) ? elapsed : std::min(best, elapsed);
+        }
+
+        if (FAILED(hr))
+        {   std::printf("%-48s error 0x%08x\n", name.c_str(), static_cast<unsigned int>(hr));
+        }
+        else
+        {   std::printf("%-48s %12llu %10.3f %10.1f\n", name.c_str(), static_cast<unsigned long long>(bytes), best,
+                (best > 0) ? (bytes / (1024.0 * 1024.0)) / (best / 1000.0) : 0.0);
+        }
+    }
+    return 0;
+}
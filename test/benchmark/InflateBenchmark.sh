@@ -0,0 +1,59 @@
+#!/bin/bash
+# Builds the SDK once for each deflate backend configuration given and times InflateBenchmark over the packages
+# under test/appx with each, so that they can be compared.
+iterations=5
+backends=()
+
+usage()
+{
+    echo "usage: InflateBenchmark.sh [-n iterations] [zlib|zlib-ng|libdeflate|zlib-ng+libdeflate ...]"
+    echo $'\t' "-n Number of times each package is extracted; the best time is reported. Default 5"
+    echo $'\t' "Backend configurations to compare. Default zlib and libdeflate"
+}
+
+while [ "$1" != "" ]; do
+    case $1 in
+        -n )    shift
+                iterations=$1
+                ;;
+        -h )    usage
+                exit
+                ;;
+        * )     backends+=("$1")
+    esac
+    shift
+done
+if [ ${#backends[@]} -eq 0 ]; then
+    backends=(zlib libdeflate)
+fi
+
+if [ "$(uname)" == "Darwin" ]; then
+    platform=-DMACOS=on
+else
+    platform=-DLINUX=on
+fi
+
+cd "$(dirname "$0")"
+root=$PWD/../..
+for backend in "${backends[@]}"; do
+    case $backend in
+        zlib )               options="-DINFLATE=zlib" ;;
+        zlib-ng )            options="-DINFLATE=zlib-ng" ;;
+        libdeflate )         options="-DINFLATE=zlib -DINFLATE_BLOCKS=libdeflate" ;;
+        zlib-ng+libdeflate ) options="-DINFLATE=zlib-ng -DINFLATE_BLOCKS=libdeflate" ;;
+        * )                  usage
+                             exit 1
+    esac
+
+    echo "------------------------------------------------------"
+    echo "Inflate backend:" $backend
+    echo "------------------------------------------------------"
+    build=$root/.vs/benchmark-$backend
+    mkdir -p $build
+    (cd $build && cmake -DCMAKE_BUILD_TYPE=Release $platform $options $root > /dev/null && make InflateBenchmark > /dev/null)
+    if [ $? -ne 0 ]; then
+        echo "ERROR: Could not build with" $options
+        exit 2
+    fi
+    $build/bin/InflateBenchmark -n $iterations $root/test/appx/*.appx
+done
@@ -369,6 +369,7 @@ static HRESULT RunTestsInternal(std::string source, std::string target)
     hr = RunTest(source + "TestAppxPackage_Win32.appx", unpackFolder, ss, 0);
     hr = RunTest(source + "TestAppxPackage_x64.appx", unpackFolder, ss, 0);
     hr = RunTest(source + "UnsignedZip64WithCI-APPX_E_MISSING_REQUIRED_FILE.appx", unpackFolder, full, 18);
+    hr = RunTest(source + "UnsignedZip64MultiBlock.appx", unpackFolder, ss, 0);
     hr = RunTest(source + "FileDoesNotExist.appx", unpackFolder, ss, 1);
     hr = RunTest(source + "BlockMap/Missing_Manifest_in_blockmap.appx", unpackFolder, ss, 81);
     hr = RunTest(source + "BlockMap/ContentTypes_in_blockmap.appx", unpackFolder, ss, 81);
@@ -0,0 +1,94 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+// Tests of SHA256::ComputeHashes, which hashes several buffers side by side where the processor allows it. Forces
+// each way of hashing in turn and checks that they agree, and returns how many tests failed.
+#include <cstdio>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "Exceptions.hpp"
+#include "SHA256.hpp"
+
+static int failures = 0;
+
+static void Report(bool passed, const char* test)
+{
+    std::printf("%s %s\n", passed ? "PASS" : "FAILED", test);
+    if (!passed) { failures++; }
+}
+
+// Hashes 'buffers' with 'kernel', and checks that every digest is the one the SHA256 PAL computes for the buffer
+// on its own.
+static bool SameAsPAL(const std::vector<std::vector<std::uint8_t>>& buffers, MSIX::SHA256::Kernel kernel)
+{
+    std::vector<const std::uint8_t*> data;
+    std::vector<std::size_t> sizes;
+    for (const auto& buffer : buffers)
+    {
+        data.push_back(buffer.data());
+        sizes.push_back(buffer.size());
+    }
+    std::vector<std::vector<std::uint8_t>> hashes(buffers.size());
+    MSIX::SHA256::ComputeHashes(buffers.size(), data.data(), sizes.data(), hashes.data(), kernel);
+
+    for (std::size_t i = 0; i < buffers.size(); i++)
+    {
+        std::vector<std::uint8_t> expected;
+        std::vector<std::uint8_t> buffer(buffers[i]);
+        MSIX::SHA256::ComputeHash(buffer.data(), static_cast<std::uint32_t>(buffer.size()), expected);
+        if (hashes[i] != expected) { return false; }
+    }
+    return true;
+}
+
+// Hashes batches of random buffers of random lengths, from one buffer to more than fit in the kernel's lanes at
+// once, with 'kernel'. The lengths favour the ones around the block size, where the padding spills into another
+// block, but reach past the size of a blockmap block too.
+static bool RandomBuffers(MSIX::SHA256::Kernel kernel)
+{
+    std::mt19937 random(2989);
+    std::uniform_int_distribution<int> bytes(0, 255);
+    std::uniform_int_distribution<std::size_t> counts(1, 20);
+    std::uniform_int_distribution<std::size_t> shortLengths(0, 200);
+    std::uniform_int_distribution<std::size_t> longLengths(0, 70000);
+    const std::size_t boundaries[] = { 0, 1, 55, 56, 63, 64, 65, 119, 120, 127, 128, 65536 };
+
+    for (int batch = 0; batch < 200; batch++)
+    {
+        std::vector<std::vector<std::uint8_t>> buffers(counts(random));
+        for (auto& buffer : buffers)
+        {
+            std::size_t length = 0;
+            switch (random() % 3)
+            {
+                case 0: length = boundaries[random() % (sizeof(boundaries) / sizeof(boundaries[0]))]; break;
+                case 1: length = shortLengths(random); break;
+                default: length = longLengths(random); break;
+            }
+            buffer.resize(length);
+            for (auto& byte : buffer) { byte = static_cast<std::uint8_t>(bytes(random)); }
+        }
+        if (!SameAsPAL(buffers, kernel)) { return false; }
+    }
+    return true;
+}
+
+int main()
+{
+    Report(RandomBuffers(MSIX::SHA256::Kernel::Scalar), "Scalar");
+    Report(RandomBuffers(MSIX::SHA256::Kernel::Default), "Default");
+    try
+    {
+        Report(RandomBuffers(MSIX::SHA256::Kernel::MultiBuffer), "MultiBuffer");
+    }
+    catch (MSIX::Exception& e)
+    {   // not every processor can hash several buffers side by side
+        bool notSupported = (e.Code() == static_cast<std::uint32_t>(MSIX::Error::NotSupported));
+        std::printf("%s MultiBuffer\n", notSupported ? "SKIPPED" : "FAILED");
+        if (!notSupported) { failures++; }
+    }
+    return failures;
+}